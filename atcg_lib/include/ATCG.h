@@ -7,6 +7,8 @@
 #include <Core/Window.h>
 #include <Core/Input.h>
 #include <Core/API.h>
+#include <Core/ThreadPool.h>
+#include <Core/MappedFile.h>
 
 //-------- EVENTS -------
 #include <Events/Event.h>
@@ -35,6 +37,7 @@
 #include <DataStructure/Laplacian.h>
 #include <DataStructure/Timer.h>
 #include <DataStructure/PointCloud.h>
+#include <DataStructure/ChunkedPointCloud.h>
 #include <DataStructure/Statistics.h>
 
 //-------- Math -----------
@@ -43,4 +46,16 @@
 
 //-------- Registration -----------
 #include <Registration/CPD.h>
-#include <Registration/NonRigidCPD.h>
\ No newline at end of file
+#include <Registration/AffineCPD.h>
+#include <Registration/NonRigidCPD.h>
+#include <Registration/FastGaussTransform.h>
+#include <Registration/EStep.h>
+#include <Registration/GaussianKernel.h>
+#include <Registration/MultiResolution.h>
+#include <Registration/ICP.h>
+#include <Registration/BatchRegistration.h>
+#include <Registration/SequenceRegistration.h>
+#include <Registration/Normals.h>
+#include <Registration/FeatureRegistration.h>
+#include <Registration/NDT.h>
+#include <Registration/NonRigidICP.h>
\ No newline at end of file
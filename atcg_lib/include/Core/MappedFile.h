@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+
+namespace atcg
+{
+/**
+ * @brief Read-only view of a whole file in memory.
+ * The pages are loaded on access and shared with every other process that maps the same file. The view stays valid
+ * as long as the object lives
+ */
+class MappedFile
+{
+public:
+    /**
+     * @brief Map a file
+     *
+     * @param path The path
+     */
+    explicit MappedFile(const char* path);
+
+    ~MappedFile();
+
+    MappedFile(const MappedFile&)            = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    /**
+     * @brief Check if the file could be mapped. An empty file is open but has no data
+     *
+     * @return True if the file is open
+     */
+    inline bool is_open() const { return _open && (_data || _size == 0); }
+
+    /**
+     * @brief Get the size of the file
+     *
+     * @return The size in bytes
+     */
+    inline size_t size() const { return _size; }
+
+    // The bytes of the file
+    inline const char* begin() const { return _data; }
+    inline const char* end() const { return _data + _size; }
+
+private:
+#ifdef _WIN32
+    void* _file    = nullptr;
+    void* _mapping = nullptr;
+#else
+    int _file = -1;
+#endif
+    const char* _data = nullptr;
+    size_t _size      = 0;
+    bool _open        = false;
+};
+}    // namespace atcg
\ No newline at end of file
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace atcg
+{
+/**
+ * @brief This class models a pool of worker threads
+ */
+class ThreadPool
+{
+public:
+    /**
+     * @brief Create a thread pool
+     *
+     * @param num_threads The number of worker threads (0 = number of hardware threads)
+     */
+    explicit ThreadPool(const uint32_t& num_threads = 0);
+
+    /**
+     * @brief Destroy the thread pool.
+     * Waits for all queued tasks to finish
+     */
+    ~ThreadPool();
+
+    /**
+     * @brief Queue a task
+     *
+     * @param task The task
+     * @return A future that holds the result of the task
+     */
+    template<typename Func>
+    auto push(Func&& task) -> std::future<decltype(task())>;
+
+    /**
+     * @brief Split [begin, end) into contiguous chunks and call func(first, last, chunk) for every chunk in parallel.
+     * The calling thread works on the chunks as well, so this can also be called from inside a task. Blocks until
+     * all chunks are done. If func throws, the chunks that have not started yet are skipped and the first exception
+     * is rethrown on the calling thread once no chunk is running anymore.
+     *
+     * @param begin The first index
+     * @param end The index past the last one
+     * @param num_chunks The number of chunks, e.g. to give every chunk its own accumulator
+     * @param func The function to execute
+     */
+    void parallel_for(const size_t& begin,
+                      const size_t& end,
+                      const uint32_t& num_chunks,
+                      const std::function<void(size_t, size_t, uint32_t)>& func);
+
+    /**
+     * @brief Call func(first, last) for contiguous chunks of [begin, end) in parallel.
+     *
+     * @param begin The first index
+     * @param end The index past the last one
+     * @param func The function to execute
+     */
+    void parallel_for(const size_t& begin, const size_t& end, const std::function<void(size_t, size_t)>& func);
+
+    /**
+     * @brief Get the number of worker threads
+     *
+     * @return The number of threads
+     */
+    inline uint32_t num_threads() const { return static_cast<uint32_t>(_workers.size()); }
+
+    /**
+     * @brief Get the default thread pool that is shared by the library
+     *
+     * @return The thread pool
+     */
+    static ThreadPool* get();
+
+private:
+    void work();
+
+    std::vector<std::thread> _workers;
+    std::queue<std::function<void()>> _tasks;
+    std::mutex _mutex;
+    std::condition_variable _condition;
+    bool _running = true;
+};
+
+template<typename Func>
+auto ThreadPool::push(Func&& task) -> std::future<decltype(task())>
+{
+    using Result = decltype(task());
+
+    auto packaged              = std::make_shared<std::packaged_task<Result()>>(std::forward<Func>(task));
+    std::future<Result> result = packaged->get_future();
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _tasks.emplace([packaged]() { (*packaged)(); });
+    }
+    _condition.notify_one();
+    return result;
+}
+}    // namespace atcg
\ No newline at end of file
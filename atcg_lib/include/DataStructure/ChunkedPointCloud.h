@@ -0,0 +1,243 @@
+#pragma once
+
+#include <DataStructure/PointCloud.h>
+
+#include <Eigen/Geometry>
+
+#include <cmath>
+#include <condition_variable>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace atcg
+{
+/**
+ * @brief Integer coordinates of a cell of an unbounded regular grid
+ */
+struct GridCell
+{
+    int32_t x = 0, y = 0, z = 0;
+
+    /**
+     * @brief Get the cell that contains a point
+     *
+     * @param p The point
+     * @param length The side length of a cell
+     * @return The cell
+     */
+    template<typename Vector>
+    static inline GridCell of(const Vector& p, const float& length)
+    {
+        return GridCell {static_cast<int32_t>(std::floor(p[0] / length)),
+                         static_cast<int32_t>(std::floor(p[1] / length)),
+                         static_cast<int32_t>(std::floor(p[2] / length))};
+    }
+
+    inline bool operator==(const GridCell& other) const { return x == other.x && y == other.y && z == other.z; }
+};
+
+/**
+ * @brief Spatial hash of a grid cell (Teschner et al. 2003)
+ */
+struct GridCellHash
+{
+    inline size_t operator()(const GridCell& cell) const
+    {
+        return (static_cast<size_t>(static_cast<uint32_t>(cell.x)) * 73856093u) ^
+               (static_cast<size_t>(static_cast<uint32_t>(cell.y)) * 19349663u) ^
+               (static_cast<size_t>(static_cast<uint32_t>(cell.z)) * 83492791u);
+    }
+};
+
+/**
+ * @brief An out-of-core point cloud that is stored in spatially coherent chunks on disk.
+ * Every chunk holds the points of one cubic cell of a regular grid and is stored as binary point cloud file in a
+ * directory, next to an index with the count and the bounding box of every chunk. Chunks are paged in on access and
+ * kept in a least recently used cache. Chunks that are in use are never evicted, so the memory budget can be exceeded
+ * by the chunks that the threads are working on. Modified chunks are written back when they are evicted or flushed.
+ * Files are replaced atomically, and a chunk that could not be written stays in memory until a later write succeeds.
+ * Chunks whose file cannot be read are never written. Chunk files are read and written outside of the lock, so the disk
+ * only blocks the threads that wait for the same chunk. All methods besides insert can be called concurrently, also
+ * from the functions of for_each_chunk. Vertex properties are not stored
+ */
+class ChunkedPointCloud
+{
+public:
+    /**
+     * @brief The index entry of a chunk
+     */
+    struct Chunk
+    {
+        GridCell cell;
+        size_t count = 0;
+        Eigen::AlignedBox3f bounds;    // Tight bounds of the points
+    };
+
+    /**
+     * @brief Open the chunked point cloud in a directory or create an empty one
+     *
+     * @param directory The directory of the chunk files and the index
+     * @param chunk_length The side length of the cells of the chunks. An existing index keeps its own length
+     * @param memory_budget The number of bytes of point data that are kept in memory
+     */
+    ChunkedPointCloud(const std::string& directory,
+                      const float& chunk_length   = 10.0f,
+                      const size_t& memory_budget = size_t(1) << 30);
+
+    /**
+     * @brief Write all modified chunks and the index
+     */
+    ~ChunkedPointCloud();
+
+    ChunkedPointCloud(const ChunkedPointCloud&)            = delete;
+    ChunkedPointCloud& operator=(const ChunkedPointCloud&) = delete;
+
+    /**
+     * @brief Add points with their normals and colors to the chunks of their cells.
+     * The chunks are evicted while they are filled, so only the given points have to fit into memory. Larger data
+     * sets can be inserted with several calls. Points of chunks whose file cannot be read are skipped. The chunks are
+     * resized in place, so no other thread may use chunks meanwhile
+     *
+     * @param points The points
+     */
+    void insert(const std::shared_ptr<PointCloud>& points);
+
+    /**
+     * @brief Write all modified chunks and the index. Chunks that are in use, e.g. by the function of for_each_chunk,
+     * are skipped. They are written when they are evicted, by a later call or by the destructor
+     */
+    void flush();
+
+    /**
+     * @brief Get a chunk. It is paged in if it is not in memory. A chunk whose file cannot be read is empty.
+     * Changes to the returned cloud are only written back if the chunk is modified through for_each_chunk
+     *
+     * @param index The index of the chunk
+     * @return The points of the chunk
+     */
+    std::shared_ptr<PointCloud> chunk(const size_t& index);
+
+    /**
+     * @brief Call func(index, chunk) for every chunk. The chunks are processed in parallel on the thread pool.
+     * If modify is set, the chunks are written back and their index entries are updated. Points have to stay inside
+     * the cell of their chunk. Chunks whose file cannot be read are passed empty and their changes are discarded
+     *
+     * @param func The function
+     * @param modify If func changes the chunks
+     */
+    void for_each_chunk(const std::function<void(size_t, PointCloud&)>& func, const bool& modify = false);
+
+    /**
+     * @brief Find the chunks whose bounds intersect a box
+     *
+     * @param box The box
+     * @return The indices of the chunks
+     */
+    std::vector<size_t> query(const Eigen::AlignedBox3f& box) const;
+
+    /**
+     * @brief Gather the points inside a box into an in-memory point cloud
+     *
+     * @param box The box
+     * @return The points with their normals and colors
+     */
+    std::shared_ptr<PointCloud> points_in(const Eigen::AlignedBox3f& box);
+
+    /**
+     * @brief Get a copy of the index entry of a chunk
+     *
+     * @param index The index of the chunk
+     * @return The entry
+     */
+    Chunk info(const size_t& index) const;
+
+    /**
+     * @brief Get the number of chunks
+     *
+     * @return The number of chunks
+     */
+    size_t n_chunks() const;
+
+    /**
+     * @brief Get the number of vertices of all chunks
+     *
+     * @return The number of vertices
+     */
+    size_t n_vertices() const;
+
+    /**
+     * @brief Get the bounding box of all points
+     *
+     * @return The bounding box
+     */
+    Eigen::AlignedBox3f bounds() const;
+
+    /**
+     * @brief Get the side length of the cells of the chunks
+     *
+     * @return The side length
+     */
+    inline float chunk_length() const { return _chunk_length; }
+
+    /**
+     * @brief Get the number of bytes of point data that are in memory
+     *
+     * @return The number of bytes
+     */
+    size_t resident_bytes();
+
+private:
+    // Bytes of a vertex in memory: position, normal and color
+    static constexpr size_t VERTEX_BYTES = sizeof(PointCloud::Point) + sizeof(PointCloud::Normal) +
+                                           sizeof(PointCloud::Color);
+
+    struct Slot
+    {
+        std::shared_ptr<PointCloud> cloud;    // Null if the chunk is on disk only
+        bool dirty      = false;
+        bool unreadable = false;               // The file of a non-empty chunk could not be read
+        bool busy       = false;               // The file of the chunk is read or written without the lock
+        size_t bytes    = 0;                   // The bytes of the cloud that are counted in _resident
+        std::list<size_t>::iterator recent;    // Position in the LRU list
+    };
+
+    // Page in a chunk and move it to the front of the LRU list. Expects the lock, which is released while the file is
+    // read. References to slots are invalidated, since other threads can add chunks meanwhile
+    std::shared_ptr<PointCloud> acquire(std::unique_lock<std::mutex>& lock, const size_t& index, const bool& modify);
+
+    // Evict the least recently used chunks that are not in use until the budget is met. Expects the lock, which is
+    // released while modified chunks are written
+    void evict(std::unique_lock<std::mutex>& lock);
+
+    // Write the modified chunks, optionally without the ones that are in use. Expects the lock
+    void write_chunks(std::unique_lock<std::mutex>& lock, const bool& skip_in_use);
+
+    // Count the current size of the cloud of a slot in _resident instead of the previous one. Expects the lock
+    void account(Slot& slot);
+
+    // Write a chunk that is not busy and clear its dirty flag on success. Expects the lock, which is released while the
+    // file is written
+    void store(std::unique_lock<std::mutex>& lock, const size_t& index);
+    void write_index();
+    std::string chunk_path(const GridCell& cell) const;
+
+    std::string _directory;
+    float _chunk_length;
+    size_t _memory_budget;
+
+    std::vector<Chunk> _chunks;
+    std::vector<Slot> _slots;
+    std::unordered_map<GridCell, size_t, GridCellHash> _cells;
+    bool _index_dirty = false;
+
+    std::list<size_t> _recent;    // Resident chunks, most recently used first
+    size_t _resident = 0;         // Bytes of the resident chunks
+    mutable std::mutex _mutex;
+    std::condition_variable _idle;    // Notified when a slot is no longer busy
+};
+}    // namespace atcg
\ No newline at end of file
@@ -7,6 +7,11 @@
 
 namespace atcg
 {
+/**
+ * @brief The largest number of voxels per side whose cube still fits into the 32 bit voxel indices
+ */
+constexpr uint32_t GRID_MAX_VOXELS = 1290;
+
 struct GridDimension
 {
     glm::vec3 origin    = glm::vec3(0);
@@ -1,13 +1,29 @@
 #pragma once
 
+#include <atomic>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <variant>
 #include <vector>
 #include <OpenMesh/OpenMesh.h>
 #include <OpenMesh/Core/Mesh/Traits.hh>
 #include <Renderer/VertexArray.h>
+#include <Core/MappedFile.h>
 #include <Math/Utils.h>
 
 namespace atcg
 {
+/**
+ * @brief A point cloud with per vertex positions, normals and colors.
+ * The attributes are stored in one contiguous array each. Vertices are identified by their index, a VertexHandle only
+ * wraps it. Besides the handle based accessors, the attributes can be viewed as Nx3 Eigen matrices without copies.
+ * Converted copies of the positions are cached while they are in use, so read-only consumers can share them.
+ * Further per vertex scalars, e.g. the intensity or timestamps of a scan, are stored as named properties
+ */
 template<class Traits = OpenMesh::DefaultTraits>
 class PointCloudT
 {
@@ -18,6 +34,82 @@ public:
     typedef typename Traits::Color Color;
     typedef OpenMesh::VertexHandle VertexHandle;
 
+    template<class Vector>
+    using AttributeMatrix = Eigen::Matrix<typename Vector::value_type, Eigen::Dynamic, 3, Eigen::RowMajor>;
+
+    // Nx3 views of the attribute arrays. They are invalidated when vertices are added. Creating a PointMap advances the
+    // version of the positions, so writes through it are only seen by sharedMatrix if the view was created after the
+    // last call of sharedMatrix. Use cpoints to only read the positions of a mutable cloud
+    using PointMap       = Eigen::Map<AttributeMatrix<Point>>;
+    using ConstPointMap  = Eigen::Map<const AttributeMatrix<Point>>;
+    using NormalMap      = Eigen::Map<AttributeMatrix<Normal>>;
+    using ConstNormalMap = Eigen::Map<const AttributeMatrix<Normal>>;
+    using ColorMap       = Eigen::Map<AttributeMatrix<Color>>;
+    using ConstColorMap  = Eigen::Map<const AttributeMatrix<Color>>;
+
+    // The values of a named per vertex property. The scalar types are the ones of PLY files
+    using VertexProperty = std::variant<std::vector<int8_t>,
+                                        std::vector<uint8_t>,
+                                        std::vector<int16_t>,
+                                        std::vector<uint16_t>,
+                                        std::vector<int32_t>,
+                                        std::vector<uint32_t>,
+                                        std::vector<float>,
+                                        std::vector<double>>;
+
+    template<typename T>
+    using PropertyMap = Eigen::Map<Eigen::Matrix<T, Eigen::Dynamic, 1>>;
+    template<typename T>
+    using ConstPropertyMap = Eigen::Map<const Eigen::Matrix<T, Eigen::Dynamic, 1>>;
+
+    /**
+     * @brief Iterates over the vertex handles of an index range
+     */
+    class VertexIterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type        = VertexHandle;
+        using difference_type   = std::ptrdiff_t;
+        using pointer           = const VertexHandle*;
+        using reference         = const VertexHandle&;
+
+        explicit VertexIterator(const int& index) : _handle(index) {}
+
+        inline reference operator*() const { return _handle; }
+        inline pointer operator->() const { return &_handle; }
+
+        inline VertexIterator& operator++()
+        {
+            _handle = VertexHandle(_handle.idx() + 1);
+            return *this;
+        }
+
+        inline VertexIterator operator++(int)
+        {
+            VertexIterator result = *this;
+            ++(*this);
+            return result;
+        }
+
+        inline bool operator==(const VertexIterator& other) const { return _handle == other._handle; }
+        inline bool operator!=(const VertexIterator& other) const { return _handle != other._handle; }
+
+    private:
+        VertexHandle _handle;
+    };
+
+    /**
+     * @brief The vertex handles of a point cloud for range based for loops
+     */
+    struct VertexRange
+    {
+        VertexIterator _begin, _end;
+
+        inline VertexIterator begin() const { return _begin; }
+        inline VertexIterator end() const { return _end; }
+    };
+
     /**
      * @brief Create a pointcloud
      */
@@ -37,6 +129,45 @@ public:
      */
     VertexHandle add_vertex(const Point& p);
 
+    /**
+     * @brief Add vertices with one allocation per attribute.
+     * The normals and colors are initialized like in add_vertex
+     *
+     * @param points The points
+     * @param count The number of points
+     *
+     * @returns The handle to the first new vertex
+     */
+    VertexHandle add_vertices(const Point* points, const size_t& count);
+
+    /**
+     * @brief Add vertices with one allocation per attribute
+     *
+     * @param points The points
+     *
+     * @returns The handle to the first new vertex
+     */
+    inline VertexHandle add_vertices(const std::vector<Point>& points)
+    {
+        return add_vertices(points.data(), points.size());
+    }
+
+    /**
+     * @brief Reserve memory for a number of vertices, so adding them does not reallocate
+     *
+     * @param count The number of vertices
+     */
+    void reserve(const size_t& count);
+
+    /**
+     * @brief Change the number of vertices.
+     * New vertices are placed at the origin, their normals and colors are initialized like in add_vertex. The
+     * attributes can then be written through the views
+     *
+     * @param count The number of vertices
+     */
+    void resize(const size_t& count);
+
     /**
      * @brief Set the point of a vertex
      *
@@ -67,7 +198,7 @@ public:
      * @param vh The VertexHandle
      * @returns The point
      */
-    Point point(const VertexHandle& vh);
+    inline const Point& point(const VertexHandle& vh) const { return _points[vh.idx()]; }
 
     /**
      * @brief Get the normal of a vertex
@@ -75,7 +206,7 @@ public:
      * @param vh The VertexHandle
      * @returns The normal
      */
-    Normal normal(const VertexHandle& vh);
+    inline const Normal& normal(const VertexHandle& vh) const { return _normals[vh.idx()]; }
 
     /**
      * @brief Get the color of a vertex
@@ -83,7 +214,7 @@ public:
      * @param vh The VertexHandle
      * @return The color
      */
-    Color color(const VertexHandle& vh);
+    inline const Color& color(const VertexHandle& vh) const { return _colors[vh.idx()]; }
 
     /**
      * @brief Uploads the data onto the gpu
@@ -93,9 +224,149 @@ public:
     /**
      * @brief Get the point cloud as Nx3 row matrix
      *
+     * @tparam Scalar The scalar type of the matrix
      * @return The data points as matrix
      */
-    RowMatrix asMatrix();
+    template<typename Scalar = double>
+    RowMatrixT<Scalar> asMatrix() const;
+
+    /**
+     * @brief Get the point cloud as shared Nx3 row matrix.
+     * The matrix is converted on the first call and shared with later callers as long as anyone holds it. Only a weak
+     * reference is cached, so the copy is freed with its last user. Changing the positions (set_point, adding
+     * vertices, resize or a mutable points view) advances the version of the cloud, and a matrix of an older version
+     * is converted again. Holders keep their snapshot. Thread safe as long as the cloud is not modified concurrently
+     *
+     * @tparam Scalar The scalar type of the matrix (float or double)
+     * @return The data points as matrix
+     */
+    template<typename Scalar = double>
+    std::shared_ptr<const RowMatrixT<Scalar>> sharedMatrix() const;
+
+    /**
+     * @brief Get the positions as Nx3 row major matrix that aliases the point cloud
+     *
+     * @return The view of the positions
+     */
+    inline PointMap points()
+    {
+        invalidate();
+        return PointMap(reinterpret_cast<typename Point::value_type*>(_points.data()), n_vertices(), 3);
+    }
+
+    /**
+     * @brief Get the positions as Nx3 row major matrix that aliases the point cloud
+     *
+     * @return The view of the positions
+     */
+    inline ConstPointMap points() const
+    {
+        return ConstPointMap(reinterpret_cast<const typename Point::value_type*>(_points.data()), n_vertices(), 3);
+    }
+
+    /**
+     * @brief Get the positions as read only Nx3 row major matrix that aliases the point cloud. Unlike the mutable
+     * view, it keeps the matrices of sharedMatrix valid
+     *
+     * @return The view of the positions
+     */
+    inline ConstPointMap cpoints() const { return points(); }
+
+    /**
+     * @brief Get the normals as Nx3 row major matrix that aliases the point cloud
+     *
+     * @return The view of the normals
+     */
+    inline NormalMap normals()
+    {
+        return NormalMap(reinterpret_cast<typename Normal::value_type*>(_normals.data()), n_vertices(), 3);
+    }
+
+    /**
+     * @brief Get the normals as Nx3 row major matrix that aliases the point cloud
+     *
+     * @return The view of the normals
+     */
+    inline ConstNormalMap normals() const
+    {
+        return ConstNormalMap(reinterpret_cast<const typename Normal::value_type*>(_normals.data()), n_vertices(), 3);
+    }
+
+    /**
+     * @brief Get the colors as Nx3 row major matrix that aliases the point cloud
+     *
+     * @return The view of the colors
+     */
+    inline ColorMap colors()
+    {
+        return ColorMap(reinterpret_cast<typename Color::value_type*>(_colors.data()), n_vertices(), 3);
+    }
+
+    /**
+     * @brief Get the colors as Nx3 row major matrix that aliases the point cloud
+     *
+     * @return The view of the colors
+     */
+    inline ConstColorMap colors() const
+    {
+        return ConstColorMap(reinterpret_cast<const typename Color::value_type*>(_colors.data()), n_vertices(), 3);
+    }
+
+    /**
+     * @brief Add a per vertex property that is initialized with zeros. An existing property of the same name is
+     * replaced
+     *
+     * @tparam T The scalar type of the property
+     * @param name The name
+     * @return The view of the values
+     */
+    template<typename T>
+    PropertyMap<T> add_property(const std::string& name);
+
+    /**
+     * @brief Check if a per vertex property exists
+     *
+     * @param name The name
+     * @return True if the property exists
+     */
+    inline bool has_property(const std::string& name) const { return property_index(name) < _properties.size(); }
+
+    /**
+     * @brief Get the values of a per vertex property. Throws std::out_of_range if there is no property of this name
+     * and std::bad_variant_access if its type is not T
+     *
+     * @tparam T The scalar type of the property
+     * @param name The name
+     * @return The view of the values
+     */
+    template<typename T>
+    inline PropertyMap<T> property(const std::string& name)
+    {
+        std::vector<T>& values = std::get<std::vector<T>>(_properties.at(property_index(name)).second);
+        return PropertyMap<T>(values.data(), values.size());
+    }
+
+    /**
+     * @brief Get the values of a per vertex property. Throws std::out_of_range if there is no property of this name
+     * and std::bad_variant_access if its type is not T
+     *
+     * @tparam T The scalar type of the property
+     * @param name The name
+     * @return The view of the values
+     */
+    template<typename T>
+    inline ConstPropertyMap<T> property(const std::string& name) const
+    {
+        const std::vector<T>& values = std::get<std::vector<T>>(_properties.at(property_index(name)).second);
+        return ConstPropertyMap<T>(values.data(), values.size());
+    }
+
+    /**
+     * @brief Get all per vertex properties in the order they were added
+     *
+     * @return The names and values of the properties
+     */
+    inline const std::vector<std::pair<std::string, VertexProperty>>& properties() const { return _properties; }
 
     /**
      * @brief Get the Vertex Array object
@@ -109,21 +380,62 @@ public:
      *
      * @returns The number of vertices
      */
-    inline size_t n_vertices() const { return _vertices.size(); }
+    inline size_t n_vertices() const { return _points.size(); }
 
     // Iterators
-    std::vector<VertexHandle>::iterator vertices_begin() { return _vertices.begin(); }
-    std::vector<VertexHandle>::iterator vertices_end() { return _vertices.end(); }
-
-    std::vector<VertexHandle>::const_iterator vertices_begin() const { return _vertices.begin(); }
-    std::vector<VertexHandle>::const_iterator vertices_end() const { return _vertices.end(); }
+    inline VertexIterator vertices_begin() const { return VertexIterator(0); }
+    inline VertexIterator vertices_end() const { return VertexIterator(static_cast<int>(n_vertices())); }
+    inline VertexRange vertices() const { return VertexRange {vertices_begin(), vertices_end()}; }
 
 private:
-    std::vector<VertexHandle> _vertices;
+    static_assert(sizeof(Point) == 3 * sizeof(typename Point::value_type), "Points must be tightly packed");
+    static_assert(sizeof(Normal) == 3 * sizeof(typename Normal::value_type), "Normals must be tightly packed");
+    static_assert(sizeof(Color) == 3 * sizeof(typename Color::value_type), "Colors must be tightly packed");
+
+    inline void invalidate() { _cache.version.fetch_add(1, std::memory_order_relaxed); }
+
+    // The index of the property or the number of properties if there is none of this name
+    inline size_t property_index(const std::string& name) const
+    {
+        size_t index = 0;
+        while(index < _properties.size() && _properties[index].first != name) ++index;
+        return index;
+    }
+
+    // The properties are resized together with the attributes, new values are zero
+    void resize_properties(const size_t& count);
 
     std::vector<Point> _points;
     std::vector<Normal> _normals;
     std::vector<Color> _colors;
+    std::vector<std::pair<std::string, VertexProperty>> _properties;
+
+    // The version of the positions and the matrices of sharedMatrix with the version they were converted from. The
+    // version is atomic, so advancing it does not race with sharedMatrix. A copied cloud starts with an empty cache
+    template<typename Scalar>
+    struct CachedMatrix
+    {
+        std::weak_ptr<const RowMatrixT<Scalar>> matrix;
+        size_t version = 0;
+    };
+
+    struct MatrixCache
+    {
+        MatrixCache() = default;
+        MatrixCache(const MatrixCache&) {}
+        MatrixCache& operator=(const MatrixCache&)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            matrices = {};
+            return *this;
+        }
+
+        std::mutex mutex;
+        std::atomic<size_t> version {0};
+        std::tuple<CachedMatrix<float>, CachedMatrix<double>> matrices;
+    };
+
+    mutable MatrixCache _cache;
 
     std::shared_ptr<VertexArray> _vao;
 };
@@ -135,65 +447,80 @@ private:
 template<class Traits>
 typename PointCloudT<Traits>::VertexHandle PointCloudT<Traits>::add_vertex(const PointCloudT<Traits>::Point& p)
 {
-    typename PointCloudT<Traits>::VertexHandle vh(static_cast<int>(_vertices.size()));
-    _vertices.push_back(vh);
+    invalidate();
+    typename PointCloudT<Traits>::VertexHandle vh(static_cast<int>(_points.size()));
     _normals.push_back(typename PointCloudT<Traits>::Normal {1, 0, 0});
     _colors.push_back(typename PointCloudT<Traits>::Color {0, 0, 0});
     _points.push_back(p);
+    resize_properties(_points.size());
 
     return vh;
 }
 
 template<class Traits>
-void PointCloudT<Traits>::set_point(const PointCloudT<Traits>::VertexHandle& vh, const PointCloudT<Traits>::Point& p)
+typename PointCloudT<Traits>::VertexHandle PointCloudT<Traits>::add_vertices(const PointCloudT<Traits>::Point* points,
+                                                                             const size_t& count)
 {
-    _points[vh.idx()] = p;
+    invalidate();
+    typename PointCloudT<Traits>::VertexHandle vh(static_cast<int>(_points.size()));
+    _points.insert(_points.end(), points, points + count);
+    _normals.resize(_points.size(), typename PointCloudT<Traits>::Normal {1, 0, 0});
+    _colors.resize(_points.size(), typename PointCloudT<Traits>::Color {0, 0, 0});
+    resize_properties(_points.size());
+
+    return vh;
 }
 
 template<class Traits>
-void PointCloudT<Traits>::set_normal(const PointCloudT<Traits>::VertexHandle& vh,
-                                     const PointCloudT<Traits>::Normal& normal)
+void PointCloudT<Traits>::reserve(const size_t& count)
 {
-    _normals[vh.idx()] = normal;
+    _points.reserve(count);
+    _normals.reserve(count);
+    _colors.reserve(count);
 }
 
 template<class Traits>
-void PointCloudT<Traits>::set_color(const PointCloudT<Traits>::VertexHandle& vh,
-                                    const PointCloudT<Traits>::Color& color)
+void PointCloudT<Traits>::resize(const size_t& count)
 {
-    _colors[vh.idx()] = color;
+    invalidate();
+    _points.resize(count, typename PointCloudT<Traits>::Point {0, 0, 0});
+    _normals.resize(count, typename PointCloudT<Traits>::Normal {1, 0, 0});
+    _colors.resize(count, typename PointCloudT<Traits>::Color {0, 0, 0});
+    resize_properties(count);
 }
 
 template<class Traits>
-typename PointCloudT<Traits>::Point PointCloudT<Traits>::point(const PointCloudT<Traits>::VertexHandle& vh)
+void PointCloudT<Traits>::set_point(const PointCloudT<Traits>::VertexHandle& vh, const PointCloudT<Traits>::Point& p)
 {
-    return _points[vh.idx()];
+    invalidate();
+    _points[vh.idx()] = p;
 }
 
 template<class Traits>
-typename PointCloudT<Traits>::Normal PointCloudT<Traits>::normal(const PointCloudT<Traits>::VertexHandle& vh)
+void PointCloudT<Traits>::set_normal(const PointCloudT<Traits>::VertexHandle& vh,
+                                     const PointCloudT<Traits>::Normal& normal)
 {
-    return _normals[vh.idx()];
+    _normals[vh.idx()] = normal;
 }
 
 template<class Traits>
-typename PointCloudT<Traits>::Color PointCloudT<Traits>::color(const PointCloudT<Traits>::VertexHandle& vh)
+void PointCloudT<Traits>::set_color(const PointCloudT<Traits>::VertexHandle& vh,
+                                    const PointCloudT<Traits>::Color& color)
 {
-    return _colors[vh.idx()];
+    _colors[vh.idx()] = color;
 }
 
 template<class Traits>
 void PointCloudT<Traits>::uploadData()
 {
     std::vector<float> vertex_data;
-    vertex_data.resize(_vertices.size() * 9);
+    vertex_data.resize(n_vertices() * 9);
 
-    for(auto vertex: _vertices)
+    for(size_t vertex_id = 0; vertex_id < n_vertices(); ++vertex_id)
     {
-        int32_t vertex_id              = vertex.idx();
-        OpenMesh::Vec3f pos            = point(vertex);
-        OpenMesh::Vec3f norm           = normal(vertex);
-        OpenMesh::Vec3uc col           = color(vertex);
+        const OpenMesh::Vec3f& pos     = _points[vertex_id];
+        const OpenMesh::Vec3f& norm    = _normals[vertex_id];
+        const OpenMesh::Vec3uc& col    = _colors[vertex_id];
         vertex_data[9 * vertex_id + 0] = pos[0];
         vertex_data[9 * vertex_id + 1] = pos[1];
         vertex_data[9 * vertex_id + 2] = pos[2];
@@ -216,20 +543,47 @@ void PointCloudT<Traits>::uploadData()
 }
 
 template<class Traits>
-RowMatrix PointCloudT<Traits>::asMatrix()
+template<typename Scalar>
+RowMatrixT<Scalar> PointCloudT<Traits>::asMatrix() const
+{
+    return points().template cast<Scalar>();
+}
+
+template<class Traits>
+template<typename T>
+typename PointCloudT<Traits>::template PropertyMap<T> PointCloudT<Traits>::add_property(const std::string& name)
 {
-    RowMatrix S(n_vertices(), 3);
-    uint32_t i = 0;
-    for(auto vertex: _vertices)
+    size_t index = property_index(name);
+    if(index == _properties.size()) _properties.emplace_back(name, VertexProperty {});
+
+    _properties[index].second = std::vector<T>(n_vertices(), T(0));
+    return property<T>(name);
+}
+
+template<class Traits>
+void PointCloudT<Traits>::resize_properties(const size_t& count)
+{
+    for(auto& property: _properties)
     {
-        OpenMesh::Vec3f pos = point(vertex);
-        S(i, 0)             = static_cast<double>(pos[0]);
-        S(i, 1)             = static_cast<double>(pos[1]);
-        S(i, 2)             = static_cast<double>(pos[2]);
-        ++i;
+        std::visit([&](auto& values) { values.resize(count); }, property.second);
     }
+}
 
-    return S;
+template<class Traits>
+template<typename Scalar>
+std::shared_ptr<const RowMatrixT<Scalar>> PointCloudT<Traits>::sharedMatrix() const
+{
+    std::lock_guard<std::mutex> lock(_cache.mutex);
+    auto& cached = std::get<CachedMatrix<Scalar>>(_cache.matrices);
+
+    std::shared_ptr<const RowMatrixT<Scalar>> matrix = cached.matrix.lock();
+    const size_t version = _cache.version.load(std::memory_order_relaxed);
+    if(matrix && cached.version == version) return matrix;
+
+    matrix         = std::make_shared<const RowMatrixT<Scalar>>(asMatrix<Scalar>());
+    cached.matrix  = matrix;
+    cached.version = version;
+    return matrix;
 }
 
 using PointCloud = PointCloudT<>;
@@ -237,11 +591,156 @@ using PointCloud = PointCloudT<>;
 namespace IO
 {
 /**
- * @brief Load a pointcloud
+ * @brief The attributes that are stored in a binary point cloud file
+ */
+enum class PointCloudAttribute : uint32_t
+{
+    Points  = 1 << 0,
+    Normals = 1 << 1,
+    Colors  = 1 << 2
+};
+
+/**
+ * @brief Header of the binary point cloud format.
+ * The header is followed by one block per stored attribute. A block holds the Nx3 values of one attribute (structure
+ * of arrays) in the layout of PointCloud, starts at a multiple of POINTCLOUD_FILE_ALIGNMENT and can be used in place.
+ * All values are little endian
+ */
+struct PointCloudFileHeader
+{
+    char magic[4];          // POINTCLOUD_FILE_MAGIC
+    uint32_t version;       // POINTCLOUD_FILE_VERSION
+    uint64_t count;         // Number of points
+    uint32_t attributes;    // Mask of PointCloudAttribute
+    uint32_t reserved;
+    float min[3];           // Bounding box of the points
+    float max[3];
+    uint64_t offsets[3];    // Byte offset of the points, normals and colors from the start of the file, 0 if missing
+};
+static_assert(sizeof(PointCloudFileHeader) == 72, "The header must not contain padding");
+
+constexpr char POINTCLOUD_FILE_MAGIC[4]    = {'A', 'T', 'P', 'C'};
+constexpr uint32_t POINTCLOUD_FILE_VERSION = 1;
+constexpr size_t POINTCLOUD_FILE_ALIGNMENT = 64;
+
+/**
+ * @brief A binary point cloud file that is mapped into memory.
+ * The attribute views alias the mapped file, nothing is copied. The pages are shared by all processes that map the
+ * same file
+ */
+class MappedPointCloud
+{
+public:
+    /**
+     * @brief Map a binary point cloud file
+     *
+     * @param path The path
+     */
+    explicit MappedPointCloud(const char* path);
+
+    /**
+     * @brief Check if the file is a valid binary point cloud file
+     *
+     * @return True if the file could be mapped and its header and blocks are valid
+     */
+    inline bool is_valid() const { return _header != nullptr; }
+
+    /**
+     * @brief Check if an attribute is stored in the file
+     *
+     * @param attribute The attribute
+     * @return True if the file is valid and the attribute is stored
+     */
+    inline bool has(const PointCloudAttribute& attribute) const
+    {
+        return is_valid() && (_header->attributes & static_cast<uint32_t>(attribute));
+    }
+
+    /**
+     * @brief Get the header with the count and the bounding box
+     *
+     * @return The header
+     */
+    inline const PointCloudFileHeader& header() const { return *_header; }
+
+    /**
+     * @brief Get the number of vertices
+     *
+     * @returns The number of vertices, zero if the file is not valid
+     */
+    inline size_t n_vertices() const { return is_valid() ? static_cast<size_t>(_header->count) : 0; }
+
+    /**
+     * @brief Get the positions as Nx3 row major matrix that aliases the file. The file must store the points
+     *
+     * @return The view of the positions
+     */
+    PointCloud::ConstPointMap points() const;
+
+    /**
+     * @brief Get the normals as Nx3 row major matrix that aliases the file. The file must store the normals
+     *
+     * @return The view of the normals
+     */
+    PointCloud::ConstNormalMap normals() const;
+
+    /**
+     * @brief Get the colors as Nx3 row major matrix that aliases the file. The file must store the colors
+     *
+     * @return The view of the colors
+     */
+    PointCloud::ConstColorMap colors() const;
+
+    /**
+     * @brief Copy the file into a point cloud, one block copy per attribute.
+     * Missing attributes are initialized like in PointCloud::add_vertex
+     *
+     * @return The point cloud
+     */
+    std::shared_ptr<PointCloud> toPointCloud() const;
+
+private:
+    template<class Map>
+    Map block(const uint32_t& index) const;
+
+    MappedFile _file;
+    const PointCloudFileHeader* _header = nullptr;
+};
+
+/**
+ * @brief Load a pointcloud.
+ * Binary point cloud files are recognized by their header, whatever their ending, so every file of write_pointcloud
+ * can be read back. The other formats are recognized by their ending: .xyz files, headerless .bin files of 15 floats
+ * per vertex (position, color in [0, 1], normal and 6 unused values) and .obj, .off and .ply files, of which only the
+ * vertex records are read. All scalar vertex properties of .ply files besides the position, normal and color are added
+ * as vertex properties. Everything else is read with OpenMesh
  *
  * @param path The path
  * @returns The pointcloud
  */
 std::shared_ptr<PointCloud> read_pointcloud(const char* path);
+
+/**
+ * @brief Write a pointcloud in the binary point cloud format, or as binary PLY file if the path ends with .ply.
+ * The header and the attribute blocks are streamed straight from the point cloud without intermediate copies. The
+ * binary point cloud format does not store vertex properties
+ *
+ * @param cloud The pointcloud
+ * @param path The path
+ * @returns True if the file was written
+ */
+bool write_pointcloud(const std::shared_ptr<PointCloud>& cloud, const char* path);
+
+/**
+ * @brief Write a pointcloud as PLY file with its positions, normals, colors and all vertex properties.
+ * Binary files are little endian. Their records are interleaved in chunks, so the memory does not grow with the size
+ * of the cloud
+ *
+ * @param cloud The pointcloud
+ * @param path The path
+ * @param binary If the file is binary or ascii
+ * @returns True if the file was written
+ */
+bool write_ply(const std::shared_ptr<PointCloud>& cloud, const char* path, const bool& binary = true);
 }    // namespace IO
 }    // namespace atcg
\ No newline at end of file
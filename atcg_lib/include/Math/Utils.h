@@ -32,4 +32,9 @@ void normalize(const std::shared_ptr<Geometry>& geom)
 }
 }    // namespace atcg
 
-using RowMatrix = Eigen::Matrix<double, -1, -1, Eigen::RowMajor>;
\ No newline at end of file
+template<typename Scalar>
+using RowMatrixT = Eigen::Matrix<Scalar, -1, -1, Eigen::RowMajor>;
+template<typename Scalar>
+using VectorT = Eigen::Matrix<Scalar, -1, 1>;
+
+using RowMatrix = RowMatrixT<double>;
\ No newline at end of file
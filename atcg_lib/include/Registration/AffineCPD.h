@@ -0,0 +1,107 @@
+#pragma once
+
+#include <Registration/Registration.h>
+#include <Registration/EStep.h>
+
+namespace atcg
+{
+/**
+ * @brief Affine Coherent Point Drift (Myronenko and Song 2010)
+ * The target is moved by y -> B * y + t with an arbitrary matrix B. The E-step is the same as for the rigid
+ * registration, the M-step is closed form: B = (XC^T * P^T * YC) * (YC^T * d(P1) * YC)^-1
+ *
+ * @tparam Scalar The precision of the point data and the E-step. float halves the memory traffic and doubles the
+ * SIMD width of the gaussian kernel
+ * @tparam Accumulator The precision of the sums over all points (normalizations, weighted moments and the variance
+ * update). Use double with float data for mixed precision
+ */
+template<typename Scalar = double, typename Accumulator = double>
+class AffineCoherentPointDriftT : public RegistrationT<Scalar>
+{
+public:
+    using Matrix = typename RegistrationT<Scalar>::Matrix;
+    using Vector = typename RegistrationT<Scalar>::Vector;
+
+    /**
+     * @brief Create an affine CPD registration
+     *
+     * @param source The source point cloud
+     * @param target The target point cloud
+     * @param w The weight of the uniform outlier distribution
+     * @param method The E-step method
+     * @param epsilon The accuracy of the fast gauss transform (only used with EStepMethod::FastGaussTransform)
+     */
+    AffineCoherentPointDriftT(const std::shared_ptr<PointCloud>& source,
+                              const std::shared_ptr<PointCloud>& target,
+                              const double& w           = 0.0,
+                              const EStepMethod& method = EStepMethod::Direct,
+                              const double& epsilon     = 1e-3);
+
+    /**
+     * @brief Create an affine CPD registration of a new source against the target of another registration.
+     * The parameters and the target points are shared with the reference
+     *
+     * @param source The source point cloud
+     * @param reference The registration whose target is used
+     */
+    AffineCoherentPointDriftT(const std::shared_ptr<PointCloud>& source,
+                              const AffineCoherentPointDriftT<Scalar, Accumulator>& reference);
+
+    virtual ~AffineCoherentPointDriftT();
+
+    virtual void solve(const uint32_t& maxN, const float& tol = 0.01f) override;
+
+    virtual void applyTransform(const std::shared_ptr<PointCloud>& cloud) override;
+
+    /**
+     * @brief Set the transformation y -> B * y + t that the next call of solve starts with
+     *
+     * @param B The linear part
+     * @param t The translation
+     */
+    void setTransform(const Eigen::Matrix3d& B, const Eigen::Vector3d& t);
+
+    /**
+     * @brief Get the linear part of the transformation
+     *
+     * @return The matrix B
+     */
+    inline Eigen::Matrix3d getAffine() const { return B.template cast<double>(); }
+
+    /**
+     * @brief Get the translation
+     *
+     * @return The translation
+     */
+    inline Eigen::Vector3d getTranslation() const { return t.template cast<double>(); }
+
+private:
+    using Matrix3 = Eigen::Matrix<Accumulator, 3, 3>;
+    using Vector3 = Eigen::Matrix<Accumulator, 3, 1>;
+
+    using RegistrationT<Scalar>::X;
+    using RegistrationT<Scalar>::Y;
+    using RegistrationT<Scalar>::N;
+    using RegistrationT<Scalar>::M;
+    using RegistrationT<Scalar>::var;
+
+    void estimate(double var);
+    double maximize();
+
+    virtual Matrix transformedTarget() const override;
+
+    Matrix3 B = Matrix3::Identity();
+    Vector3 t = Vector3::Zero();
+
+    double w = 0.0;
+
+    EStepMethod method = EStepMethod::Direct;
+    double epsilon     = 1e-3;
+
+    Vector P1;     // P * 1
+    Vector PT1;    // P^T * 1
+    Matrix PX;     // P * X
+};
+
+using AffineCoherentPointDrift = AffineCoherentPointDriftT<>;
+}    // namespace atcg
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <Registration/Registration.h>
+#include <Core/ThreadPool.h>
+
+#include <functional>
+#include <vector>
+
+namespace atcg
+{
+/**
+ * @brief One-to-many driver for the registration algorithms.
+ * The target side (points, moments and everything computed by prepare, e.g. the motion coherence matrix or the
+ * kd-tree) is prepared once in a reference registration. Every source gets its own registration that shares this
+ * data. The sources are solved in parallel on the thread pool. At most one registration per thread is alive at a
+ * time, so the memory does not grow with the number of sources.
+ *
+ * @tparam RegistrationType The registration. It needs a constructor RegistrationType(source, reference)
+ */
+template<class RegistrationType>
+class BatchRegistration
+{
+public:
+    /**
+     * @brief Prepare the target
+     *
+     * @param target The target point cloud
+     * @param args Additional arguments for the constructor of the reference registration
+     */
+    template<typename... Args>
+    BatchRegistration(const std::shared_ptr<PointCloud>& target, const Args&... args);
+
+    /**
+     * @brief Register all sources against the target.
+     * The callback is called on the worker thread right after a source is solved, e.g. to read the transformation or
+     * to apply it to a point cloud. It is called concurrently for different sources. The registration is destroyed
+     * when the callback returns
+     *
+     * @param sources The source point clouds
+     * @param maxN The maximum number of iterations per source
+     * @param tol The tolerance of the variance change
+     * @param callback The function that is called with the index of the source and its solved registration
+     */
+    void solve(const std::vector<std::shared_ptr<PointCloud>>& sources,
+               const uint32_t& maxN,
+               const float& tol,
+               const std::function<void(size_t, RegistrationType&)>& callback);
+
+    /**
+     * @brief Get the reference registration that holds the prepared target
+     *
+     * @return The reference registration
+     */
+    inline std::shared_ptr<RegistrationType> getReference() const { return _reference; }
+
+private:
+    std::shared_ptr<RegistrationType> _reference;
+};
+
+///
+/// Implementation
+///
+
+template<class RegistrationType>
+template<typename... Args>
+BatchRegistration<RegistrationType>::BatchRegistration(const std::shared_ptr<PointCloud>& target,
+                                                       const Args&... args)
+{
+    // The reference never gets solved, its source is empty
+    _reference = std::make_shared<RegistrationType>(std::make_shared<PointCloud>(), target, args...);
+    _reference->prepare();
+}
+
+template<class RegistrationType>
+void BatchRegistration<RegistrationType>::solve(const std::vector<std::shared_ptr<PointCloud>>& sources,
+                                                const uint32_t& maxN,
+                                                const float& tol,
+                                                const std::function<void(size_t, RegistrationType&)>& callback)
+{
+    // The solves use the thread pool themselves. Their parallel loops are run by the calling worker if all other
+    // workers are busy with sources
+    ThreadPool::get()->parallel_for(
+        0,
+        sources.size(),
+        [&](size_t first, size_t last)
+        {
+            for(size_t i = first; i < last; ++i)
+            {
+                RegistrationType registration(sources[i], *_reference);
+                registration.solve(maxN, tol);
+                callback(i, registration);
+            }
+        });
+}
+}    // namespace atcg
@@ -1,39 +1,116 @@
 #pragma once
 
 #include <Registration/Registration.h>
+#include <Registration/EStep.h>
 #include <Eigen/SVD>
 
 namespace atcg
 {
-class CoherentPointDrift : public Registration
+/**
+ * @brief Rigid Coherent Point Drift (Myronenko and Song 2010)
+ *
+ * @tparam Scalar The precision of the point data and the E-step. float halves the memory traffic and doubles the
+ * SIMD width of the gaussian kernel
+ * @tparam Accumulator The precision of the sums over all points (normalizations, weighted moments and the variance
+ * update). Use double with float data for mixed precision
+ */
+template<typename Scalar = double, typename Accumulator = double>
+class CoherentPointDriftT : public RegistrationT<Scalar>
 {
 public:
-    CoherentPointDrift(const std::shared_ptr<PointCloud>& source,
-                       const std::shared_ptr<PointCloud>& target,
-                       const double& w = 0.0);
+    using Matrix = typename RegistrationT<Scalar>::Matrix;
+    using Vector = typename RegistrationT<Scalar>::Vector;
 
-    virtual ~CoherentPointDrift();
+    /**
+     * @brief Create a rigid CPD registration
+     *
+     * @param source The source point cloud
+     * @param target The target point cloud
+     * @param w The weight of the uniform outlier distribution
+     * @param method The E-step method
+     * @param epsilon The accuracy of the fast gauss transform (only used with EStepMethod::FastGaussTransform)
+     */
+    CoherentPointDriftT(const std::shared_ptr<PointCloud>& source,
+                        const std::shared_ptr<PointCloud>& target,
+                        const double& w           = 0.0,
+                        const EStepMethod& method = EStepMethod::Direct,
+                        const double& epsilon     = 1e-3);
+
+    /**
+     * @brief Create a rigid CPD registration of a new source against the target of another registration.
+     * The parameters and the target points are shared with the reference
+     *
+     * @param source The source point cloud
+     * @param reference The registration whose target is used
+     */
+    CoherentPointDriftT(const std::shared_ptr<PointCloud>& source,
+                        const CoherentPointDriftT<Scalar, Accumulator>& reference);
+
+    virtual ~CoherentPointDriftT();
 
     virtual void solve(const uint32_t& maxN, const float& tol = 0.01f) override;
 
     virtual void applyTransform(const std::shared_ptr<PointCloud>& cloud) override;
 
+    /**
+     * @brief Set the transformation y -> s * R * y + t that the next call of solve starts with
+     *
+     * @param s The scale
+     * @param R The rotation
+     * @param t The translation
+     */
+    void setTransform(const double& s, const Eigen::Matrix3d& R, const Eigen::Vector3d& t);
+
+    /**
+     * @brief Get the scale
+     *
+     * @return The scale
+     */
+    inline double getScale() const { return static_cast<double>(s); }
+
+    /**
+     * @brief Get the rotation
+     *
+     * @return The rotation
+     */
+    inline Eigen::Matrix3d getRotation() const { return R.template cast<double>(); }
+
+    /**
+     * @brief Get the translation
+     *
+     * @return The translation
+     */
+    inline Eigen::Vector3d getTranslation() const { return t.template cast<double>(); }
+
 private:
-    double initialize();
-    void estimate(Eigen::VectorXd& PX, Eigen::VectorXd& PY, double var);
-    double maximize(Eigen::VectorXd& PX, Eigen::VectorXd& PY);
+    using Matrix3 = Eigen::Matrix<Accumulator, 3, 3>;
+    using Vector3 = Eigen::Matrix<Accumulator, 3, 1>;
+
+    using RegistrationT<Scalar>::X;
+    using RegistrationT<Scalar>::Y;
+    using RegistrationT<Scalar>::N;
+    using RegistrationT<Scalar>::M;
+    using RegistrationT<Scalar>::var;
+
+    void estimate(double var);
+    double maximize();
 
-    void direct_optimization(Eigen::VectorXd& PX, Eigen::VectorXd& PY, double bias, double var);
-    double Pmn(const Eigen::Vector3d& x, const Eigen::Vector3d& y, double var);
-    double Pmn(const double& L2S, double var);
+    virtual Matrix transformedTarget() const override;
 
-    double s          = 1.0;
-    Eigen::Matrix3d R = Eigen::Matrix3d::Identity();
-    Eigen::Vector3d t = Eigen::Vector3d::Zero();
+    Accumulator s = 1;
+    Matrix3 R     = Matrix3::Identity();
+    Vector3 t     = Vector3::Zero();
 
     double w = 0.0;
 
-    RowMatrix P;
-    Eigen::JacobiSVD<RowMatrix, Eigen::ComputeFullU | Eigen::ComputeFullV> svd;
+    EStepMethod method = EStepMethod::Direct;
+    double epsilon     = 1e-3;
+
+    Vector P1;     // P * 1
+    Vector PT1;    // P^T * 1
+    Matrix PX;     // P * X
+    Eigen::JacobiSVD<Matrix3, Eigen::ComputeFullU | Eigen::ComputeFullV> svd;
 };
+
+using CoherentPointDrift = CoherentPointDriftT<>;
 }    // namespace atcg
\ No newline at end of file
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <Math/Utils.h>
+
+namespace atcg
+{
+/**
+ * @brief The method used to compute the posterior probabilities in the E-step
+ */
+enum class EStepMethod
+{
+    Direct = 0,           // Evaluate all MxN gaussians
+    FastGaussTransform    // Approximate the gaussian sums with the Improved Fast Gauss Transform
+};
+
+/**
+ * @brief The E-step of the CPD algorithms.
+ * The posterior of the GMM centroid t_m given the point x_n is
+ * P(m, n) = exp(-||x_n - t_m||^2 / (2 * var)) / (sum_k exp(-||x_n - t_k||^2 / (2 * var)) + bias).
+ * The M-steps only need the sufficient statistics P1 = P * 1, PT1 = P^T * 1 and PX = P * X, so the MxN matrix P is
+ * never stored.
+ * The functions are instantiated for <double, double>, <float, double> and <float, float>. Scalar is the precision of
+ * the points, the gaussians and the statistics, Accumulator the precision of the normalizations and of the sums over
+ * all points.
+ */
+namespace EStep
+{
+/**
+ * @brief Compute the statistics exactly.
+ * The points are processed in blocks on the thread pool, every block accumulates its own P1 and PX. The centroids
+ * are swept in cache-sized tiles, so the points of a block share every tile while it is in the cache.
+ * This needs O(N + M) memory per thread.
+ *
+ * @tparam Scalar The precision of the data
+ * @tparam Accumulator The precision of the sums
+ * @param X The data points (Nx3)
+ * @param T The transformed GMM centroids (Mx3)
+ * @param var The variance
+ * @param bias The contribution of the uniform outlier distribution to the normalization
+ * @param P1 P * 1 (M)
+ * @param PT1 P^T * 1 (N)
+ * @param PX P * X (Mx3)
+ */
+template<typename Scalar, typename Accumulator = double>
+void direct(const RowMatrixT<Scalar>& X,
+            const RowMatrixT<Scalar>& T,
+            const double& var,
+            const double& bias,
+            VectorT<Scalar>& P1,
+            VectorT<Scalar>& PT1,
+            RowMatrixT<Scalar>& PX);
+
+/**
+ * @brief Approximate the statistics with two fast gauss transforms.
+ * The transforms are always evaluated in double precision. If their cost model predicts no gain over evaluating all
+ * pairs, the statistics are computed with direct instead.
+ *
+ * @tparam Scalar The precision of the data
+ * @tparam Accumulator The precision of the sums
+ * @param X The data points (Nx3)
+ * @param T The transformed GMM centroids (Mx3)
+ * @param var The variance
+ * @param bias The contribution of the uniform outlier distribution to the normalization
+ * @param epsilon The accuracy of the fast gauss transform
+ * @param P1 P * 1 (M)
+ * @param PT1 P^T * 1 (N)
+ * @param PX P * X (Mx3)
+ */
+template<typename Scalar, typename Accumulator = double>
+void fast_gauss_transform(const RowMatrixT<Scalar>& X,
+                          const RowMatrixT<Scalar>& T,
+                          const double& var,
+                          const double& bias,
+                          const double& epsilon,
+                          VectorT<Scalar>& P1,
+                          VectorT<Scalar>& PT1,
+                          RowMatrixT<Scalar>& PX);
+
+/**
+ * @brief Compute the statistics with the given method
+ *
+ * @tparam Scalar The precision of the data
+ * @tparam Accumulator The precision of the sums
+ * @param method The E-step method
+ * @param X The data points (Nx3)
+ * @param T The transformed GMM centroids (Mx3)
+ * @param var The variance
+ * @param w The weight of the uniform outlier distribution
+ * @param epsilon The accuracy of the fast gauss transform (only used with EStepMethod::FastGaussTransform)
+ * @param P1 P * 1 (M)
+ * @param PT1 P^T * 1 (N)
+ * @param PX P * X (Mx3)
+ */
+template<typename Scalar, typename Accumulator = double>
+void compute(const EStepMethod& method,
+             const RowMatrixT<Scalar>& X,
+             const RowMatrixT<Scalar>& T,
+             const double& var,
+             const double& w,
+             const double& epsilon,
+             VectorT<Scalar>& P1,
+             VectorT<Scalar>& PT1,
+             RowMatrixT<Scalar>& PX);
+}    // namespace EStep
+}    // namespace atcg
\ No newline at end of file
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <Math/Utils.h>
+
+#include <vector>
+
+namespace atcg
+{
+/**
+ * @brief This class models the Improved Fast Gauss Transform (Yang et al. 2003).
+ * It approximates the discrete Gauss transform
+ * G(y_j) = sum_i q_i * exp(-||y_j - x_i||^2 / h^2)
+ * for N source points x_i and M target points y_j in O(N + M) instead of O(NM).
+ * The sources are clustered with farthest point clustering and each cluster is represented by a truncated Taylor
+ * series around its center. If the bandwidth is too small for a reasonable truncation order, the transform falls back
+ * to an exact evaluation that only visits clusters inside the cutoff radius.
+ * The clustering, the coefficients of the clusters and the targets are processed in parallel on the thread pool.
+ */
+class FastGaussTransform
+{
+public:
+    /**
+     * @brief Create a new transform.
+     * This clusters the source points and chooses the number of clusters and the truncation order
+     *
+     * @param sources The source points (Nx3)
+     * @param h The bandwidth of the gaussian
+     * @param epsilon The desired accuracy (relative to the sum of absolute weights)
+     */
+    FastGaussTransform(const RowMatrix& sources, const double& h, const double& epsilon = 1e-3);
+
+    /**
+     * @brief Destroy the transform
+     */
+    ~FastGaussTransform();
+
+    /**
+     * @brief Evaluate the transform.
+     * Each column of the weight matrix defines its own transform. Evaluating several columns at once shares the
+     * clustering and the monomial evaluations.
+     *
+     * @param weights The weights of the source points (NxW)
+     * @param targets The target points (Mx3)
+     * @return The transforms evaluated at the target points (MxW)
+     */
+    RowMatrix compute(const RowMatrix& weights, const RowMatrix& targets) const;
+
+    /**
+     * @brief Get the number of clusters
+     *
+     * @return The number of clusters
+     */
+    inline uint32_t num_clusters() const { return _K; }
+
+    /**
+     * @brief Get the truncation order of the Taylor series.
+     * A truncation order of zero means that the transform is evaluated exactly inside the cutoff radius
+     *
+     * @return The truncation order
+     */
+    inline uint32_t truncation_order() const { return _p; }
+
+    /**
+     * @brief Check if the cost model predicts that the transform is cheaper than evaluating all pairs directly.
+     * Like the choice of the parameters, this assumes as many targets as sources
+     *
+     * @return True if the transform is expected to pay off
+     */
+    inline bool pays_off() const { return _cost < _direct_cost; }
+
+private:
+    void chooseParameters();
+    void cluster();
+    void computeMonomials(const double* d, double* monomials) const;
+
+    RowMatrix computeTaylor(const RowMatrix& weights, const RowMatrix& targets) const;
+    RowMatrix computeDirect(const RowMatrix& weights, const RowMatrix& targets) const;
+
+    RowMatrix _sources;    // Source points sorted by cluster
+    double _h       = 1.0;
+    double _epsilon = 1e-3;
+
+    uint32_t _K     = 1;      // Number of clusters
+    uint32_t _p     = 0;      // Truncation order
+    uint32_t _terms = 0;      // Number of monomials of degree < p
+    double _rx      = 0.0;    // Maximum cluster radius
+    double _ry      = 0.0;    // Cutoff radius between target and cluster center
+
+    double _cost        = 0.0;    // Predicted cost of the chosen parameters
+    double _direct_cost = 0.0;    // Predicted cost of the direct evaluation
+
+    RowMatrix _centers;
+    std::vector<uint32_t> _cluster_offsets;    // Start of each cluster in _cluster_points (size K + 1)
+    std::vector<uint32_t> _cluster_points;     // Original index of each sorted source point
+    std::vector<double> _constants;            // 2^|alpha| / alpha! for every monomial
+};
+}    // namespace atcg
\ No newline at end of file
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <Registration/Normals.h>
+#include <DataStructure/PointCloud.h>
+
+#include <Eigen/Core>
+
+#include <memory>
+#include <vector>
+
+namespace atcg
+{
+/**
+ * @brief The number of bins of a FPFH descriptor (11 per angular feature)
+ */
+constexpr uint32_t FPFH_SIZE = 33;
+
+/**
+ * @brief Compute the Fast Point Feature Histograms (Rusu et al. 2009) of a point set.
+ * The simplified histograms of the angles between each point and its k nearest neighbors are computed first and
+ * then blended with the histograms of the neighbors, weighted with the inverse distance. Each of the three angular
+ * sub-histograms sums to 100. Both passes run in parallel
+ *
+ * @param points The points (Nx3)
+ * @param normals The normals of the points (Nx3)
+ * @param neighbors The number of neighbors
+ * @return The descriptors (NxFPFH_SIZE)
+ */
+RowMatrixT<float>
+compute_fpfh(const RowMatrixT<double>& points, const RowMatrixT<double>& normals, const uint32_t& neighbors = 50);
+
+/**
+ * @brief Global rigid registration with FPFH feature matching and RANSAC.
+ * Every target point is matched to the source point with the closest descriptor through an approximate kd-tree
+ * search. Hypotheses are fitted to three random matches. Before a hypothesis is scored, the samples must have
+ * similar edge lengths in both clouds and must be aligned by the fitted transformation. The hypotheses are split
+ * among the threads of the pool and every thread scores its own ones. The scoring of a hypothesis stops as soon as
+ * it cannot beat the best one of its thread. The best hypothesis is refined on its inliers.
+ * The result uses the same convention as the CPD algorithms (y -> R * y + t moves the target onto the source), so it
+ * can be passed to their setTransform. The clouds should be downsampled to a few thousand points beforehand, e.g.
+ * with voxel_downsample
+ */
+class FeatureRegistration
+{
+public:
+    /**
+     * @brief Compute the descriptors of both clouds and match them
+     *
+     * @param source The source point cloud
+     * @param target The target point cloud
+     * @param neighbors The number of neighbors of the normals and descriptors
+     * @param max_distance The largest distance of an inlier. Zero uses three times the mean distance of the target
+     * points to their nearest neighbor
+     */
+    FeatureRegistration(const std::shared_ptr<PointCloud>& source,
+                        const std::shared_ptr<PointCloud>& target,
+                        const uint32_t& neighbors   = 30,
+                        const double& max_distance = 0.0);
+
+    /**
+     * @brief Run RANSAC
+     *
+     * @param iterations The number of hypotheses
+     * @param seed The seed of the random sampling. Together with the number of threads, it determines the result
+     */
+    void solve(const uint32_t& iterations = 100000, const uint32_t& seed = 42);
+
+    /**
+     * @brief Apply the transformation to a point cloud
+     *
+     * @param cloud The point cloud to transform
+     */
+    void applyTransform(const std::shared_ptr<PointCloud>& cloud);
+
+    /**
+     * @brief Get the rotation
+     *
+     * @return The rotation
+     */
+    inline Eigen::Matrix3d getRotation() const { return R; }
+
+    /**
+     * @brief Get the translation
+     *
+     * @return The translation
+     */
+    inline Eigen::Vector3d getTranslation() const { return t; }
+
+    /**
+     * @brief Get the fraction of the feature matches that agree with the transformation
+     *
+     * @return The inlier ratio
+     */
+    inline double getInlierRatio() const { return inlier_ratio; }
+
+private:
+    // Shared with the point clouds, e.g. with a registration that refines the result
+    std::shared_ptr<const RowMatrixT<double>> source_points;
+    std::shared_ptr<const RowMatrixT<double>> target_points;
+    const RowMatrixT<double>& X;    // Source points
+    const RowMatrixT<double>& Y;    // Target points
+    double max_distance;
+
+    std::vector<uint32_t> matches;    // Source point whose descriptor is closest to the one of each target point
+
+    Eigen::Matrix3d R   = Eigen::Matrix3d::Identity();
+    Eigen::Vector3d t   = Eigen::Vector3d::Zero();
+    double inlier_ratio = 0.0;
+};
+}    // namespace atcg
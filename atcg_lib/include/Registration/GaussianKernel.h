@@ -0,0 +1,140 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace atcg
+{
+/**
+ * @brief The instruction sets of the vectorized gaussian kernel
+ */
+enum class SIMDLevel
+{
+    Scalar = 0,
+    SSE2,
+    AVX2,
+    AVX512
+};
+
+/**
+ * @brief Enables flush-to-zero and denormals-are-zero for the calling thread during its lifetime.
+ * Single precision affinities of distant points and their products underflow into denormals, which x86 CPUs process
+ * in microcode at a fraction of the normal speed. Affected values are below 1.2e-38 and do not change the sums.
+ */
+class DenormalGuard
+{
+public:
+    DenormalGuard();
+
+    ~DenormalGuard();
+
+private:
+    uint32_t _state = 0;
+};
+
+/**
+ * @brief Vectorized evaluation of the gaussian affinities exp(scale * ||x - t_m||^2) of one point x against a tile of
+ * points t_m that are stored as structure of arrays.
+ * The best instruction set supported by the CPU is selected at runtime. The vectorized paths use their own exp
+ * implementation whose relative error to std::exp is below 1e-15. Arguments below -708 (where std::exp returns
+ * denormals) are flushed to zero, so the absolute error is additionally bounded by 3e-308.
+ * The AVX paths compute the squared distances with fused multiply adds. The rounding of the exponent differs by at
+ * most one ulp from the scalar path, which amounts to a relative difference of up to |scale * d^2| * 1e-16.
+ * The single precision overloads process twice as many points per instruction. Their exp has a relative error below
+ * 3e-7 and flushes arguments below -87 to zero. The returned sums are always accumulated in double precision.
+ */
+namespace GaussianKernel
+{
+/**
+ * @brief Get the best instruction set that is supported by the CPU
+ *
+ * @return The instruction set
+ */
+SIMDLevel simd_level();
+
+/**
+ * @brief Evaluate the kernel with the best instruction set
+ *
+ * @param x The point (3 values)
+ * @param tx The x coordinates of the tile
+ * @param ty The y coordinates of the tile
+ * @param tz The z coordinates of the tile
+ * @param count The number of points in the tile
+ * @param scale The (negative) scale of the squared distance, i.e. -1 / (2 * var)
+ * @param result The affinities (count values)
+ * @return The sum of the affinities
+ */
+double evaluate(const double* x,
+                const double* tx,
+                const double* ty,
+                const double* tz,
+                const size_t& count,
+                const double& scale,
+                double* result);
+
+/**
+ * @brief Evaluate the kernel with a specific instruction set.
+ * Falls back to the best supported instruction set if the requested one is not available
+ *
+ * @param level The instruction set
+ * @param x The point (3 values)
+ * @param tx The x coordinates of the tile
+ * @param ty The y coordinates of the tile
+ * @param tz The z coordinates of the tile
+ * @param count The number of points in the tile
+ * @param scale The (negative) scale of the squared distance, i.e. -1 / (2 * var)
+ * @param result The affinities (count values)
+ * @return The sum of the affinities
+ */
+double evaluate(const SIMDLevel& level,
+                const double* x,
+                const double* tx,
+                const double* ty,
+                const double* tz,
+                const size_t& count,
+                const double& scale,
+                double* result);
+/**
+ * @brief Evaluate the kernel with the best instruction set in single precision
+ *
+ * @param x The point (3 values)
+ * @param tx The x coordinates of the tile
+ * @param ty The y coordinates of the tile
+ * @param tz The z coordinates of the tile
+ * @param count The number of points in the tile
+ * @param scale The (negative) scale of the squared distance, i.e. -1 / (2 * var)
+ * @param result The affinities (count values)
+ * @return The sum of the affinities
+ */
+double evaluate(const float* x,
+                const float* tx,
+                const float* ty,
+                const float* tz,
+                const size_t& count,
+                const float& scale,
+                float* result);
+
+/**
+ * @brief Evaluate the kernel with a specific instruction set in single precision.
+ * Falls back to the best supported instruction set if the requested one is not available
+ *
+ * @param level The instruction set
+ * @param x The point (3 values)
+ * @param tx The x coordinates of the tile
+ * @param ty The y coordinates of the tile
+ * @param tz The z coordinates of the tile
+ * @param count The number of points in the tile
+ * @param scale The (negative) scale of the squared distance, i.e. -1 / (2 * var)
+ * @param result The affinities (count values)
+ * @return The sum of the affinities
+ */
+double evaluate(const SIMDLevel& level,
+                const float* x,
+                const float* tx,
+                const float* ty,
+                const float* tz,
+                const size_t& count,
+                const float& scale,
+                float* result);
+}    // namespace GaussianKernel
+}    // namespace atcg
\ No newline at end of file
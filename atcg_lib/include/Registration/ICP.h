@@ -0,0 +1,128 @@
+#pragma once
+
+#include <Registration/Registration.h>
+
+#include <memory>
+#include <vector>
+
+namespace atcg
+{
+/**
+ * @brief The error that is minimized in every ICP iteration
+ */
+enum class ICPMethod
+{
+    PointToPoint = 0,    // Squared distances between the correspondences (closed form with an SVD)
+    PointToPlane         // Squared distances along the target normals (linearized rotation, 6x6 solve)
+};
+
+/**
+ * @brief Rigid Iterative Closest Point (Besl and McKay 1992, Chen and Medioni 1992).
+ * A kd-tree over the target is built once. Instead of moving the target, the source points are moved into the
+ * frame of the target with the inverse transformation to find their correspondences. Only the fraction of the
+ * correspondences with the smallest distances is used (trimmed ICP, Chetverikov et al. 2002).
+ * Correspondence search and accumulation run in parallel on the thread pool.
+ *
+ * @tparam Scalar The precision of the point data and the kd-tree
+ */
+template<typename Scalar = double>
+class IterativeClosestPointT : public RegistrationT<Scalar>
+{
+public:
+    using Matrix = typename RegistrationT<Scalar>::Matrix;
+    using Vector = typename RegistrationT<Scalar>::Vector;
+
+    /**
+     * @brief Create an ICP registration.
+     * For point to plane, the target normals are estimated with estimate_normals
+     *
+     * @param source The source point cloud
+     * @param target The target point cloud
+     * @param method The error to minimize
+     * @param trim The fraction of correspondences that are kept in each iteration (0, 1]. At least 6 correspondences
+     * are kept for point to plane and 3 for point to point, the fewest that determine the transformation
+     * @param neighbors The number of neighbors for the normal estimation (only used with ICPMethod::PointToPlane)
+     */
+    IterativeClosestPointT(const std::shared_ptr<PointCloud>& source,
+                           const std::shared_ptr<PointCloud>& target,
+                           const ICPMethod& method   = ICPMethod::PointToPlane,
+                           const double& trim        = 0.9,
+                           const uint32_t& neighbors = 10);
+
+    /**
+     * @brief Create an ICP registration of a new source against the target of another registration.
+     * The parameters, the target points, the kd-tree and the normals are shared with the reference
+     *
+     * @param source The source point cloud
+     * @param reference The registration whose target is used
+     */
+    IterativeClosestPointT(const std::shared_ptr<PointCloud>& source, const IterativeClosestPointT<Scalar>& reference);
+
+    virtual ~IterativeClosestPointT();
+
+    /**
+     * @brief Iterate until the change of the variance (mean squared distance of the kept correspondences divided by
+     * the dimension) is below tol
+     *
+     * @param maxN The maximum number of iterations
+     * @param tol The tolerance of the variance change
+     */
+    virtual void solve(const uint32_t& maxN, const float& tol = 0.01f) override;
+
+    virtual void applyTransform(const std::shared_ptr<PointCloud>& cloud) override;
+
+    /**
+     * @brief Set the transformation y -> R * y + t that the next call of solve starts with
+     *
+     * @param R The rotation
+     * @param t The translation
+     */
+    void setTransform(const Eigen::Matrix3d& R, const Eigen::Vector3d& t);
+
+    /**
+     * @brief Get the rotation
+     *
+     * @return The rotation
+     */
+    inline Eigen::Matrix3d getRotation() const { return R; }
+
+    /**
+     * @brief Get the translation
+     *
+     * @return The translation
+     */
+    inline Eigen::Vector3d getTranslation() const { return t; }
+
+private:
+    using RegistrationT<Scalar>::X;
+    using RegistrationT<Scalar>::Y;
+    using RegistrationT<Scalar>::N;
+    using RegistrationT<Scalar>::M;
+    using RegistrationT<Scalar>::var;
+
+    struct KDTree;
+
+    double correspond();
+    void align_point_to_point();
+    void align_point_to_plane();
+
+    virtual Matrix transformedTarget() const override;
+
+    ICPMethod method   = ICPMethod::PointToPlane;
+    double trim        = 0.9;
+    uint32_t neighbors = 10;
+
+    Eigen::Matrix3d R = Eigen::Matrix3d::Identity();
+    Eigen::Vector3d t = Eigen::Vector3d::Zero();
+
+    // Only depend on the target and are shared with registrations created from this one
+    std::shared_ptr<const KDTree> tree;
+    std::shared_ptr<const Matrix> normals;    // Target normals (Mx3)
+
+    std::vector<uint32_t> correspondence;    // Closest target point of each source point
+    std::vector<Scalar> distance;            // Squared distance to it
+    Scalar threshold = 0;                    // Largest squared distance that is kept
+};
+
+using IterativeClosestPoint = IterativeClosestPointT<>;
+}    // namespace atcg
@@ -0,0 +1,261 @@
+#pragma once
+
+#include <Registration/CPD.h>
+#include <Registration/AffineCPD.h>
+#include <Registration/NonRigidCPD.h>
+#include <DataStructure/ChunkedPointCloud.h>
+
+#include <functional>
+#include <limits>
+#include <vector>
+
+namespace atcg
+{
+/**
+ * @brief Downsample a point cloud by replacing the points inside each voxel with their centroid.
+ * The voxels are hashed with an atcg::Grid that spans the bounding box of the cloud. Only positions are kept
+ *
+ * @param cloud The point cloud
+ * @param voxel_length The side length of a voxel
+ * @return The downsampled point cloud
+ */
+std::shared_ptr<PointCloud> voxel_downsample(const std::shared_ptr<PointCloud>& cloud, const float& voxel_length);
+
+/**
+ * @brief Downsample an out-of-core point cloud by replacing the points inside each voxel with their centroid.
+ * The voxels form a grid anchored at the origin, so voxels that span several chunks are merged. The chunks are
+ * processed in parallel and only the centroids are kept in memory. Only positions are kept
+ *
+ * @param cloud The chunked point cloud
+ * @param voxel_length The side length of a voxel
+ * @return The downsampled point cloud
+ */
+std::shared_ptr<PointCloud> voxel_downsample(const std::shared_ptr<ChunkedPointCloud>& cloud,
+                                             const float& voxel_length);
+
+/**
+ * @brief How subsample picks its points
+ */
+enum class SubsampleMethod
+{
+    Random = 0,      // Uniformly at random without replacement
+    FarthestPoint    // Greedily add the point that is farthest from all picked points (even coverage)
+};
+
+/**
+ * @brief Pick a subset of the points of a cloud.
+ * Farthest point sampling costs O(count * n), the distance updates run in parallel. Only positions are kept
+ *
+ * @param cloud The point cloud
+ * @param count The number of points to keep. The whole cloud is copied if it has at most count points
+ * @param method How the points are picked
+ * @param seed The seed of the random selection (and of the first farthest point)
+ * @return The subsampled point cloud
+ */
+std::shared_ptr<PointCloud> subsample(const std::shared_ptr<PointCloud>& cloud,
+                                      const uint32_t& count,
+                                      const SubsampleMethod& method = SubsampleMethod::FarthestPoint,
+                                      const uint32_t& seed          = 42);
+
+namespace detail
+{
+// Rigid and affine levels start with the transformation of the coarser level
+template<typename Scalar, typename Accumulator>
+std::shared_ptr<PointCloud>
+warm_start_target(const std::vector<std::shared_ptr<CoherentPointDriftT<Scalar, Accumulator>>>& /*coarser*/,
+                  const std::shared_ptr<PointCloud>& target)
+{
+    return target;
+}
+
+template<typename Scalar, typename Accumulator>
+void warm_start(const CoherentPointDriftT<Scalar, Accumulator>& coarse,
+                CoherentPointDriftT<Scalar, Accumulator>& fine,
+                const double& min_var)
+{
+    fine.setTransform(coarse.getScale(), coarse.getRotation(), coarse.getTranslation());
+    fine.setVariance(std::max(coarse.getVariance(), min_var));
+}
+
+template<typename Scalar, typename Accumulator>
+std::shared_ptr<PointCloud>
+warm_start_target(const std::vector<std::shared_ptr<AffineCoherentPointDriftT<Scalar, Accumulator>>>& /*coarser*/,
+                  const std::shared_ptr<PointCloud>& target)
+{
+    return target;
+}
+
+template<typename Scalar, typename Accumulator>
+void warm_start(const AffineCoherentPointDriftT<Scalar, Accumulator>& coarse,
+                AffineCoherentPointDriftT<Scalar, Accumulator>& fine,
+                const double& min_var)
+{
+    fine.setTransform(coarse.getAffine(), coarse.getTranslation());
+    fine.setVariance(std::max(coarse.getVariance(), min_var));
+}
+
+// The coefficients of non-rigid levels belong to their own target points. Instead, the target of a finer level is
+// moved along the smoothed displacement fields of all coarser levels and registered from there. The smoothed field
+// stays bounded between the coarse target points, G(p, Y) * W brings the finer level to a worse start
+template<typename Scalar, typename Accumulator>
+std::shared_ptr<PointCloud>
+warm_start_target(const std::vector<std::shared_ptr<NonRigidCoherentPointDriftT<Scalar, Accumulator>>>& coarser,
+                  const std::shared_ptr<PointCloud>& target)
+{
+    RowMatrixT<Scalar> points = target->asMatrix<Scalar>();
+    for(const auto& registration: coarser) { points += registration->displacement(points, true); }
+
+    auto result = std::make_shared<PointCloud>();
+    result->resize(points.rows());
+    result->points() = points.template cast<float>();
+    return result;
+}
+
+template<typename Scalar, typename Accumulator>
+void warm_start(const NonRigidCoherentPointDriftT<Scalar, Accumulator>& coarse,
+                NonRigidCoherentPointDriftT<Scalar, Accumulator>& fine,
+                const double& min_var)
+{
+    fine.setVariance(std::max(coarse.getVariance(), min_var));
+}
+}    // namespace detail
+
+/**
+ * @brief Coarse-to-fine driver for the CPD algorithms.
+ * Source and target are downsampled to a voxel pyramid. The registration is solved on the coarsest level first and
+ * every finer level starts with the variance and the transformation of the level below. The variance is kept at least
+ * as large as the squared voxel length of the level below because the centroids only resolve the points up to a
+ * voxel. The finest level is the full resolution point cloud.
+ *
+ * @tparam RegistrationType The registration (CoherentPointDriftT, AffineCoherentPointDriftT or
+ * NonRigidCoherentPointDriftT)
+ */
+template<class RegistrationType>
+class MultiResolutionRegistration
+{
+public:
+    /**
+     * @brief Create a multiresolution registration
+     *
+     * @param source The source point cloud
+     * @param target The target point cloud
+     * @param levels The number of levels including the full resolution
+     * @param voxel_length The voxel side length of the coarsest level. It halves with every finer level. If it is
+     * zero, 1/32 of the bounding box diagonal of both clouds is used
+     * @param args Additional arguments for the constructor of each level's registration
+     */
+    template<typename... Args>
+    MultiResolutionRegistration(const std::shared_ptr<PointCloud>& source,
+                                const std::shared_ptr<PointCloud>& target,
+                                const uint32_t& levels     = 3,
+                                const float& voxel_length = 0.0f,
+                                const Args&... args);
+
+    /**
+     * @brief Solve all levels from coarse to fine
+     *
+     * @param maxN The maximum number of iterations per level
+     * @param tol The tolerance of the variance change per level
+     */
+    void solve(const uint32_t& maxN, const float& tol = 0.01f);
+
+    /**
+     * @brief Apply the transformation of the finest level
+     *
+     * @param cloud The point cloud to transform
+     */
+    void applyTransform(const std::shared_ptr<PointCloud>& cloud);
+
+    /**
+     * @brief Get the registration of a level. Level 0 is the full resolution.
+     * Only valid after solve
+     *
+     * @param level The level
+     * @return The registration
+     */
+    inline std::shared_ptr<RegistrationType> getRegistration(const uint32_t& level) const
+    {
+        return _registrations[_registrations.size() - 1 - level];
+    }
+
+private:
+    std::shared_ptr<PointCloud> _source;
+    std::shared_ptr<PointCloud> _target;
+    uint32_t _levels    = 3;
+    float _voxel_length = 0.0f;
+
+    std::function<std::shared_ptr<RegistrationType>(const std::shared_ptr<PointCloud>&,
+                                                     const std::shared_ptr<PointCloud>&)>
+        _create;
+    std::vector<std::shared_ptr<RegistrationType>> _registrations;    // Coarse to fine
+};
+
+///
+/// Implementation
+///
+
+template<class RegistrationType>
+template<typename... Args>
+MultiResolutionRegistration<RegistrationType>::MultiResolutionRegistration(const std::shared_ptr<PointCloud>& source,
+                                                                           const std::shared_ptr<PointCloud>& target,
+                                                                           const uint32_t& levels,
+                                                                           const float& voxel_length,
+                                                                           const Args&... args)
+    : _source(source),
+      _target(target),
+      _levels(std::max(levels, 1u)),
+      _voxel_length(voxel_length)
+{
+    _create = [args...](const std::shared_ptr<PointCloud>& source, const std::shared_ptr<PointCloud>& target)
+    { return std::make_shared<RegistrationType>(source, target, args...); };
+
+    if(_voxel_length <= 0.0f)
+    {
+        Eigen::Vector3f min = Eigen::Vector3f::Constant(std::numeric_limits<float>::max());
+        Eigen::Vector3f max = Eigen::Vector3f::Constant(std::numeric_limits<float>::lowest());
+        for(const auto& cloud: {source, target})
+        {
+            if(cloud->n_vertices() == 0) continue;
+            const auto points = cloud->cpoints();
+            min               = min.cwiseMin(points.colwise().minCoeff().transpose());
+            max               = max.cwiseMax(points.colwise().maxCoeff().transpose());
+        }
+        _voxel_length = (max - min).norm() / 32.0f;
+    }
+}
+
+template<class RegistrationType>
+void MultiResolutionRegistration<RegistrationType>::solve(const uint32_t& maxN, const float& tol)
+{
+    _registrations.clear();
+    float coarse_length = 0.0f;
+    for(int32_t level = static_cast<int32_t>(_levels) - 1; level >= 0; --level)
+    {
+        float voxel_length                 = _voxel_length / static_cast<float>(1u << (_levels - 1 - level));
+        std::shared_ptr<PointCloud> source = _source;
+        std::shared_ptr<PointCloud> target = _target;
+        if(level > 0)
+        {
+            source = voxel_downsample(_source, voxel_length);
+            target = voxel_downsample(_target, voxel_length);
+        }
+
+        std::shared_ptr<RegistrationType> registration =
+            _create(source, detail::warm_start_target(_registrations, target));
+        if(!_registrations.empty())
+        {
+            detail::warm_start(*_registrations.back(), *registration, coarse_length * coarse_length);
+        }
+
+        registration->solve(maxN, tol);
+        _registrations.push_back(registration);
+        coarse_length = voxel_length;
+    }
+}
+
+template<class RegistrationType>
+void MultiResolutionRegistration<RegistrationType>::applyTransform(const std::shared_ptr<PointCloud>& cloud)
+{
+    _registrations.back()->applyTransform(cloud);
+}
+}    // namespace atcg
\ No newline at end of file
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <Registration/Registration.h>
+
+#include <memory>
+
+namespace atcg
+{
+/**
+ * @brief Rigid Normal Distributions Transform registration (Biber and Strasser 2003, Magnusson 2009).
+ * The target is voxelized once into an atcg::Grid. Every voxel with enough points stores the mean and the inverse
+ * covariance of its points. Instead of moving the target, the source points are moved into the frame of the target
+ * with the inverse transformation. Each one is scored against the Gaussians of its voxel and of the six voxels that
+ * share a face with it. The pose is optimized with Newton's method and a backtracking line search. An iteration only
+ * touches the source points and a constant number of voxels per point, so its cost does not depend on the size of
+ * the target. The source points are processed in parallel on the thread pool.
+ *
+ * @tparam Scalar The precision of the point data
+ */
+template<typename Scalar = double>
+class NormalDistributionsTransformT : public RegistrationT<Scalar>
+{
+public:
+    using Matrix = typename RegistrationT<Scalar>::Matrix;
+    using Vector = typename RegistrationT<Scalar>::Vector;
+
+    /**
+     * @brief Create a NDT registration.
+     * The voxels should hold a few dozen target points and be larger than the initial misalignment
+     *
+     * @param source The source point cloud
+     * @param target The target point cloud
+     * @param resolution The side length of a voxel
+     * @param outlier_ratio The expected fraction of source points without a counterpart in the target [0, 1)
+     */
+    NormalDistributionsTransformT(const std::shared_ptr<PointCloud>& source,
+                                  const std::shared_ptr<PointCloud>& target,
+                                  const double& resolution,
+                                  const double& outlier_ratio = 0.55);
+
+    /**
+     * @brief Create a NDT registration of a new source against the target of another registration.
+     * The parameters, the target points and the voxels are shared with the reference
+     *
+     * @param source The source point cloud
+     * @param reference The registration whose target is used
+     */
+    NormalDistributionsTransformT(const std::shared_ptr<PointCloud>& source,
+                                  const NormalDistributionsTransformT<Scalar>& reference);
+
+    virtual ~NormalDistributionsTransformT();
+
+    /**
+     * @brief Iterate until the change of the variance (mean squared distance of the source points to the mean of
+     * their voxel divided by the dimension) is below tol or a Newton step does not improve the score anymore
+     *
+     * @param maxN The maximum number of iterations
+     * @param tol The tolerance of the variance change
+     */
+    virtual void solve(const uint32_t& maxN, const float& tol = 0.01f) override;
+
+    virtual void applyTransform(const std::shared_ptr<PointCloud>& cloud) override;
+
+    /**
+     * @brief Set the transformation y -> R * y + t that the next call of solve starts with
+     *
+     * @param R The rotation
+     * @param t The translation
+     */
+    void setTransform(const Eigen::Matrix3d& R, const Eigen::Vector3d& t);
+
+    /**
+     * @brief Get the rotation
+     *
+     * @return The rotation
+     */
+    inline Eigen::Matrix3d getRotation() const { return R; }
+
+    /**
+     * @brief Get the translation
+     *
+     * @return The translation
+     */
+    inline Eigen::Vector3d getTranslation() const { return t; }
+
+    /**
+     * @brief Get the NDT score after the last call of solve.
+     * It is the negative sum of the Gaussians at the source points, so it decreases as the alignment improves
+     *
+     * @return The score
+     */
+    inline double getScore() const { return score; }
+
+private:
+    using RegistrationT<Scalar>::X;
+    using RegistrationT<Scalar>::Y;
+    using RegistrationT<Scalar>::N;
+    using RegistrationT<Scalar>::M;
+    using RegistrationT<Scalar>::var;
+
+    struct Voxels;
+    struct Evaluation;
+
+    void voxelize();
+    Evaluation evaluate(const Eigen::Matrix3d& R_inv, const Eigen::Vector3d& t_inv, const bool& derivatives) const;
+    bool step();
+
+    virtual Matrix transformedTarget() const override;
+
+    double resolution    = 1.0;
+    double outlier_ratio = 0.55;
+    double d1 = 0.0, d2 = 0.0;    // Parameters of the Gaussian approximation of the mixture with the outlier term
+
+    Eigen::Matrix3d R = Eigen::Matrix3d::Identity();
+    Eigen::Vector3d t = Eigen::Vector3d::Zero();
+    double score      = 0.0;
+
+    // Only depends on the target and is shared with registrations created from this one
+    std::shared_ptr<Voxels> voxels;
+};
+
+using NormalDistributionsTransform = NormalDistributionsTransformT<>;
+}    // namespace atcg
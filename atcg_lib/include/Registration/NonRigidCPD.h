@@ -1,38 +1,159 @@
 #pragma once
 
 #include <Registration/Registration.h>
+#include <Registration/EStep.h>
 #include <Eigen/SVD>
+#include <Eigen/Sparse>
 
 namespace atcg
 {
-class NonRigidCoherentPointDrift : public Registration
+/**
+ * @brief The representation of the gaussian motion coherence matrix G
+ */
+enum class MotionCoherenceMethod
+{
+    Dense = 0,    // Store the full MxM matrix and solve the M-step with a dense LU decomposition
+    LowRank,      // Keep the largest eigenpairs of G and solve the M-step with the Woodbury identity
+    Iterative,    // Never form G, solve the M-step with conjugate gradients and evaluate the products on the fly
+    Sparse        // Drop the entries of G beyond a cutoff radius and solve the M-step with a sparse LDLT decomposition.
+                  // An M-step whose decomposition fails or is indefinite falls back to conjugate gradients on the
+                  // sparse matrix
+};
+
+/**
+ * @brief Non-rigid Coherent Point Drift (Myronenko and Song 2010)
+ *
+ * @tparam Scalar The precision of the point data, the E-step and the M-step solve
+ * @tparam Accumulator The precision of the sums over all points (normalizations and the variance update). Use double
+ * with float data for mixed precision
+ */
+template<typename Scalar = double, typename Accumulator = double>
+class NonRigidCoherentPointDriftT : public RegistrationT<Scalar>
 {
 public:
-    NonRigidCoherentPointDrift(const std::shared_ptr<PointCloud>& source,
-                               const std::shared_ptr<PointCloud>& target,
-                               const double& w = 0.0);
+    using Matrix = typename RegistrationT<Scalar>::Matrix;
+    using Vector = typename RegistrationT<Scalar>::Vector;
+
+    /**
+     * @brief Create a non-rigid CPD registration
+     *
+     * @param source The source point cloud
+     * @param target The target point cloud
+     * @param w The weight of the uniform outlier distribution
+     * @param method The representation of the motion coherence matrix
+     * @param rank The number of eigenpairs (only used with MotionCoherenceMethod::LowRank)
+     */
+    NonRigidCoherentPointDriftT(const std::shared_ptr<PointCloud>& source,
+                                const std::shared_ptr<PointCloud>& target,
+                                const double& w                     = 0.0,
+                                const MotionCoherenceMethod& method = MotionCoherenceMethod::Dense,
+                                const uint32_t& rank                = 64);
+
+    /**
+     * @brief Create a non-rigid CPD registration of a new source against the target of another registration.
+     * The parameters, the target points and the motion coherence matrix are shared with the reference
+     *
+     * @param source The source point cloud
+     * @param reference The registration whose target is used
+     */
+    NonRigidCoherentPointDriftT(const std::shared_ptr<PointCloud>& source,
+                                const NonRigidCoherentPointDriftT<Scalar, Accumulator>& reference);
 
-    virtual ~NonRigidCoherentPointDrift();
+    virtual ~NonRigidCoherentPointDriftT();
 
     virtual void solve(const uint32_t& maxN, const float& tol = 0.01f) override;
 
+    /**
+     * @brief Compute the motion coherence matrix G, its low rank factors or its sparse approximation. Nothing is stored
+     * for MotionCoherenceMethod::Iterative
+     */
+    virtual void prepare() override;
+
+    /**
+     * @brief Store the transformed target points in a point cloud.
+     * The cloud is resized to the M target points
+     *
+     * @param cloud The point cloud that receives the transformed target
+     */
     virtual void applyTransform(const std::shared_ptr<PointCloud>& cloud) override;
 
+    /**
+     * @brief Move an arbitrary point cloud along the displacement field, e.g. the full resolution cloud of a
+     * subsampled target. The field is evaluated at its points with displacement()
+     *
+     * @param cloud The point cloud to transform
+     * @param smooth Use the smoothed field instead of G(p, Y) * W, see displacement()
+     */
+    void applyDeformation(const std::shared_ptr<PointCloud>& cloud, const bool& smooth = false);
+
+    /**
+     * @brief Evaluate the displacement field v(p) = G(p, Y) * W at arbitrary points, with the gaussian kernel
+     * exp(-||p - y_m||^2 / (2 * beta^2)) of the solve. At the target points it matches applyTransform exactly for
+     * MotionCoherenceMethod::Dense and MotionCoherenceMethod::Iterative. MotionCoherenceMethod::LowRank first projects
+     * W onto the eigenvectors Q, so the field reproduces Q * Lambda * Q^T * W up to the accuracy of the eigenvectors.
+     * MotionCoherenceMethod::Sparse solves against the truncated kernel, so there it differs by the dropped entries.
+     * The smoothed field instead averages the target displacements (G * W)_m with the kernel weights, so every result
+     * is a convex combination of them. It stays bounded also far from the target, but does not interpolate them.
+     * The points are processed in parallel in O(K * M)
+     *
+     * @param points The points (Kx3)
+     * @param smooth Evaluate the smoothed field instead of G(p, Y) * W
+     * @return The displacements (Kx3)
+     */
+    Matrix displacement(const Matrix& points, const bool& smooth = false) const;
+
 private:
-    double initialize();
-    void estimate(Eigen::VectorXd& PX, Eigen::VectorXd& PY, double var);
-    double maximize(Eigen::VectorXd& PX, Eigen::VectorXd& PY, double var);
+    using RegistrationT<Scalar>::X;
+    using RegistrationT<Scalar>::Y;
+    using RegistrationT<Scalar>::N;
+    using RegistrationT<Scalar>::M;
+    using RegistrationT<Scalar>::var;
+
+    void initialize();
+    void estimate(double var);
+    double maximize(double var);
 
-    void direct_optimization(Eigen::VectorXd& PX, Eigen::VectorXd& PY, double bias, double var);
-    double Pmn(const Eigen::Vector3d& x, const Eigen::Vector3d& y, double var);
-    double Pmn(const double& L2S, double var);
+    virtual Matrix transformedTarget() const override;
+
+    using SparseMatrix = Eigen::SparseMatrix<Scalar>;
+
+    struct MotionCoherence
+    {
+        Matrix G;            // Dense
+        Matrix Q;            // Eigenvectors of G (low rank)
+        Vector Lambda;       // Eigenvalues of G (low rank)
+        SparseMatrix G_s;    // Entries of G within the cutoff radius (sparse)
+    };
+
+    void lowrank_decomposition(MotionCoherence& result) const;
+    void sparse_decomposition(MotionCoherence& result) const;
+    Matrix coherence(const Matrix& V) const;
+
+    // sum_m exp(-||p_k - y_m||^2 / (2 * beta^2)) * v_m for all points p_k, optionally divided by the sum of the weights
+    Matrix gauss_transform(const Matrix& points, const Matrix& V, const bool& normalize) const;
+    void conjugate_gradient(const Scalar& c);
+    void sparse_solve(const Scalar& c);
 
     double w      = 0.0;
     double beta   = 0.1;
     double lambda = 0.1;
 
-    RowMatrix P;
-    RowMatrix W;
-    RowMatrix G;
+    MotionCoherenceMethod method = MotionCoherenceMethod::Dense;
+    uint32_t rank                = 64;
+
+    Vector P1;     // P * 1
+    Vector PT1;    // P^T * 1
+    Matrix PX;     // P * X
+
+    Matrix W;
+
+    // The motion coherence matrix only depends on the target and is shared with registrations created from this one
+    std::shared_ptr<const MotionCoherence> motion;
+
+    // The sparsity pattern of the M-step system never changes, its symbolic analysis is done once per registration
+    Eigen::SimplicialLDLT<SparseMatrix> sparse_solver;
+    bool sparse_analyzed = false;
 };
+
+using NonRigidCoherentPointDrift = NonRigidCoherentPointDriftT<>;
 }    // namespace atcg
\ No newline at end of file
@@ -0,0 +1,176 @@
+#pragma once
+
+#include <Registration/Registration.h>
+#include <DataStructure/Mesh.h>
+
+#include <Eigen/Sparse>
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace atcg
+{
+/**
+ * @brief Non-rigid ICP of meshes with an embedded deformation graph (Sumner et al. 2007, Li et al. 2008).
+ * The graph nodes are the centroids of a voxel downsampling of the target. Every node carries an affine
+ * transformation. Each target vertex is blended from the transformations of its nearest nodes. Two nodes are connected
+ * if a mesh edge joins the vertices closest to them, so the graph follows the connectivity of the mesh and not only the
+ * distances.
+ * Every iteration matches the deformed target vertices to their closest source vertices with a kd-tree. It then takes
+ * one Gauss-Newton step on the point to point and point to plane distances, the rigidity of the node transformations
+ * and the smoothness along the graph edges. The sparsity pattern of the normal equations only depends on the graph, so
+ * the symbolic Cholesky factorization is computed once. The smoothness is halved whenever the fit stalls, so the
+ * deformation goes from stiff to detailed (Li et al. 2008). The cost of an iteration is linear in the number of
+ * vertices.
+ *
+ * @tparam Scalar The precision of the point data
+ */
+template<typename Scalar = double>
+class NonRigidIterativeClosestPointT : public RegistrationT<Scalar>
+{
+public:
+    using Matrix = typename RegistrationT<Scalar>::Matrix;
+    using Vector = typename RegistrationT<Scalar>::Vector;
+
+    /**
+     * @brief Create a non-rigid ICP registration and build the deformation graph of the target
+     *
+     * @param source The source mesh
+     * @param target The target mesh that is deformed
+     * @param node_spacing The distance between the graph nodes. Zero places a few hundred nodes on the target
+     * @param stiffness The initial weight of the smoothness relative to the fit. The rigidity has ten times the weight
+     * @param trim The fraction of correspondences that are kept in each iteration (0, 1]. At least one correspondence
+     * is kept. Trimming drops the largest distances, which are often the deformation that is sought, so it is off by
+     * default
+     * @param neighbors The number of nodes that influence a vertex
+     */
+    NonRigidIterativeClosestPointT(const std::shared_ptr<Mesh>& source,
+                                   const std::shared_ptr<Mesh>& target,
+                                   const double& node_spacing = 0.0,
+                                   const double& stiffness    = 10.0,
+                                   const double& trim         = 1.0,
+                                   const uint32_t& neighbors  = 4);
+
+    virtual ~NonRigidIterativeClosestPointT();
+
+    /**
+     * @brief Iterate until the change of the variance (mean squared distance of the kept correspondences divided by
+     * the dimension) is below tol at the lowest stiffness. The stiffness is halved whenever the change falls below
+     * tol, down to a hundredth of its initial value
+     *
+     * @param maxN The maximum number of iterations
+     * @param tol The tolerance of the variance change
+     */
+    virtual void solve(const uint32_t& maxN, const float& tol = 0.01f) override;
+
+    /**
+     * @brief Store the deformed target vertices in a point cloud.
+     * The cloud is resized to the M target vertices
+     *
+     * @param cloud The point cloud that receives the deformed target
+     */
+    virtual void applyTransform(const std::shared_ptr<PointCloud>& cloud) override;
+
+    /**
+     * @brief Store the deformed target vertices in the target mesh or a copy of it.
+     * Meshes with a different number of vertices are left unchanged
+     *
+     * @param mesh The mesh that receives the deformed target
+     */
+    void applyTransform(const std::shared_ptr<Mesh>& mesh);
+
+    /**
+     * @brief Deform an arbitrary point cloud with the deformation graph, e.g. the full resolution scan of a
+     * simplified target. Its points are bound to their nearest nodes like the target vertices
+     *
+     * @param cloud The point cloud to deform
+     */
+    void applyDeformation(const std::shared_ptr<PointCloud>& cloud);
+
+    /**
+     * @brief Deform the vertices of an arbitrary mesh with the deformation graph
+     *
+     * @param mesh The mesh to deform
+     */
+    void applyDeformation(const std::shared_ptr<Mesh>& mesh);
+
+    /**
+     * @brief Get the number of nodes of the deformation graph
+     *
+     * @return The number of nodes
+     */
+    inline uint32_t getNumNodes() const { return static_cast<uint32_t>(nodes.rows()); }
+
+private:
+    using RegistrationT<Scalar>::X;
+    using RegistrationT<Scalar>::Y;
+    using RegistrationT<Scalar>::N;
+    using RegistrationT<Scalar>::M;
+    using RegistrationT<Scalar>::var;
+
+    using SparseMatrix = Eigen::SparseMatrix<double>;
+
+    struct KDTree;
+    struct NodeTree;
+
+    // The vertices of the target that contribute to a block of the normal equations and the positions of their nodes
+    // in their bindings
+    struct Contribution
+    {
+        uint32_t vertex;
+        uint8_t row, col;
+    };
+
+    void build_graph(const std::shared_ptr<Mesh>& target);
+    void build_pattern();
+    uint32_t block(const uint32_t& row, const uint32_t& col) const;
+
+    void bind(const RowMatrixT<double>& points, std::vector<uint32_t>& indices, std::vector<double>& weights) const;
+    RowMatrixT<double>
+    deform(const RowMatrixT<double>& points, const std::vector<uint32_t>& indices, const std::vector<double>& weights)
+        const;
+
+    double correspond();
+    // False if the normal equations could not be solved, the deformation is then left unchanged
+    bool step(const double& weight);
+
+    virtual Matrix transformedTarget() const override;
+
+    double node_spacing = 0.0;
+    double stiffness    = 10.0;
+    double trim         = 1.0;
+    uint32_t neighbors  = 4;
+
+    std::shared_ptr<const KDTree> tree;    // Over the source vertices
+    RowMatrixT<double> source_normals;     // Area weighted vertex normals of the source (Nx3)
+    std::vector<uint32_t> faces;           // Vertex indices of the target triangles (3 per face)
+
+    // Deformation graph
+    RowMatrixT<double> nodes;                            // Node positions (Kx3)
+    std::shared_ptr<const NodeTree> node_tree;           // Over the node positions
+    std::vector<std::pair<uint32_t, uint32_t>> edges;    // Undirected graph edges
+    Eigen::VectorXd parameters;                          // Columns of A and t of every node (12K)
+    std::vector<uint32_t> binding_nodes;                 // Nodes of each target vertex (M x neighbors)
+    std::vector<double> binding_weights;                 // Their weights
+
+    // Normal equations in the unknowns of the nodes, stored in dense 12x12 blocks. The solver reads the lower triangle
+    SparseMatrix H;
+    Eigen::VectorXd gradient;
+    std::unordered_map<uint64_t, uint32_t> blocks;    // Block of two nodes (row >= col)
+    std::vector<Eigen::Index> block_offsets;          // First entry of each of the 12 columns of a block
+    std::vector<uint32_t> contribution_start;         // Contributions of each block (CSR)
+    std::vector<Contribution> contributions;
+    std::vector<uint32_t> node_start;    // Target vertices bound to each node and their binding slots (CSR)
+    std::vector<std::pair<uint32_t, uint32_t>> node_vertices;
+    Eigen::SimplicialLDLT<SparseMatrix> solver;
+
+    // State of the current iteration
+    RowMatrixT<double> deformed;               // Deformed target vertices (Mx3)
+    std::vector<Eigen::Vector3d> residuals;    // Distance vector of each target vertex to its correspondence
+    std::vector<Eigen::Matrix3d> metrics;      // Point to point and point to plane weights, zero if rejected
+    uint32_t kept = 0;                         // Number of kept correspondences
+};
+
+using NonRigidIterativeClosestPoint = NonRigidIterativeClosestPointT<>;
+}    // namespace atcg
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <Math/Utils.h>
+#include <DataStructure/ChunkedPointCloud.h>
+
+#include <Eigen/Core>
+
+#include <memory>
+#include <vector>
+
+namespace atcg
+{
+/**
+ * @brief Find the k nearest neighbors of every point of a set with a kd-tree.
+ * The point itself is not among its neighbors, unless duplicates leave too few other points. The points are processed
+ * in parallel
+ *
+ * @param points The points (Nx3)
+ * @param neighbors The number of neighbors k
+ * @return The indices of the neighbors, min(k, N - 1) per point (row major)
+ */
+std::vector<Eigen::Index> nearest_neighbors(const RowMatrixT<double>& points, const uint32_t& neighbors);
+
+/**
+ * @brief Estimate the normals of a point set from the covariance of the k nearest neighbors of each point.
+ * The normals are oriented away from the centroid of the points. The points are processed in parallel
+ *
+ * @param points The points (Nx3)
+ * @param neighbors The number of neighbors
+ * @return The normals (Nx3)
+ */
+RowMatrixT<double> estimate_normals(const RowMatrixT<double>& points, const uint32_t& neighbors = 30);
+
+/**
+ * @brief Estimate the normals of an out-of-core point cloud and store them in its chunks.
+ * Every chunk is processed together with the points of the other chunks that lie within margin of its bounds, so
+ * the neighborhoods at the chunk borders are complete if margin covers the neighbor distance. The normals are
+ * oriented away from the center of the bounding box of the whole cloud. The chunks are processed in parallel
+ *
+ * @param cloud The chunked point cloud
+ * @param margin The distance around a chunk from which neighbors are gathered
+ * @param neighbors The number of neighbors
+ */
+void estimate_normals(const std::shared_ptr<ChunkedPointCloud>& cloud,
+                      const float& margin,
+                      const uint32_t& neighbors = 30);
+}    // namespace atcg
\ No newline at end of file
@@ -1,22 +1,288 @@
 #pragma once
 
 #include <DataStructure/PointCloud.h>
+#include <DataStructure/Statistics.h>
+#include <DataStructure/Timer.h>
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <vector>
 
 namespace atcg
 {
-class Registration
+/**
+ * @brief The state of a running registration after an iteration
+ *
+ * @tparam Scalar The precision of the point data
+ */
+template<typename Scalar = double>
+struct RegistrationSnapshot
+{
+    uint32_t iteration = 0;
+    double variance    = 0.0;
+    RowMatrixT<Scalar> points;    // The transformed target points (Mx3)
+};
+
+/**
+ * @brief Base class of the registration algorithms
+ *
+ * @tparam Scalar The precision in which the point data is stored and processed
+ */
+template<typename Scalar = double>
+class RegistrationT
 {
 public:
-    Registration(const std::shared_ptr<PointCloud>& source, const std::shared_ptr<PointCloud>& target);
+    using Matrix = RowMatrixT<Scalar>;
+    using Vector = VectorT<Scalar>;
+
+    RegistrationT(const std::shared_ptr<PointCloud>& source, const std::shared_ptr<PointCloud>& target);
 
-    virtual ~Registration() {};
+    /**
+     * @brief Create a registration of a new source against the target of another registration.
+     * The target points and their moments are shared instead of being copied
+     *
+     * @param source The source point cloud
+     * @param reference The registration whose target is used
+     */
+    RegistrationT(const std::shared_ptr<PointCloud>& source, const RegistrationT<Scalar>& reference);
+
+    virtual ~RegistrationT() {};
 
     virtual void solve(const uint32_t& maxN, const float& tol = 0.01f) = 0;
 
+    /**
+     * @brief Precompute everything that only depends on the target.
+     * solve calls this if needed. Registrations that are created from this one with the sharing constructor reuse
+     * the result
+     */
+    virtual void prepare() {}
+
     virtual void applyTransform(const std::shared_ptr<PointCloud>& cloud) = 0;
 
+    /**
+     * @brief Run solve on the thread pool.
+     * While it runs, every iteration publishes a snapshot that can be fetched with getSnapshot. The registration must
+     * not be modified or solved again until the future is ready
+     *
+     * @param maxN The maximum number of iterations
+     * @param tol The tolerance of the variance change
+     * @return The future that is ready when solve returns
+     */
+    std::future<void> solveAsync(const uint32_t& maxN, const float& tol = 0.01f);
+
+    /**
+     * @brief Request the running solve to stop after the current iteration.
+     * The result is the state after that iteration
+     */
+    inline void cancel() { cancel_requested = true; }
+
+    /**
+     * @brief Check if the running solve was requested to stop
+     *
+     * @return True if cancel was called since the running solve was started
+     */
+    inline bool cancelled() const { return cancel_requested; }
+
+    /**
+     * @brief Fetch the latest snapshot of an asynchronous solve.
+     * The snapshots are double buffered: the writer fills a back buffer and swaps it with the front buffer after each
+     * iteration. This swaps the front buffer with the given snapshot, so nothing is copied. The render loop can keep
+     * its snapshot between calls
+     *
+     * @param snapshot The snapshot that receives the latest state
+     * @return True if a new snapshot was published since the last call
+     */
+    bool getSnapshot(RegistrationSnapshot<Scalar>& snapshot);
+
+    /**
+     * @brief Set the variance that the next call of solve starts with, e.g. to continue from the variance of another
+     * solve. Only the next call uses it, every other call starts with the variance of the initial alignment. Zero (the
+     * default) does not set a variance
+     *
+     * @param var The variance
+     */
+    inline void setVariance(const double& var) { start_var = var; }
+
+    /**
+     * @brief Get the variance after the last call of solve
+     *
+     * @return The variance
+     */
+    inline double getVariance() const { return var; }
+
+    /**
+     * @brief Get the number of iterations of the last call of solve
+     *
+     * @return The number of iterations
+     */
+    inline uint32_t getIterations() const { return iterations; }
+
+    /**
+     * @brief Replace the source points, e.g. with the next frame of a sequence.
+     * The transformation and everything that only depends on the target are kept, so the next call of solve continues
+     * from the current transformation. Its variance can be set with setVariance
+     *
+     * @param source The new source point cloud
+     */
+    void setSource(const std::shared_ptr<PointCloud>& source);
+
+    /**
+     * @brief Stop solve once the transformed target points move less than this between two iterations.
+     * The motion is measured as the root mean square displacement. Zero (the default) disables the check
+     *
+     * @param tol The tolerance of the motion per iteration
+     */
+    inline void setMotionTolerance(const double& tol) { motion_tolerance = tol; }
+
+    /**
+     * @brief Print every iteration and, at the end of each solve, the time of its stages to std::cout.
+     * Registrations are silent by default
+     *
+     * @param verbose If the progress should be printed
+     */
+    inline void setVerbose(const bool& verbose) { this->verbose = verbose; }
+
+    /**
+     * @brief Get the time of the stages of the iterations of the last call of solve in milliseconds
+     *
+     * @return One statistic per stage in the order in which the stages first ran
+     */
+    inline const std::vector<Statistic<float>>& getStatistics() const { return statistics; }
+
 protected:
-    RowMatrix X, Y;
+    /**
+     * @brief Compute the mean squared distance between all pairs of source and target points divided by the dimension.
+     * This is the initial variance of the CPD algorithms. It is evaluated in O(N + M) through the centered moments
+     * in double precision.
+     *
+     * @return The variance
+     */
+    double initialVariance() const;
+
+    /**
+     * @brief Get the variance that solve starts with. This is the variance of setVariance, which is used up by this
+     * call, or the initial variance
+     *
+     * @return The variance
+     */
+    double startVariance();
+
+    /**
+     * @brief Compute the target points with the current transformation
+     *
+     * @return The transformed target points (Mx3)
+     */
+    virtual Matrix transformedTarget() const = 0;
+
+    /**
+     * @brief Count an iteration and publish the state after it. Nothing is published unless the solve was started
+     * with solveAsync. A verbose registration prints the iteration
+     *
+     * @param iteration The iteration
+     */
+    void publish(const uint32_t& iteration);
+
+    /**
+     * @brief Start a solve. Resets the iteration count, the statistics and the cancel request of a synchronous solve.
+     * solve calls this before its first stage
+     */
+    void beginSolve();
+
+    /**
+     * @brief Run the iterations of a solve and report the statistics of their stages.
+     * Every iteration calls step and publishes the state after it. The loop stops after maxN iterations, when step
+     * returns false, when the transformed target settled or when the solve is cancelled. The first iteration always
+     * runs, even if the registration starts within the tolerance of step
+     *
+     * @param maxN The maximum number of iterations
+     * @param step One iteration. Returns false once the registration converged
+     */
+    void iterate(const uint32_t& maxN, const std::function<bool()>& step);
+
+    /**
+     * @brief Solve a coherent point drift registration with expectation maximization.
+     * The variance starts with startVariance. Every iteration computes the posteriors with the current variance and
+     * updates the transformation, which yields the next variance. The iterations stop once the variance changes by at
+     * most tol
+     *
+     * @param maxN The maximum number of iterations
+     * @param tol The tolerance of the variance change
+     * @param estimate The E-step for a variance
+     * @param maximize The M-step for the variance of the E-step. Returns the new variance
+     */
+    void expectationMaximization(const uint32_t& maxN,
+                                 const float& tol,
+                                 const std::function<void(double)>& estimate,
+                                 const std::function<double(double)>& maximize);
+
+    /**
+     * @brief Run a stage of an iteration and add its time to the statistic of the stage
+     *
+     * @param stage The name of the stage
+     * @param func The stage
+     */
+    template<typename Func>
+    void timed(const char* stage, Func&& func);
+
+    /**
+     * @brief Print the statistics of the stages if the registration is verbose
+     */
+    void report() const;
+
+    Matrix X;
+    std::shared_ptr<const Matrix> target_points;    // Owns Y, shared with the target cloud and its registrations
+    const Matrix& Y;
     uint32_t N, M;
+
+    Eigen::RowVector3d target_mean;    // Mean of the target points
+    double target_spread;              // Mean squared distance of the target points to their mean
+
+    double var          = 0.0;
+    uint32_t iterations = 0;
+
+private:
+    /**
+     * @brief Check if the transformed target moved less than the motion tolerance since the last call.
+     * Iteration zero only records the current state
+     *
+     * @param iteration The iteration
+     * @return True if the motion tolerance is set and the motion was below it
+     */
+    bool settled(const uint32_t& iteration);
+
+    double start_var        = 0.0;    // The variance of setVariance for the next solve
+    double motion_tolerance = 0.0;
+    Matrix settled_points;    // The transformed target points at the last call of settled
+
+    bool verbose = false;
+    std::vector<Statistic<float>> statistics;
+
+    std::atomic<bool> cancel_requested {false};
+    std::atomic<bool> snapshots_enabled {false};
+
+    std::mutex snapshot_mutex;
+    RegistrationSnapshot<Scalar> snapshot_front;
+    RegistrationSnapshot<Scalar> snapshot_back;
+    bool snapshot_fresh = false;
 };
+
+template<typename Scalar>
+template<typename Func>
+void RegistrationT<Scalar>::timed(const char* stage, Func&& func)
+{
+    Timer timer;
+    func();
+    const float elapsed = timer.elapsedMillis();
+
+    auto statistic = std::find_if(statistics.begin(),
+                                  statistics.end(),
+                                  [&](const Statistic<float>& statistic) { return statistic.name() == stage; });
+    if(statistic == statistics.end()) statistic = statistics.insert(statistics.end(), Statistic<float>(stage));
+    statistic->addSample(elapsed);
+}
+
+using Registration = RegistrationT<>;
 }    // namespace atcg
\ No newline at end of file
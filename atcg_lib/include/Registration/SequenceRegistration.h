@@ -0,0 +1,116 @@
+#pragma once
+
+#include <Registration/Registration.h>
+
+#include <algorithm>
+
+namespace atcg
+{
+/**
+ * @brief Tracking driver for sequences of frames that differ only slightly from each other.
+ * One registration is kept for the whole sequence and every frame replaces its source. The target side is prepared
+ * once, and the transformation (or the deformation field) of the previous frame is the starting point of the next
+ * one. Instead of the variance of all source and target pairs, a frame starts with the final variance of the previous
+ * frame scaled by a factor. It is kept at least as large as the squared shift of the frame centroid divided by the
+ * dimension, so a frame that jumps is not started with a variance that is too small. A frame stops as soon as the
+ * transformed target moves less than the motion tolerance per iteration.
+ *
+ * @tparam RegistrationType The registration. It needs a constructor RegistrationType(source, target, args...)
+ */
+template<class RegistrationType>
+class SequenceRegistration
+{
+public:
+    /**
+     * @brief Create a tracking registration
+     *
+     * @param target The target point cloud that is moved onto the frames
+     * @param variance_scale The factor of the previous frame's variance that the next frame starts with
+     * @param motion_tol The root mean square motion of the transformed target per iteration below which a frame is
+     * stopped. Zero only uses the tolerance of the variance change
+     * @param args Additional arguments for the constructor of the registration
+     */
+    template<typename... Args>
+    SequenceRegistration(const std::shared_ptr<PointCloud>& target,
+                         const double& variance_scale = 4.0,
+                         const double& motion_tol     = 0.0,
+                         const Args&... args);
+
+    /**
+     * @brief Register the next frame.
+     * The first frame starts from the identity with the variance of all source and target pairs. Every frame does at
+     * least one iteration, also if its variance starts below tol
+     *
+     * @param frame The frame
+     * @param maxN The maximum number of iterations for this frame
+     * @param tol The tolerance of the variance change
+     */
+    void track(const std::shared_ptr<PointCloud>& frame, const uint32_t& maxN, const float& tol = 0.01f);
+
+    /**
+     * @brief Apply the transformation of the last frame
+     *
+     * @param cloud The point cloud to transform
+     */
+    inline void applyTransform(const std::shared_ptr<PointCloud>& cloud) { _registration->applyTransform(cloud); }
+
+    /**
+     * @brief Get the registration that is shared by all frames
+     *
+     * @return The registration
+     */
+    inline std::shared_ptr<RegistrationType> getRegistration() const { return _registration; }
+
+    /**
+     * @brief Get the number of frames that have been tracked
+     *
+     * @return The number of frames
+     */
+    inline uint32_t frames() const { return _frames; }
+
+private:
+    std::shared_ptr<RegistrationType> _registration;
+    double _variance_scale = 4.0;
+
+    uint32_t _frames = 0;
+    Eigen::RowVector3d _centroid;    // Centroid of the previous frame
+};
+
+///
+/// Implementation
+///
+
+template<class RegistrationType>
+template<typename... Args>
+SequenceRegistration<RegistrationType>::SequenceRegistration(const std::shared_ptr<PointCloud>& target,
+                                                             const double& variance_scale,
+                                                             const double& motion_tol,
+                                                             const Args&... args)
+    : _variance_scale(variance_scale)
+{
+    // The source is replaced by every frame
+    _registration = std::make_shared<RegistrationType>(std::make_shared<PointCloud>(), target, args...);
+    _registration->setMotionTolerance(motion_tol);
+    _registration->prepare();
+}
+
+template<class RegistrationType>
+void SequenceRegistration<RegistrationType>::track(const std::shared_ptr<PointCloud>& frame,
+                                                   const uint32_t& maxN,
+                                                   const float& tol)
+{
+    Eigen::RowVector3d centroid = frame->cpoints().cast<double>().colwise().mean();
+
+    _registration->setSource(frame);
+    if(_frames > 0)
+    {
+        double var = _registration->getVariance() * _variance_scale;
+        _registration->setVariance(std::max(var, (centroid - _centroid).squaredNorm() / 3.0));
+    }
+
+    _registration->solve(maxN, tol);
+
+    _centroid = centroid;
+    ++_frames;
+}
+}    // namespace atcg
@@ -0,0 +1,60 @@
+#include <Core/MappedFile.h>
+
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #define NOMINMAX
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+namespace atcg
+{
+MappedFile::MappedFile(const char* path)
+{
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, 0);
+    if(file == INVALID_HANDLE_VALUE) return;
+    _file = file;
+
+    LARGE_INTEGER size;
+    if(!GetFileSizeEx(file, &size)) return;
+    _size = static_cast<size_t>(size.QuadPart);
+    _open = true;
+    if(_size == 0) return;
+
+    _mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if(!_mapping) return;
+    _data = static_cast<const char*>(MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0));
+#else
+    _file = open(path, O_RDONLY);
+    if(_file < 0) return;
+
+    struct stat status;
+    if(fstat(_file, &status) != 0) return;
+    _size = static_cast<size_t>(status.st_size);
+    _open = true;
+    if(_size == 0) return;
+
+    void* data = mmap(nullptr, _size, PROT_READ, MAP_SHARED, _file, 0);
+    if(data == MAP_FAILED) return;
+    madvise(data, _size, MADV_SEQUENTIAL);
+    _data = static_cast<const char*>(data);
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+#ifdef _WIN32
+    if(_data) UnmapViewOfFile(_data);
+    if(_mapping) CloseHandle(_mapping);
+    if(_file) CloseHandle(_file);
+#else
+    if(_data) munmap(const_cast<char*>(_data), _size);
+    if(_file >= 0) close(_file);
+#endif
+}
+}    // namespace atcg
\ No newline at end of file
@@ -0,0 +1,129 @@
+#include <Core/ThreadPool.h>
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+
+namespace atcg
+{
+ThreadPool::ThreadPool(const uint32_t& num_threads)
+{
+    uint32_t n = num_threads == 0 ? std::max(1u, std::thread::hardware_concurrency()) : num_threads;
+    _workers.reserve(n);
+    for(uint32_t i = 0; i < n; ++i) { _workers.emplace_back([this]() { work(); }); }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _running = false;
+    }
+    _condition.notify_all();
+    for(std::thread& worker: _workers) { worker.join(); }
+}
+
+ThreadPool* ThreadPool::get()
+{
+    static ThreadPool pool;
+    return &pool;
+}
+
+void ThreadPool::work()
+{
+    while(true)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _condition.wait(lock, [this]() { return !_running || !_tasks.empty(); });
+            if(!_running && _tasks.empty()) return;
+            task = std::move(_tasks.front());
+            _tasks.pop();
+        }
+        task();
+    }
+}
+
+void ThreadPool::parallel_for(const size_t& begin,
+                              const size_t& end,
+                              const uint32_t& num_chunks,
+                              const std::function<void(size_t, size_t, uint32_t)>& func)
+{
+    if(end <= begin || num_chunks == 0) return;
+
+    const size_t count    = end - begin;
+    const uint32_t chunks = static_cast<uint32_t>(std::min<size_t>(num_chunks, count));
+    if(chunks == 1)
+    {
+        func(begin, end, 0);
+        return;
+    }
+
+    // Chunks are handed out through a shared counter. Helpers that start after all chunks are taken return
+    // immediately, which is why the state has to outlive this call. An exception is kept for the calling thread and
+    // its chunk still counts as done, so the wait below always ends while no helper uses func anymore
+    struct State
+    {
+        std::atomic<uint32_t> next {0};
+        std::atomic<uint32_t> done {0};
+        std::atomic<bool> failed {false};
+        std::exception_ptr error;
+        std::mutex mutex;
+        std::condition_variable finished;
+    };
+    auto state = std::make_shared<State>();
+
+    auto run = [state, &func, begin, count, chunks]()
+    {
+        uint32_t chunk;
+        while((chunk = state->next.fetch_add(1)) < chunks)
+        {
+            size_t first = begin + count * chunk / chunks;
+            size_t last  = begin + count * (chunk + 1) / chunks;
+            if(!state->failed.load())
+            {
+                try
+                {
+                    func(first, last, chunk);
+                }
+                catch(...)
+                {
+                    std::lock_guard<std::mutex> lock(state->mutex);
+                    if(!state->error) state->error = std::current_exception();
+                    state->failed = true;
+                }
+            }
+
+            if(state->done.fetch_add(1) + 1 == chunks)
+            {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                state->finished.notify_all();
+            }
+        }
+    };
+
+    uint32_t helpers = std::min(chunks - 1, num_threads());
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for(uint32_t i = 0; i < helpers; ++i) { _tasks.emplace(run); }
+    }
+    _condition.notify_all();
+
+    // The calling thread takes part as well, so nested calls from inside a task can not dead lock
+    run();
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->finished.wait(lock, [&state, chunks]() { return state->done.load() == chunks; });
+    if(state->error) std::rethrow_exception(state->error);
+}
+
+void ThreadPool::parallel_for(const size_t& begin, const size_t& end, const std::function<void(size_t, size_t)>& func)
+{
+    // A few chunks per thread balance uneven work
+    parallel_for(begin,
+                 end,
+                 4 * (num_threads() + 1),
+                 [&func](size_t first, size_t last, uint32_t) { func(first, last); });
+}
+}    // namespace atcg
\ No newline at end of file
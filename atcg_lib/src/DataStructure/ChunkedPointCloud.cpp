@@ -0,0 +1,422 @@
+#include <DataStructure/ChunkedPointCloud.h>
+
+#include <Core/ThreadPool.h>
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace atcg
+{
+namespace detail
+{
+constexpr const char* CHUNKED_INDEX_NAME    = "index";
+constexpr const char* CHUNKED_INDEX_MAGIC   = "atcg_chunked_point_cloud";
+constexpr uint32_t CHUNKED_INDEX_VERSION    = 1;
+
+// Files are written next to their final path first and renamed, so a crash never leaves a partly written file
+constexpr const char* CHUNKED_TEMPORARY_SUFFIX = ".tmp";
+
+// An index entry has ten numbers of at least one character and a separator each
+constexpr size_t CHUNKED_MIN_ENTRY_BYTES = 20;
+
+bool replace_file(const std::string& temporary, const std::string& path)
+{
+    std::error_code error;
+    std::filesystem::rename(temporary, path, error);
+    if(!error) return true;
+
+    std::cerr << "Could not replace " << path << ": " << error.message() << "!\n";
+    std::filesystem::remove(temporary, error);
+    return false;
+}
+}    // namespace detail
+
+ChunkedPointCloud::ChunkedPointCloud(const std::string& directory,
+                                     const float& chunk_length,
+                                     const size_t& memory_budget)
+    : _directory(directory),
+      _chunk_length(chunk_length),
+      _memory_budget(memory_budget)
+{
+    std::filesystem::create_directories(_directory);
+
+    const std::string path = _directory + "/" + detail::CHUNKED_INDEX_NAME;
+    std::ifstream index(path);
+    if(!index.is_open()) return;
+
+    std::string magic;
+    uint32_t version = 0;
+    size_t count     = 0;
+    index >> magic >> version >> _chunk_length >> count;
+    if(magic != detail::CHUNKED_INDEX_MAGIC || version != detail::CHUNKED_INDEX_VERSION)
+    {
+        std::cerr << _directory << ": Unsupported chunked point cloud index!\n";
+        _chunk_length = chunk_length;
+        return;
+    }
+
+    // Reject a count whose entries cannot fit into the file before they are allocated
+    std::error_code error;
+    const uintmax_t size = std::filesystem::file_size(path, error);
+    if(!index || error || count > size / detail::CHUNKED_MIN_ENTRY_BYTES)
+    {
+        std::cerr << _directory << ": Corrupt chunked point cloud index!\n";
+        _chunk_length = chunk_length;
+        return;
+    }
+
+    _chunks.resize(count);
+    _slots.resize(count);
+    for(size_t i = 0; i < count; ++i)
+    {
+        Chunk& chunk = _chunks[i];
+        Eigen::Vector3f min, max;
+        index >> chunk.cell.x >> chunk.cell.y >> chunk.cell.z >> chunk.count;
+        index >> min.x() >> min.y() >> min.z() >> max.x() >> max.y() >> max.z();
+        // Empty chunks are written with zero bounds, which would otherwise put the origin into the box
+        if(chunk.count == 0)
+            chunk.bounds.setEmpty();
+        else
+            chunk.bounds = Eigen::AlignedBox3f(min, max);
+        _cells[chunk.cell] = i;
+    }
+
+    if(!index)
+    {
+        std::cerr << _directory << ": Corrupt chunked point cloud index!\n";
+        _chunks.clear();
+        _slots.clear();
+        _cells.clear();
+    }
+}
+
+ChunkedPointCloud::~ChunkedPointCloud()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    write_chunks(lock, false);
+    if(_index_dirty) write_index();
+}
+
+void ChunkedPointCloud::insert(const std::shared_ptr<PointCloud>& points)
+{
+    // Group the points by cell first, so every chunk is paged in once
+    const auto positions = points->cpoints();
+    const auto normals   = points->normals();
+    const auto colors    = points->colors();
+    std::unordered_map<GridCell, std::vector<uint32_t>, GridCellHash> groups;
+    for(size_t i = 0; i < points->n_vertices(); ++i)
+    {
+        groups[GridCell::of(positions.row(i), _chunk_length)].push_back(static_cast<uint32_t>(i));
+    }
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    for(const auto& [cell, indices]: groups)
+    {
+        auto [it, inserted] = _cells.try_emplace(cell, _chunks.size());
+        if(inserted)
+        {
+            Chunk chunk;
+            chunk.cell = cell;
+            _chunks.push_back(chunk);
+            _slots.emplace_back();
+        }
+
+        const size_t index               = it->second;
+        std::shared_ptr<PointCloud> cloud = acquire(lock, index, true);
+        if(_slots[index].unreadable)
+        {
+            std::cerr << chunk_path(cell) << ": Skipped " << indices.size() << " points of an unreadable chunk!\n";
+            continue;
+        }
+
+        const size_t first = cloud->n_vertices();
+        cloud->resize(first + indices.size());
+
+        auto target_points  = cloud->points();
+        auto target_normals = cloud->normals();
+        auto target_colors  = cloud->colors();
+        for(size_t k = 0; k < indices.size(); ++k)
+        {
+            target_points.row(first + k)  = positions.row(indices[k]);
+            target_normals.row(first + k) = normals.row(indices[k]);
+            target_colors.row(first + k)  = colors.row(indices[k]);
+            _chunks[index].bounds.extend(positions.row(indices[k]).transpose());
+        }
+
+        _chunks[index].count = cloud->n_vertices();
+        _index_dirty         = true;
+        account(_slots[index]);
+
+        cloud.reset();
+        evict(lock);
+    }
+}
+
+void ChunkedPointCloud::flush()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    write_chunks(lock, true);
+    if(_index_dirty) write_index();
+}
+
+std::shared_ptr<PointCloud> ChunkedPointCloud::chunk(const size_t& index)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    std::shared_ptr<PointCloud> cloud = acquire(lock, index, false);
+    evict(lock);
+    return cloud;
+}
+
+void ChunkedPointCloud::for_each_chunk(const std::function<void(size_t, PointCloud&)>& func, const bool& modify)
+{
+    ThreadPool::get()->parallel_for(
+        0,
+        n_chunks(),
+        [&](size_t first, size_t last)
+        {
+            for(size_t i = first; i < last; ++i)
+            {
+                std::shared_ptr<PointCloud> cloud;
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    cloud = acquire(lock, i, modify);
+                    evict(lock);
+                }
+
+                func(i, *cloud);
+                if(!modify) continue;
+
+                Eigen::AlignedBox3f bounds;
+                const auto points = cloud->cpoints();
+                for(size_t n = 0; n < cloud->n_vertices(); ++n) bounds.extend(points.row(n).transpose());
+
+                std::lock_guard<std::mutex> lock(_mutex);
+                account(_slots[i]);
+                if(_slots[i].unreadable) continue;
+
+                _chunks[i].count  = cloud->n_vertices();
+                _chunks[i].bounds = bounds;
+                _index_dirty      = true;
+            }
+        });
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    evict(lock);
+}
+
+std::vector<size_t> ChunkedPointCloud::query(const Eigen::AlignedBox3f& box) const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    std::vector<size_t> result;
+    for(size_t i = 0; i < _chunks.size(); ++i)
+    {
+        if(_chunks[i].count > 0 && _chunks[i].bounds.intersects(box)) result.push_back(i);
+    }
+    return result;
+}
+
+std::shared_ptr<PointCloud> ChunkedPointCloud::points_in(const Eigen::AlignedBox3f& box)
+{
+    auto result = std::make_shared<PointCloud>();
+    for(size_t index: query(box))
+    {
+        std::shared_ptr<PointCloud> cloud = chunk(index);
+        const auto points                 = cloud->cpoints();
+        const auto normals                = cloud->normals();
+        const auto colors                 = cloud->colors();
+
+        std::vector<uint32_t> inside;
+        for(size_t i = 0; i < cloud->n_vertices(); ++i)
+        {
+            if(box.contains(points.row(i).transpose())) inside.push_back(static_cast<uint32_t>(i));
+        }
+
+        const size_t first = result->n_vertices();
+        result->resize(first + inside.size());
+        auto target_points  = result->points();
+        auto target_normals = result->normals();
+        auto target_colors  = result->colors();
+        for(size_t k = 0; k < inside.size(); ++k)
+        {
+            target_points.row(first + k)  = points.row(inside[k]);
+            target_normals.row(first + k) = normals.row(inside[k]);
+            target_colors.row(first + k)  = colors.row(inside[k]);
+        }
+    }
+    return result;
+}
+
+ChunkedPointCloud::Chunk ChunkedPointCloud::info(const size_t& index) const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _chunks[index];
+}
+
+size_t ChunkedPointCloud::n_chunks() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _chunks.size();
+}
+
+size_t ChunkedPointCloud::n_vertices() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    size_t count = 0;
+    for(const Chunk& chunk: _chunks) count += chunk.count;
+    return count;
+}
+
+Eigen::AlignedBox3f ChunkedPointCloud::bounds() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    Eigen::AlignedBox3f bounds;
+    for(const Chunk& chunk: _chunks)
+    {
+        if(chunk.count > 0) bounds.extend(chunk.bounds);
+    }
+    return bounds;
+}
+
+size_t ChunkedPointCloud::resident_bytes()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _resident;
+}
+
+std::shared_ptr<PointCloud> ChunkedPointCloud::acquire(std::unique_lock<std::mutex>& lock,
+                                                       const size_t& index,
+                                                       const bool& modify)
+{
+    // A chunk that is read or written by another thread is waited for, so a chunk is never loaded twice
+    _idle.wait(lock, [&] { return !_slots[index].busy; });
+    if(_slots[index].cloud)
+    {
+        _recent.erase(_slots[index].recent);
+    }
+    else
+    {
+        // A chunk without points has no file until it is stored. Otherwise the file must not be overwritten with the
+        // empty cloud that stands in for it. The failure is reported once, not on every page in
+        const std::string path = chunk_path(_chunks[index].cell);
+        const size_t count     = _chunks[index].count;
+        _slots[index].busy     = true;
+        lock.unlock();
+
+        bool valid = false;
+        std::shared_ptr<PointCloud> cloud;
+        {
+            IO::MappedPointCloud file(path.c_str());
+            valid = file.is_valid();
+            cloud = valid ? file.toPointCloud() : std::make_shared<PointCloud>();
+        }
+
+        lock.lock();
+        Slot& slot          = _slots[index];
+        const bool reported = slot.unreadable;
+        slot.unreadable     = !valid && count > 0;
+        if(slot.unreadable && !reported)
+        {
+            std::cerr << path << ": Could not read the " << count << " points of the chunk, it is left unchanged!\n";
+        }
+        slot.cloud = cloud;
+        slot.busy  = false;
+        account(slot);
+        _idle.notify_all();
+    }
+
+    Slot& slot = _slots[index];
+    _recent.push_front(index);
+    slot.recent = _recent.begin();
+    slot.dirty  = slot.dirty || (modify && !slot.unreadable);
+    return slot.cloud;
+}
+
+void ChunkedPointCloud::evict(std::unique_lock<std::mutex>& lock)
+{
+    // The iterator stays valid while the lock is released, since a busy chunk is not taken out of the list
+    auto it = _recent.end();
+    while(_resident > _memory_budget && it != _recent.begin())
+    {
+        --it;
+        const size_t index = *it;
+        if(_slots[index].busy || _slots[index].cloud.use_count() > 1) continue;
+
+        // A chunk that could not be written stays in memory, so its points are not lost
+        if(_slots[index].dirty) store(lock, index);
+        if(_slots[index].dirty) continue;
+
+        Slot& slot = _slots[index];
+        slot.cloud.reset();
+        account(slot);
+        it = _recent.erase(it);
+    }
+}
+
+void ChunkedPointCloud::write_chunks(std::unique_lock<std::mutex>& lock, const bool& skip_in_use)
+{
+    // Other threads can add chunks while a chunk is written, so the size is read in every iteration
+    for(size_t i = 0; i < _slots.size(); ++i)
+    {
+        _idle.wait(lock, [&] { return skip_in_use || !_slots[i].busy; });
+        if(!_slots[i].dirty || _slots[i].busy) continue;
+        if(skip_in_use && _slots[i].cloud.use_count() > 1) continue;
+        store(lock, i);
+    }
+}
+
+void ChunkedPointCloud::account(Slot& slot)
+{
+    const size_t bytes = slot.cloud ? slot.cloud->n_vertices() * VERTEX_BYTES : 0;
+    _resident          = _resident - slot.bytes + bytes;
+    slot.bytes         = bytes;
+}
+
+void ChunkedPointCloud::store(std::unique_lock<std::mutex>& lock, const size_t& index)
+{
+    // The chunk is busy meanwhile, so no thread can acquire and change it
+    const std::shared_ptr<PointCloud> cloud = _slots[index].cloud;
+    const std::string path                  = chunk_path(_chunks[index].cell);
+    const std::string temporary             = path + detail::CHUNKED_TEMPORARY_SUFFIX;
+    _slots[index].busy                      = true;
+    lock.unlock();
+
+    const bool written = IO::write_pointcloud(cloud, temporary.c_str()) && detail::replace_file(temporary, path);
+
+    lock.lock();
+    _slots[index].busy = false;
+    if(written) _slots[index].dirty = false;
+    _idle.notify_all();
+}
+
+void ChunkedPointCloud::write_index()
+{
+    const std::string path      = _directory + "/" + detail::CHUNKED_INDEX_NAME;
+    const std::string temporary = path + detail::CHUNKED_TEMPORARY_SUFFIX;
+    std::ofstream index(temporary);
+    index << detail::CHUNKED_INDEX_MAGIC << " " << detail::CHUNKED_INDEX_VERSION << "\n";
+    index.precision(9);
+    index << _chunk_length << " " << _chunks.size() << "\n";
+    for(const Chunk& chunk: _chunks)
+    {
+        const Eigen::Vector3f min = chunk.count > 0 ? chunk.bounds.min() : Eigen::Vector3f::Zero();
+        const Eigen::Vector3f max = chunk.count > 0 ? chunk.bounds.max() : Eigen::Vector3f::Zero();
+        index << chunk.cell.x << " " << chunk.cell.y << " " << chunk.cell.z << " " << chunk.count << " " << min.x()
+              << " " << min.y() << " " << min.z() << " " << max.x() << " " << max.y() << " " << max.z() << "\n";
+    }
+
+    index.close();
+    if(!index)
+        std::cerr << "Could not write the index of " << _directory << "!\n";
+    else if(detail::replace_file(temporary, path))
+        _index_dirty = false;
+}
+
+std::string ChunkedPointCloud::chunk_path(const GridCell& cell) const
+{
+    std::ostringstream path;
+    path << _directory << "/chunk_" << cell.x << "_" << cell.y << "_" << cell.z << ".bin";
+    return path.str();
+}
+}    // namespace atcg
\ No newline at end of file
@@ -1,10 +1,19 @@
 #include <DataStructure/PointCloud.h>
 
+#include <Core/MappedFile.h>
+#include <Core/ThreadPool.h>
 #include <DataStructure/Mesh.h>
 
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstring>
 #include <fstream>
+#include <numeric>
 #include <string>
+#include <string_view>
 #include <iostream>
+#include <new>
 #include <vector>
 
 namespace atcg
@@ -31,15 +40,97 @@ std::vector<std::string> split_string(const std::string& str, const char delimit
     return res;
 }
 
-void parse_xyz_file(const std::shared_ptr<PointCloud>& cloud, const char* path)
+inline bool is_blank(const char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+// Calls func(first, last) for every line of [first, last) that is not blank
+template<typename Func>
+void for_each_line(const char* first, const char* last, Func&& func)
 {
-    std::string line;
-    std::ifstream file;
-    file.open(path);
+    while(first < last)
+    {
+        const char* end = static_cast<const char*>(std::memchr(first, '\n', last - first));
+        if(!end) end = last;
+
+        const char* c = first;
+        while(c < end && is_blank(*c)) ++c;
+        if(c != end) func(first, end);
+
+        first = end == last ? last : end + 1;
+    }
+}
+
+// What a column of the xyz file holds: 0-2 are the coordinates, 3-5 the color channels
+constexpr int8_t XYZ_SKIPPED = -1;
+
+// Bytes per chunk of the parallel readers, small files are read by the calling thread
+constexpr size_t READ_CHUNK_SIZE = 1 << 20;
 
+inline uint32_t parallel_chunks(const size_t& bytes, ThreadPool* pool)
+{
+    return static_cast<uint32_t>(std::clamp<size_t>(bytes / READ_CHUNK_SIZE, 1, 4 * (pool->num_threads() + 1)));
+}
+
+// std::from_chars rejects the explicit plus sign that std::stof accepts
+template<typename T>
+bool parse_number(std::string_view token, T& value)
+{
+    if(token.size() > 1 && token[0] == '+' && token[1] != '-') token.remove_prefix(1);
+    auto [ptr, ec] = std::from_chars(token.data(), token.data() + token.size(), value);
+    return ec == std::errc() && ptr == token.data() + token.size();
+}
+
+// Color channels are stored as floats in [0, 1] (normalized) or as integers in [0, 255]
+inline uint8_t to_color(const float& value, const bool& normalized)
+{
+    return static_cast<uint8_t>(std::clamp(std::round(normalized ? 255.0f * value : value), 0.0f, 255.0f));
+}
+
+// Parses the fields of one line into the point and color. Returns false if a field is missing or a coordinate is
+// malformed, the fields that could not be read are left as they are. A malformed color channel is white
+bool parse_xyz_line(const char* first,
+                    const char* last,
+                    const std::vector<int8_t>& columns,
+                    float* point,
+                    uint8_t* color)
+{
+    bool valid = true;
+    for(int8_t column: columns)
+    {
+        while(first < last && is_blank(*first)) ++first;
+        if(first == last) return false;
+        const char* end = first;
+        while(end < last && !is_blank(*end)) ++end;
+
+        const std::string_view token(first, end - first);
+        if(column >= 3)
+        {
+            float value       = 0.0f;
+            color[column - 3] = parse_number(token, value)
+                                    ? to_color(value, token.find_first_of(".eE") != std::string_view::npos)
+                                    : 255u;
+        }
+        else if(column >= 0)
+        {
+            float value   = 0.0f;
+            valid         = valid && parse_number(token, value);
+            point[column] = value;
+        }
+        first = end;
+    }
+    return valid;
+}
+
+void parse_xyz_file(const std::shared_ptr<PointCloud>& cloud, const char* path)
+{
+    MappedFile file(path);
     if(!file.is_open()) return;
 
-    std::getline(file, line);
+    const char* header_end = std::find(file.begin(), file.end(), '\n');
+    std::string line(file.begin(), header_end);
+    if(!line.empty() && line.back() == '\r') line.pop_back();
 
     bool has_position_data = false, has_color_data = false;
     int32_t x = -1, y = -1, z = -1, r = -1, g = -1, b = -1;
@@ -69,52 +160,1115 @@ void parse_xyz_file(const std::shared_ptr<PointCloud>& cloud, const char* path)
         return;
     }
 
-    while(std::getline(file, line))
+    // Only the fields up to the last used one are parsed
+    std::vector<int8_t> columns(std::max({x, y, z, has_color_data ? std::max({r, g, b}) : 0}) + 1, XYZ_SKIPPED);
+    columns[x] = 0;
+    columns[y] = 1;
+    columns[z] = 2;
+    if(has_color_data)
+    {
+        columns[r] = 3;
+        columns[g] = 4;
+        columns[b] = 5;
+    }
+
+    // The body is split into chunks that start after a line break. The first pass counts the lines of every chunk,
+    // so the second pass can parse each chunk straight into its rows of the preallocated cloud. Malformed lines are
+    // dropped: a chunk only advances past valid rows and the valid rows of all chunks are compacted afterwards
+    ThreadPool* pool       = ThreadPool::get();
+    const char* body       = header_end == file.end() ? file.end() : header_end + 1;
+    const size_t body_size = file.end() - body;
+    const uint32_t chunks  = parallel_chunks(body_size, pool);
+    std::vector<const char*> boundaries(chunks + 1, file.end());
+    boundaries[0] = body;
+    for(uint32_t i = 1; i < chunks; ++i)
+    {
+        const char* start = std::max(body + body_size * i / chunks, boundaries[i - 1]);
+        const char* end   = static_cast<const char*>(std::memchr(start, '\n', file.end() - start));
+        boundaries[i]     = end ? end + 1 : file.end();
+    }
+
+    std::vector<size_t> offsets(chunks + 1, 0);
+    pool->parallel_for(
+        0,
+        chunks,
+        chunks,
+        [&](size_t, size_t, uint32_t chunk)
+        {
+            size_t count = 0;
+            for_each_line(boundaries[chunk], boundaries[chunk + 1], [&](const char*, const char*) { ++count; });
+            offsets[chunk + 1] = count;
+        });
+    std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+
+    cloud->resize(offsets[chunks]);
+    auto points = cloud->points();
+    auto colors = cloud->colors();
+    colors.setConstant(255u);
+
+    std::vector<size_t> valid(chunks, 0);
+    pool->parallel_for(
+        0,
+        chunks,
+        chunks,
+        [&](size_t, size_t, uint32_t chunk)
+        {
+            size_t row = offsets[chunk];
+            for_each_line(boundaries[chunk],
+                          boundaries[chunk + 1],
+                          [&](const char* first, const char* last)
+                          {
+                              float* point = points.row(row).data();
+                              if(!parse_xyz_line(first, last, columns, point, colors.row(row).data())) return;
+                              point[1] = -point[1];
+                              ++row;
+                          });
+            valid[chunk] = row - offsets[chunk];
+        });
+
+    // The chunks are moved down in order, so a destination never overlaps a chunk that is still to be moved
+    size_t count = 0;
+    for(uint32_t chunk = 0; chunk < chunks; ++chunk)
+    {
+        if(count != offsets[chunk] && valid[chunk] > 0)
+        {
+            std::memmove(points.row(count).data(), points.row(offsets[chunk]).data(), valid[chunk] * sizeof(float) * 3);
+            std::memmove(colors.row(count).data(),
+                         colors.row(offsets[chunk]).data(),
+                         valid[chunk] * sizeof(uint8_t) * 3);
+        }
+        count += valid[chunk];
+    }
+
+    if(count < offsets[chunks])
+    {
+        std::cerr << path << ": Skipped " << offsets[chunks] - count << " lines with missing or malformed fields!\n";
+        cloud->resize(count);
+    }
+}
+
+// Splits a line into tokens that are separated by blanks
+class Tokens
+{
+public:
+    Tokens() = default;
+    Tokens(const char* first, const char* last) : _first(first), _last(last) {}
+
+    bool next(std::string_view& token)
+    {
+        while(_first < _last && is_blank(*_first)) ++_first;
+        if(_first == _last) return false;
+
+        const char* end = _first;
+        while(end < _last && !is_blank(*end)) ++end;
+        token  = std::string_view(_first, end - _first);
+        _first = end;
+        return true;
+    }
+
+    // The number of characters that have not been tokenized yet
+    inline size_t remaining() const { return _last - _first; }
+
+private:
+    const char* _first = nullptr;
+    const char* _last  = nullptr;
+};
+
+// Iterates over the lines of a text. Blank lines and comments that start with '#' are skipped
+class Lines
+{
+public:
+    Lines(const char* first, const char* last) : _first(first), _last(last) {}
+
+    bool next(Tokens& tokens)
+    {
+        while(_first < _last)
+        {
+            const char* end = static_cast<const char*>(std::memchr(_first, '\n', _last - _first));
+            if(!end) end = _last;
+
+            const char* c = _first;
+            while(c < end && is_blank(*c)) ++c;
+            _first = end == _last ? _last : end + 1;
+
+            if(c != end && *c != '#')
+            {
+                tokens = Tokens(c, end);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // The first byte after the last line that was returned
+    inline const char* position() const { return _first; }
+
+private:
+    const char* _first;
+    const char* _last;
+};
+
+template<typename T>
+bool parse_numbers(Tokens& tokens, T* values, const uint32_t& count)
+{
+    std::string_view token;
+    for(uint32_t i = 0; i < count; ++i)
+    {
+        if(!tokens.next(token) || !parse_number(token, values[i])) return false;
+    }
+    return true;
+}
+
+// A count of records that cannot fit into the remaining bytes is corrupt. It is rejected before the records are
+// allocated, so a corrupt header cannot exhaust the memory
+inline bool fits_into(const uint64_t& count, const size_t& bytes, const size_t& min_record_bytes)
+{
+    return count <= bytes / std::max<size_t>(min_record_bytes, 1);
+}
+
+// Sums the normals of the faces around each vertex like Mesh::calc_vertex_normal. Polygons are split into a triangle
+// fan like in a TriMesh
+class NormalAccumulator
+{
+public:
+    void add(const uint32_t& vertex, const PointCloud::Normal& normal)
+    {
+        if(vertex >= _sums.size()) _sums.resize(vertex + 1, PointCloud::Normal(0, 0, 0));
+        _sums[vertex] += normal;
+    }
+
+    void add_face(const PointCloud& cloud, const std::vector<uint32_t>& polygon)
+    {
+        for(size_t i = 1; i + 1 < polygon.size(); ++i)
+        {
+            const PointCloud::Point& a = cloud.point(PointCloud::VertexHandle(polygon[0]));
+            const PointCloud::Point& b = cloud.point(PointCloud::VertexHandle(polygon[i]));
+            const PointCloud::Point& c = cloud.point(PointCloud::VertexHandle(polygon[i + 1]));
+
+            PointCloud::Normal normal = (b - a) % (c - a);
+            float length              = normal.norm();
+            if(length == 0.0f) continue;
+            normal /= length;
+
+            add(polygon[0], normal);
+            add(polygon[i], normal);
+            add(polygon[i + 1], normal);
+        }
+    }
+
+    // Vertices without faces keep their normal
+    void apply(PointCloud& cloud) const
+    {
+        auto normals = cloud.normals();
+        for(size_t i = 0; i < std::min(_sums.size(), cloud.n_vertices()); ++i)
+        {
+            float length = _sums[i].norm();
+            if(length > 0.0f) normals.row(i) << _sums[i][0] / length, _sums[i][1] / length, _sums[i][2] / length;
+        }
+    }
+
+private:
+    std::vector<PointCloud::Normal> _sums;
+};
+
+// Reads "v x y z [r g b]" records. The normal of a vertex is the sum of the normals its face corners reference with
+// "f v/vt/vn" or, for faces without them, of the face normals
+bool read_obj_vertices(const MappedFile& file, PointCloud& cloud)
+{
+    std::vector<PointCloud::Normal> file_normals;
+    NormalAccumulator normals;
+    std::vector<uint32_t> polygon, corner_normals;
+
+    Lines lines(file.begin(), file.end());
+    Tokens tokens;
+    std::string_view token;
+    while(lines.next(tokens))
+    {
+        tokens.next(token);
+        if(token == "v")
+        {
+            PointCloud::Point p;
+            if(!parse_numbers(tokens, p.data(), 3)) return false;
+            PointCloud::VertexHandle vh = cloud.add_vertex(p);
+
+            float c[3];
+            if(!parse_numbers(tokens, c, 3)) continue;
+            cloud.set_color(vh, PointCloud::Color {to_color(c[0], true), to_color(c[1], true), to_color(c[2], true)});
+        }
+        else if(token == "vn")
+        {
+            PointCloud::Normal n;
+            if(!parse_numbers(tokens, n.data(), 3)) return false;
+            file_normals.push_back(n);
+        }
+        else if(token == "f")
+        {
+            // Indices start at 1, negative ones count back from the last vertex or normal
+            polygon.clear();
+            corner_normals.clear();
+            while(tokens.next(token))
+            {
+                size_t slash = token.find('/');
+                int64_t v    = 0;
+                if(!parse_number(token.substr(0, slash), v)) return false;
+                v = v < 0 ? static_cast<int64_t>(cloud.n_vertices()) + v : v - 1;
+                if(v < 0 || v >= static_cast<int64_t>(cloud.n_vertices())) return false;
+                polygon.push_back(static_cast<uint32_t>(v));
+
+                size_t second = slash == std::string_view::npos ? slash : token.find('/', slash + 1);
+                int64_t n     = 0;
+                if(second != std::string_view::npos && parse_number(token.substr(second + 1), n))
+                {
+                    n = n < 0 ? static_cast<int64_t>(file_normals.size()) + n : n - 1;
+                    if(n >= 0 && n < static_cast<int64_t>(file_normals.size()))
+                        corner_normals.push_back(static_cast<uint32_t>(n));
+                }
+            }
+
+            if(corner_normals.size() == polygon.size())
+            {
+                for(size_t i = 0; i < polygon.size(); ++i) normals.add(polygon[i], file_normals[corner_normals[i]]);
+            }
+            else
+            {
+                normals.add_face(cloud, polygon);
+            }
+        }
+    }
+
+    normals.apply(cloud);
+    return true;
+}
+
+// Reads the vertices of [C][N]OFF files. Per vertex normals (N) follow the position, colors (C) follow the normal
+bool read_off_vertices(const MappedFile& file, PointCloud& cloud)
+{
+    Lines lines(file.begin(), file.end());
+    Tokens tokens;
+    std::string_view token;
+    if(!lines.next(tokens) || !tokens.next(token)) return false;
+
+    // Texture coordinates, 4D and n-dimensional vertices are left to OpenMesh
+    if(token.size() < 3 || token.substr(token.size() - 3) != "OFF") return false;
+    const std::string_view prefix = token.substr(0, token.size() - 3);
+    if(prefix.find_first_not_of("CN") != std::string_view::npos) return false;
+    const bool has_normals = prefix.find('N') != std::string_view::npos;
+    const bool has_colors  = prefix.find('C') != std::string_view::npos;
+
+    // The counts are either on the header line or on the next one. Binary OFF files are left to OpenMesh
+    uint64_t counts[2];
+    Tokens count_tokens = tokens;
+    if(!parse_numbers(count_tokens, counts, 2))
+    {
+        if(!lines.next(tokens) || !parse_numbers(tokens, counts, 2)) return false;
+    }
+
+    // Every value of a vertex line takes at least a character and a separator, the last line may lack its line break
+    const size_t values = 3 + (has_normals ? 3 : 0) + (has_colors ? 3 : 0);
+    if(!fits_into(counts[0], static_cast<size_t>(file.end() - lines.position()) + 1, 2 * values)) return false;
+
+    cloud.resize(counts[0]);
+    auto points       = cloud.points();
+    auto vertex_norms = cloud.normals();
+    auto colors       = cloud.colors();
+    for(uint64_t i = 0; i < counts[0]; ++i)
+    {
+        if(!lines.next(tokens) || !parse_numbers(tokens, points.row(i).data(), 3)) return false;
+        if(has_normals && !parse_numbers(tokens, vertex_norms.row(i).data(), 3)) return false;
+
+        if(has_colors)
+        {
+            for(uint32_t c = 0; c < 3; ++c)
+            {
+                float value;
+                if(!tokens.next(token) || !parse_number(token, value)) return false;
+                colors(i, c) = to_color(value, token.find_first_of(".eE") != std::string_view::npos);
+            }
+        }
+    }
+    if(has_normals) return true;
+
+    NormalAccumulator normals;
+    std::vector<uint32_t> polygon;
+    for(uint64_t i = 0; i < counts[1]; ++i)
+    {
+        uint32_t size;
+        if(!lines.next(tokens) || !parse_numbers(tokens, &size, 1)) return false;
+
+        // Every index takes at least a separator and a character, a size that does not fit into the line is corrupt
+        if(size > tokens.remaining() / 2) return false;
+        polygon.resize(size);
+        if(!parse_numbers(tokens, polygon.data(), size)) return false;
+        if(std::any_of(polygon.begin(), polygon.end(), [&](uint32_t v) { return v >= counts[0]; })) return false;
+        normals.add_face(cloud, polygon);
+    }
+    normals.apply(cloud);
+    return true;
+}
+
+// The order matches the alternatives of PointCloud::VertexProperty
+enum class PlyType
+{
+    Int8,
+    UInt8,
+    Int16,
+    UInt16,
+    Int32,
+    UInt32,
+    Float32,
+    Float64
+};
+
+// The names of the types. The first name of each type is the one that is written
+constexpr std::pair<const char*, PlyType> PLY_TYPE_NAMES[] = {
+    {"char", PlyType::Int8},
+    {"uchar", PlyType::UInt8},
+    {"short", PlyType::Int16},
+    {"ushort", PlyType::UInt16},
+    {"int", PlyType::Int32},
+    {"uint", PlyType::UInt32},
+    {"float", PlyType::Float32},
+    {"double", PlyType::Float64},
+    {"int8", PlyType::Int8},
+    {"uint8", PlyType::UInt8},
+    {"int16", PlyType::Int16},
+    {"uint16", PlyType::UInt16},
+    {"int32", PlyType::Int32},
+    {"uint32", PlyType::UInt32},
+    {"float32", PlyType::Float32},
+    {"float64", PlyType::Float64}};
+
+bool parse_ply_type(const std::string_view& name, PlyType& type)
+{
+    for(const auto& [n, t]: PLY_TYPE_NAMES)
+    {
+        if(name == n)
+        {
+            type = t;
+            return true;
+        }
+    }
+    return false;
+}
+
+inline const char* ply_type_name(const PlyType& type)
+{
+    return PLY_TYPE_NAMES[static_cast<size_t>(type)].first;
+}
+
+inline PlyType ply_type_of(const PointCloud::VertexProperty& property)
+{
+    return static_cast<PlyType>(property.index());
+}
+
+// Calls func with a value of the C++ type of a PLY type, so it can be instantiated for it
+template<typename Func>
+void visit_ply_type(const PlyType& type, Func&& func)
+{
+    switch(type)
+    {
+        case PlyType::Int8:
+            return func(int8_t {});
+        case PlyType::UInt8:
+            return func(uint8_t {});
+        case PlyType::Int16:
+            return func(int16_t {});
+        case PlyType::UInt16:
+            return func(uint16_t {});
+        case PlyType::Int32:
+            return func(int32_t {});
+        case PlyType::UInt32:
+            return func(uint32_t {});
+        case PlyType::Float32:
+            return func(float {});
+        case PlyType::Float64:
+            return func(double {});
+    }
+}
+
+inline size_t ply_type_size(const PlyType& type)
+{
+    size_t size = 0;
+    visit_ply_type(type, [&](auto value) { size = sizeof(value); });
+    return size;
+}
+
+inline bool is_big_endian()
+{
+    const uint16_t probe = 1;
+    return *reinterpret_cast<const uint8_t*>(&probe) == 0;
+}
+
+// Reads a binary value that is stored in the other byte order if swap is set
+template<typename T>
+inline T load_value(const char* source, const bool& swap)
+{
+    char bytes[sizeof(T)];
+    std::memcpy(bytes, source, sizeof(T));
+    if(swap) std::reverse(bytes, bytes + sizeof(T));
+
+    T value;
+    std::memcpy(&value, bytes, sizeof(T));
+    return value;
+}
+
+struct PlyProperty
+{
+    std::string name;
+    PlyType type;
+    bool list          = false;
+    PlyType count_type = PlyType::UInt8;
+};
+
+struct PlyElement
+{
+    std::string name;
+    uint64_t count;
+    std::vector<PlyProperty> properties;
+};
+
+// Reads the values of a PLY body, either as tokens of ascii lines or as binary values of either byte order
+class PlyValues
+{
+public:
+    PlyValues(const bool& ascii, const bool& big_endian, const char* first, const char* last)
+        : _ascii(ascii),
+          _swap(big_endian != is_big_endian()),
+          _lines(first, last),
+          _position(first),
+          _last(last)
+    {
+    }
+
+    // Every element of an ascii file is on its own line
+    bool begin_element() { return !_ascii || _lines.next(_tokens); }
+
+    bool read(const PlyType& type, double& value)
+    {
+        if(_ascii)
+        {
+            std::string_view token;
+            return _tokens.next(token) && parse_number(token, value);
+        }
+
+        bool valid = false;
+        visit_ply_type(type,
+                       [&](auto tag)
+                       {
+                           using T = decltype(tag);
+                           if(static_cast<size_t>(_last - _position) < sizeof(T)) return;
+                           value = static_cast<double>(load_value<T>(_position, _swap));
+                           _position += sizeof(T);
+                           valid = true;
+                       });
+        return valid;
+    }
+
+    // The binary data that is left and whether it has to be swapped
+    inline const char* position() const { return _position; }
+    inline size_t remaining() const { return _last - _position; }
+    inline bool swap() const { return _swap; }
+    inline void skip(const size_t& bytes) { _position += bytes; }
+
+private:
+    bool _ascii;
+    bool _swap;
+    Lines _lines;
+    Tokens _tokens;
+    const char* _position;
+    const char* _last;
+};
+
+// Where the value of a vertex property goes. Slots 0-2 are the position, 3-5 the normal and 6-8 the color. All
+// other properties are stored as vertex properties of the cloud
+struct PlyVertexColumn
+{
+    int32_t slot  = -1;
+    void* values  = nullptr;    // Data of the vertex property of the cloud, its type is the one of the PLY property
+    size_t offset = 0;          // Byte offset in a binary record
+};
+
+constexpr const char* PLY_VERTEX_SLOTS[9] = {"x", "y", "z", "nx", "ny", "nz", "red", "green", "blue"};
+
+// Reads the vertices of a binary file whose vertex element has no lists. The records have a fixed size, so the
+// vertices are split into chunks that are read in parallel. If the records are exactly the point layout, the points
+// are copied as one block
+void read_ply_vertex_records(const char* records,
+                             const PlyElement& element,
+                             const std::vector<PlyVertexColumn>& columns,
+                             const size_t& record_size,
+                             const bool& swap,
+                             PointCloud& cloud)
+{
+    auto points    = cloud.points();
+    auto normals   = cloud.normals();
+    auto colors    = cloud.colors();
+    const size_t n = element.count;
+
+    bool point_layout = !swap && columns.size() == 3 && record_size == sizeof(PointCloud::Point);
+    for(int32_t p = 0; p < 3 && point_layout; ++p)
+        point_layout = columns[p].slot == p && element.properties[p].type == PlyType::Float32;
+    if(point_layout)
+    {
+        std::memcpy(points.data(), records, n * record_size);
+        return;
+    }
+
+    ThreadPool* pool      = ThreadPool::get();
+    const uint32_t chunks = parallel_chunks(n * record_size, pool);
+    pool->parallel_for(
+        0,
+        n,
+        chunks,
+        [&](size_t first, size_t last, uint32_t)
+        {
+            for(size_t p = 0; p < columns.size(); ++p)
+            {
+                const PlyVertexColumn& column = columns[p];
+                visit_ply_type(element.properties[p].type,
+                               [&](auto tag)
+                               {
+                                   using T            = decltype(tag);
+                                   const char* source = records + first * record_size + column.offset;
+                                   if(column.values)
+                                   {
+                                       T* values = static_cast<T*>(column.values);
+                                       for(size_t i = first; i < last; ++i, source += record_size)
+                                           values[i] = load_value<T>(source, swap);
+                                   }
+                                   else if(column.slot >= 6)
+                                   {
+                                       for(size_t i = first; i < last; ++i, source += record_size)
+                                           colors(i, column.slot - 6) =
+                                               to_color(static_cast<float>(load_value<T>(source, swap)),
+                                                        std::is_floating_point_v<T>);
+                                   }
+                                   else
+                                   {
+                                       auto& target       = column.slot < 3 ? points : normals;
+                                       const int32_t axis = column.slot % 3;
+                                       for(size_t i = first; i < last; ++i, source += record_size)
+                                           target(i, axis) = static_cast<float>(load_value<T>(source, swap));
+                                   }
+                               });
+            }
+        });
+}
+
+// Reads the vertex element of ascii and binary PLY files with all its properties. Without per vertex normals, the
+// normals are computed from the vertex_indices of the face element
+bool read_ply_vertices(const MappedFile& file, PointCloud& cloud)
+{
+    Lines lines(file.begin(), file.end());
+    Tokens tokens;
+    std::string_view token;
+    if(!lines.next(tokens) || !tokens.next(token) || token != "ply") return false;
+
+    bool ascii = false, big_endian = false, header_complete = false;
+    std::vector<PlyElement> elements;
+    while(lines.next(tokens) && tokens.next(token))
+    {
+        if(token == "format")
+        {
+            if(!tokens.next(token)) return false;
+            ascii      = token == "ascii";
+            big_endian = token == "binary_big_endian";
+            if(!ascii && !big_endian && token != "binary_little_endian") return false;
+        }
+        else if(token == "element")
+        {
+            PlyElement element;
+            if(!tokens.next(token)) return false;
+            element.name = std::string(token);
+            if(!parse_numbers(tokens, &element.count, 1)) return false;
+            elements.push_back(element);
+        }
+        else if(token == "property")
+        {
+            if(elements.empty() || !tokens.next(token)) return false;
+            PlyProperty property;
+            if(token == "list")
+            {
+                property.list = true;
+                if(!tokens.next(token) || !parse_ply_type(token, property.count_type) || !tokens.next(token))
+                    return false;
+            }
+            if(!parse_ply_type(token, property.type) || !tokens.next(token)) return false;
+            property.name = std::string(token);
+            elements.back().properties.push_back(property);
+        }
+        else if(token == "end_header")
+        {
+            header_complete = true;
+            break;
+        }
+    }
+    if(!header_complete) return false;
+
+    PlyValues values(ascii, big_endian, lines.position(), file.end());
+    NormalAccumulator normals;
+    std::vector<uint32_t> polygon;
+    bool has_normals = false, vertices_read = false, faces_read = false;
+    for(const PlyElement& element: elements)
     {
-        auto data = split_string(line, ' ');
+        // Once the vertices are read, only the faces are needed and only if the vertices have no normals. Nothing
+        // after them is decoded
+        if(vertices_read && (has_normals || faces_read)) break;
+
+        const bool is_vertex = element.name == "vertex";
+        const bool is_face   = element.name == "face" && cloud.n_vertices() > 0 && !has_normals;
+
+        std::vector<PlyVertexColumn> columns(element.properties.size());
+        bool fixed_size    = !ascii;
+        size_t record_size = 0;
+        if(is_vertex)
+        {
+            // A vertex takes at least a character and a separator per ascii value or the size of each binary value
+            size_t min_size = 0;
+            for(const PlyProperty& property: element.properties)
+                min_size += ascii ? 2 : ply_type_size(property.list ? property.count_type : property.type);
+            if(!fits_into(element.count, values.remaining() + (ascii ? 1 : 0), min_size)) return false;
+
+            cloud.resize(element.count);
+            for(size_t p = 0; p < element.properties.size(); ++p)
+            {
+                const PlyProperty& property = element.properties[p];
+                fixed_size                  = fixed_size && !property.list;
+                columns[p].offset           = record_size;
+                record_size += ply_type_size(property.type);
+                if(property.list) continue;
+
+                for(int32_t s = 0; s < 9; ++s)
+                    if(property.name == PLY_VERTEX_SLOTS[s]) columns[p].slot = s;
+                has_normals = has_normals || (columns[p].slot >= 3 && columns[p].slot < 6);
+                if(columns[p].slot >= 0) continue;
+
+                // Adding further properties moves the value arrays but keeps their data
+                visit_ply_type(property.type,
+                               [&](auto tag)
+                               { columns[p].values = cloud.add_property<decltype(tag)>(property.name).data(); });
+            }
+
+            if(fixed_size)
+            {
+                if(values.remaining() / std::max<size_t>(record_size, 1) < element.count) return false;
+                read_ply_vertex_records(values.position(), element, columns, record_size, values.swap(), cloud);
+                values.skip(element.count * record_size);
+                vertices_read = true;
+                continue;
+            }
+        }
+
+        auto points       = cloud.points();
+        auto vertex_norms = cloud.normals();
+        auto colors       = cloud.colors();
+        for(uint64_t i = 0; i < element.count; ++i)
+        {
+            if(!values.begin_element()) return false;
+            for(size_t p = 0; p < element.properties.size(); ++p)
+            {
+                const PlyProperty& property = element.properties[p];
+                double value;
+                if(!property.list)
+                {
+                    if(!values.read(property.type, value)) return false;
+                    const PlyVertexColumn& column = columns[p];
+                    if(!is_vertex) continue;
+
+                    if(column.values)
+                    {
+                        visit_ply_type(property.type,
+                                       [&](auto tag)
+                                       {
+                                           using T = decltype(tag);
+
+                                           static_cast<T*>(column.values)[i] = static_cast<T>(value);
+                                       });
+                    }
+                    else if(column.slot < 3)
+                        points(i, column.slot) = static_cast<float>(value);
+                    else if(column.slot < 6)
+                        vertex_norms(i, column.slot - 3) = static_cast<float>(value);
+                    else
+                        colors(i, column.slot - 6) = to_color(static_cast<float>(value),
+                                                              property.type == PlyType::Float32 ||
+                                                                  property.type == PlyType::Float64);
+                    continue;
+                }
+
+                double size;
+                if(!values.read(property.count_type, size)) return false;
+                const bool indices = is_face && (property.name == "vertex_indices" || property.name == "vertex_index");
 
-        float x_ = std::stof(data[x]);
-        float y_ = -std::stof(data[y]);
-        float z_ = std::stof(data[z]);
-        auto vh  = cloud->add_vertex(PointCloud::Point {x_, y_, z_});
+                // The binary bodies of lists that are not used are skipped as a whole
+                if(!ascii && !indices)
+                {
+                    const size_t type_size = ply_type_size(property.type);
+                    if(size < 0 || static_cast<uint64_t>(size) > values.remaining() / type_size) return false;
+                    values.skip(static_cast<size_t>(size) * type_size);
+                    continue;
+                }
 
-        uint8_t r_ = has_color_data ? static_cast<uint8_t>(std::stoi(data[r])) : 255u;
-        uint8_t g_ = has_color_data ? static_cast<uint8_t>(std::stoi(data[g])) : 255u;
-        uint8_t b_ = has_color_data ? static_cast<uint8_t>(std::stoi(data[b])) : 255u;
-        cloud->set_color(vh, PointCloud::Color {r_, g_, b_});
+                polygon.clear();
+                for(uint64_t k = 0; k < static_cast<uint64_t>(size); ++k)
+                {
+                    if(!values.read(property.type, value)) return false;
+                    if(indices && value >= 0 && value < cloud.n_vertices())
+                        polygon.push_back(static_cast<uint32_t>(value));
+                }
+                if(indices && polygon.size() == static_cast<size_t>(size)) normals.add_face(cloud, polygon);
+            }
+        }
+        vertices_read = vertices_read || is_vertex;
+        faces_read    = faces_read || is_face;
+    }
+
+    if(!has_normals) normals.apply(cloud);
+    return true;
+}
+
+// Reads the headerless .bin dumps of older versions, e.g. res/pointcloud.bin. Every vertex is a record of 15 floats:
+// the position, the color in [0, 1], the normal and 6 unused values
+bool read_bin_vertices(const MappedFile& file, PointCloud& cloud)
+{
+    constexpr size_t record_size = 15 * sizeof(float);
+    if(file.size() == 0 || file.size() % record_size != 0) return false;
+
+    const size_t n = file.size() / record_size;
+    cloud.resize(n);
+    auto points  = cloud.points();
+    auto normals = cloud.normals();
+    auto colors  = cloud.colors();
+    for(size_t i = 0; i < n; ++i)
+    {
+        float record[15];
+        std::memcpy(record, file.begin() + i * record_size, record_size);
+        points.row(i) << record[0], record[1], record[2];
+        colors.row(i) << to_color(record[3], true), to_color(record[4], true), to_color(record[5], true);
+        normals.row(i) << record[6], record[7], record[8];
     }
+    return true;
+}
+
+inline bool ends_with(const std::string& str, const char* ending)
+{
+    const size_t length = std::strlen(ending);
+    return str.size() >= length && str.compare(str.size() - length, length, ending) == 0;
 }
 }    // namespace detail
 
+MappedPointCloud::MappedPointCloud(const char* path) : _file(path)
+{
+    if(!_file.is_open() || _file.size() < sizeof(PointCloudFileHeader)) return;
+
+    const auto* header = reinterpret_cast<const PointCloudFileHeader*>(_file.begin());
+    if(std::memcmp(header->magic, POINTCLOUD_FILE_MAGIC, sizeof(header->magic)) != 0) return;
+    if(header->version == 0 || header->version > POINTCLOUD_FILE_VERSION)
+    {
+        std::cerr << path << ": Unsupported point cloud file version " << header->version << "!\n";
+        return;
+    }
+
+    // Every block has to lie inside the file. The mapping starts at a page, so aligned offsets are aligned in memory
+    const size_t value_sizes[3] = {sizeof(PointCloud::Point), sizeof(PointCloud::Normal), sizeof(PointCloud::Color)};
+    for(uint32_t i = 0; i < 3; ++i)
+    {
+        if(!(header->attributes & (1u << i))) continue;
+
+        const uint64_t offset = header->offsets[i];
+        if(offset < sizeof(PointCloudFileHeader) || offset % POINTCLOUD_FILE_ALIGNMENT != 0 || offset > _file.size() ||
+           header->count > (_file.size() - offset) / value_sizes[i])
+        {
+            std::cerr << path << ": Corrupt point cloud file!\n";
+            return;
+        }
+    }
+
+    _header = header;
+}
+
+template<class Map>
+Map MappedPointCloud::block(const uint32_t& index) const
+{
+    using Scalar = typename Map::Scalar;
+    return Map(reinterpret_cast<const Scalar*>(_file.begin() + _header->offsets[index]), n_vertices(), 3);
+}
+
+PointCloud::ConstPointMap MappedPointCloud::points() const
+{
+    return block<PointCloud::ConstPointMap>(0);
+}
+
+PointCloud::ConstNormalMap MappedPointCloud::normals() const
+{
+    return block<PointCloud::ConstNormalMap>(1);
+}
+
+PointCloud::ConstColorMap MappedPointCloud::colors() const
+{
+    return block<PointCloud::ConstColorMap>(2);
+}
+
+std::shared_ptr<PointCloud> MappedPointCloud::toPointCloud() const
+{
+    std::shared_ptr<PointCloud> cloud = std::make_shared<PointCloud>();
+    cloud->resize(n_vertices());
+    if(has(PointCloudAttribute::Points)) cloud->points() = points();
+    if(has(PointCloudAttribute::Normals)) cloud->normals() = normals();
+    if(has(PointCloudAttribute::Colors)) cloud->colors() = colors();
+    return cloud;
+}
+
 std::shared_ptr<PointCloud> read_pointcloud(const char* path)
 {
+    // write_pointcloud writes the binary format for every ending besides .ply, so its header is checked first
+    MappedPointCloud binary(path);
+    if(binary.is_valid()) return binary.toPointCloud();
+
     std::shared_ptr<PointCloud> cloud = std::make_shared<PointCloud>();
 
-    std::string path_str    = path;
-    std::string file_ending = path_str.substr(path_str.size() - 4);
+    const std::string path_str = path;
+    if(detail::ends_with(path_str, ".xyz"))
+    {
+        detail::parse_xyz_file(cloud, path);
+        return cloud;
+    }
 
-    if(file_ending == ".xyz") { detail::parse_xyz_file(cloud, path); }
-    else
+    if(detail::ends_with(path_str, ".bin"))
+    {
+        MappedFile file(path);
+        if(!file.is_open() || !detail::read_bin_vertices(file, *cloud))
+        {
+            std::cerr << path << ": Not a point cloud file!\n";
+            return std::make_shared<PointCloud>();
+        }
+        return cloud;
+    }
+
+    // Mesh formats whose vertex records can be read without building the mesh. Unsupported variants of them are read
+    // with OpenMesh
+    const bool is_obj = detail::ends_with(path_str, ".obj");
+    const bool is_off = detail::ends_with(path_str, ".off");
+    const bool is_ply = detail::ends_with(path_str, ".ply");
+    if(is_obj || is_off || is_ply)
+    {
+        MappedFile file(path);
+        bool read = false;
+        if(file.is_open())
+        {
+            if(is_obj)
+                read = detail::read_obj_vertices(file, *cloud);
+            else if(is_off)
+                read = detail::read_off_vertices(file, *cloud);
+            else
+                read = detail::read_ply_vertices(file, *cloud);
+        }
+        if(read) return cloud;
+        cloud = std::make_shared<PointCloud>();
+    }
+
+    // OpenMesh allocates the element counts of the header before it reads them
+    Mesh dummy_mesh;
+    try
     {
-        Mesh dummy_mesh;
         OpenMesh::IO::read_mesh(dummy_mesh, path);
-        dummy_mesh.request_vertex_colors();
-        dummy_mesh.request_face_normals();
-        dummy_mesh.update_normals();
+    }
+    catch(const std::bad_alloc&)
+    {
+        std::cerr << path << ": The element counts do not fit into memory!\n";
+        return cloud;
+    }
+    dummy_mesh.request_vertex_colors();
+    dummy_mesh.request_face_normals();
+    dummy_mesh.update_normals();
+
+    cloud->reserve(dummy_mesh.n_vertices());
+    for(auto vertex: dummy_mesh.vertices())
+    {
+        Mesh::Point p               = dummy_mesh.point(vertex);
+        Mesh::Normal n              = dummy_mesh.calc_vertex_normal(vertex);
+        Mesh::Color c               = dummy_mesh.color(vertex);
+        PointCloud::VertexHandle vh = cloud->add_vertex(p);
+
+        cloud->set_color(vh, c);
+        cloud->set_normal(vh, n);
+    }
+
+    return cloud;
+}
+
+bool write_pointcloud(const std::shared_ptr<PointCloud>& cloud, const char* path)
+{
+    if(detail::ends_with(path, ".ply")) return write_ply(cloud, path);
+
+    std::ofstream file(path, std::ios::binary);
+    if(!file.is_open())
+    {
+        std::cerr << "Could not open " << path << "!\n";
+        return false;
+    }
 
-        for(auto vertex: dummy_mesh.vertices())
+    const size_t n = cloud->n_vertices();
+
+    PointCloudFileHeader header {};
+    std::memcpy(header.magic, POINTCLOUD_FILE_MAGIC, sizeof(header.magic));
+    header.version    = POINTCLOUD_FILE_VERSION;
+    header.count      = n;
+    header.attributes = static_cast<uint32_t>(PointCloudAttribute::Points) |
+                        static_cast<uint32_t>(PointCloudAttribute::Normals) |
+                        static_cast<uint32_t>(PointCloudAttribute::Colors);
+    if(n > 0)
+    {
+        Eigen::Map<Eigen::RowVector3f>(header.min) = cloud->cpoints().colwise().minCoeff();
+        Eigen::Map<Eigen::RowVector3f>(header.max) = cloud->cpoints().colwise().maxCoeff();
+    }
+
+    const char* blocks[3] = {reinterpret_cast<const char*>(cloud->cpoints().data()),
+                             reinterpret_cast<const char*>(cloud->normals().data()),
+                             reinterpret_cast<const char*>(cloud->colors().data())};
+    const size_t sizes[3] = {n * sizeof(PointCloud::Point),
+                             n * sizeof(PointCloud::Normal),
+                             n * sizeof(PointCloud::Color)};
+
+    uint64_t offset = sizeof(PointCloudFileHeader);
+    for(uint32_t i = 0; i < 3; ++i)
+    {
+        offset += (POINTCLOUD_FILE_ALIGNMENT - offset % POINTCLOUD_FILE_ALIGNMENT) % POINTCLOUD_FILE_ALIGNMENT;
+        header.offsets[i] = offset;
+        offset += sizes[i];
+    }
+
+    const char padding[POINTCLOUD_FILE_ALIGNMENT] = {};
+    uint64_t position                             = sizeof(PointCloudFileHeader);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(PointCloudFileHeader));
+    for(uint32_t i = 0; i < 3; ++i)
+    {
+        file.write(padding, header.offsets[i] - position);
+        file.write(blocks[i], sizes[i]);
+        position = header.offsets[i] + sizes[i];
+    }
+
+    file.close();
+    if(!file)
+    {
+        std::cerr << "Could not write " << path << "!\n";
+        return false;
+    }
+    return true;
+}
+
+bool write_ply(const std::shared_ptr<PointCloud>& cloud, const char* path, const bool& binary)
+{
+    std::ofstream file(path, std::ios::binary);
+    if(!file.is_open())
+    {
+        std::cerr << "Could not open " << path << "!\n";
+        return false;
+    }
+
+    // Every column is an array of values with a byte stride: the point, normal and color channels and the properties
+    struct Column
+    {
+        const char* data;
+        size_t stride;
+        detail::PlyType type;
+    };
+
+    const size_t n = cloud->n_vertices();
+    std::vector<Column> columns;
+    std::vector<std::string> names;
+    for(int32_t s = 0; s < 9; ++s)
+    {
+        const char* base = s < 3   ? reinterpret_cast<const char*>(cloud->cpoints().data())
+                           : s < 6 ? reinterpret_cast<const char*>(cloud->normals().data())
+                                   : reinterpret_cast<const char*>(cloud->colors().data());
+        const detail::PlyType type = s < 6 ? detail::PlyType::Float32 : detail::PlyType::UInt8;
+        const size_t size          = detail::ply_type_size(type);
+        columns.push_back({base + (s % 3) * size, 3 * size, type});
+        names.push_back(detail::PLY_VERTEX_SLOTS[s]);
+    }
+    for(const auto& [name, property]: cloud->properties())
+    {
+        const char* values =
+            std::visit([](const auto& v) { return reinterpret_cast<const char*>(v.data()); }, property);
+        const detail::PlyType type = detail::ply_type_of(property);
+        columns.push_back({values, detail::ply_type_size(type), type});
+        names.push_back(name);
+    }
+
+    file << "ply\n";
+    file << "format " << (binary ? "binary_little_endian" : "ascii") << " 1.0\n";
+    file << "element vertex " << n << "\n";
+    for(size_t c = 0; c < columns.size(); ++c)
+    {
+        file << "property " << detail::ply_type_name(columns[c].type) << " " << names[c] << "\n";
+    }
+    file << "end_header\n";
+
+    // The records are interleaved chunk by chunk, so the memory does not grow with the size of the cloud
+    std::vector<char> buffer;
+    if(binary)
+    {
+        size_t record_size = 0;
+        std::vector<size_t> offsets;
+        for(const Column& column: columns)
+        {
+            offsets.push_back(record_size);
+            record_size += detail::ply_type_size(column.type);
+        }
+
+        const bool swap         = detail::is_big_endian();
+        const size_t chunk_size = std::max<size_t>(detail::READ_CHUNK_SIZE / std::max<size_t>(record_size, 1), 1);
+        buffer.resize(chunk_size * record_size);
+        for(size_t first = 0; first < n; first += chunk_size)
+        {
+            const size_t count = std::min(chunk_size, n - first);
+            for(size_t c = 0; c < columns.size(); ++c)
+            {
+                const size_t size  = detail::ply_type_size(columns[c].type);
+                const char* source = columns[c].data + first * columns[c].stride;
+                char* target       = buffer.data() + offsets[c];
+                for(size_t i = 0; i < count; ++i, source += columns[c].stride, target += record_size)
+                {
+                    std::memcpy(target, source, size);
+                    if(swap) std::reverse(target, target + size);
+                }
+            }
+            file.write(buffer.data(), count * record_size);
+        }
+    }
+    else
+    {
+        // Shortest representation that reads back to the same value
+        char number[32];
+        for(size_t i = 0; i < n; ++i)
         {
-            Mesh::Point p               = dummy_mesh.point(vertex);
-            Mesh::Normal n              = dummy_mesh.calc_vertex_normal(vertex);
-            Mesh::Color c               = dummy_mesh.color(vertex);
-            PointCloud::VertexHandle vh = cloud->add_vertex(p);
+            buffer.clear();
+            for(const Column& column: columns)
+            {
+                detail::visit_ply_type(column.type,
+                                       [&](auto tag)
+                                       {
+                                           using T = decltype(tag);
 
-            cloud->set_color(vh, c);
-            cloud->set_normal(vh, n);
+                                           T value;
+                                           std::memcpy(&value, column.data + i * column.stride, sizeof(T));
+                                           char* end = std::to_chars(number, number + sizeof(number), +value).ptr;
+                                           buffer.insert(buffer.end(), number, end);
+                                           buffer.push_back(' ');
+                                       });
+            }
+            buffer.back() = '\n';
+            file.write(buffer.data(), buffer.size());
         }
     }
 
-    return cloud;
+    if(!file)
+    {
+        std::cerr << "Could not write " << path << "!\n";
+        return false;
+    }
+    return true;
 }
 }    // namespace IO
 }    // namespace atcg
\ No newline at end of file
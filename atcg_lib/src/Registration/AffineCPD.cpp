@@ -0,0 +1,149 @@
+#include <Registration/AffineCPD.h>
+
+#include <Eigen/Eigenvalues>
+
+#include <limits>
+
+namespace atcg
+{
+namespace detail
+{
+// Eigenvalues of YPY below this many machine epsilons of the largest one are treated as zero
+constexpr double AFFINE_CPD_SINGULAR_TOLERANCE = 1e3;
+}    // namespace detail
+
+template<typename Scalar, typename Accumulator>
+AffineCoherentPointDriftT<Scalar, Accumulator>::AffineCoherentPointDriftT(const std::shared_ptr<PointCloud>& source,
+                                                                          const std::shared_ptr<PointCloud>& target,
+                                                                          const double& w,
+                                                                          const EStepMethod& method,
+                                                                          const double& epsilon)
+    : RegistrationT<Scalar>::RegistrationT(source, target),
+      w(w),
+      method(method),
+      epsilon(epsilon)
+{
+}
+
+template<typename Scalar, typename Accumulator>
+AffineCoherentPointDriftT<Scalar, Accumulator>::AffineCoherentPointDriftT(
+    const std::shared_ptr<PointCloud>& source,
+    const AffineCoherentPointDriftT<Scalar, Accumulator>& reference)
+    : RegistrationT<Scalar>::RegistrationT(source, reference),
+      w(reference.w),
+      method(reference.method),
+      epsilon(reference.epsilon)
+{
+}
+
+template<typename Scalar, typename Accumulator>
+AffineCoherentPointDriftT<Scalar, Accumulator>::~AffineCoherentPointDriftT() {}
+
+template<typename Scalar, typename Accumulator>
+void AffineCoherentPointDriftT<Scalar, Accumulator>::solve(const uint32_t& maxN, const float& tol)
+{
+    this->expectationMaximization(maxN,
+                                  tol,
+                                  [&](double variance) { estimate(variance); },
+                                  [&](double) { return maximize(); });
+}
+
+template<typename Scalar, typename Accumulator>
+void AffineCoherentPointDriftT<Scalar, Accumulator>::setTransform(const Eigen::Matrix3d& B, const Eigen::Vector3d& t)
+{
+    this->B = B.template cast<Accumulator>();
+    this->t = t.template cast<Accumulator>();
+}
+
+template<typename Scalar, typename Accumulator>
+void AffineCoherentPointDriftT<Scalar, Accumulator>::estimate(double var)
+{
+    Matrix T = transformedTarget();
+    EStep::compute<Scalar, Accumulator>(method, X, T, var, w, epsilon, P1, PT1, PX);
+}
+
+template<typename Scalar, typename Accumulator>
+typename AffineCoherentPointDriftT<Scalar, Accumulator>::Matrix
+AffineCoherentPointDriftT<Scalar, Accumulator>::transformedTarget() const
+{
+    Eigen::Matrix<Scalar, 3, 3> B_ = B.template cast<Scalar>();
+    return (Y * B_.transpose()).rowwise() + t.template cast<Scalar>().transpose();
+}
+
+template<typename Scalar, typename Accumulator>
+double AffineCoherentPointDriftT<Scalar, Accumulator>::maximize()
+{
+    // All sums over the points are evaluated in the accumulation precision without centered copies of X and Y
+    Accumulator Np = 0;
+    Vector3 uX     = Vector3::Zero();
+    Vector3 uY     = Vector3::Zero();
+    for(uint32_t n = 0; n < N; ++n)
+    {
+        Np += PT1(n);
+        uX += PT1(n) * X.template block<1, 3>(n, 0).transpose().template cast<Accumulator>();
+    }
+    for(uint32_t m = 0; m < M; ++m)
+    {
+        uY += P1(m) * Y.template block<1, 3>(m, 0).transpose().template cast<Accumulator>();
+    }
+    uX /= Np;
+    uY /= Np;
+
+    // XC^T * d(PT1) * XC
+    Accumulator XPX = 0;
+    for(uint32_t n = 0; n < N; ++n)
+    {
+        XPX += PT1(n) * (X.template block<1, 3>(n, 0).transpose().template cast<Accumulator>() - uX).squaredNorm();
+    }
+
+    // A = XC^T * P^T * YC = (P * X - P1 * uX^T)^T * YC and YPY = YC^T * d(P1) * YC
+    Matrix3 A   = Matrix3::Zero();
+    Matrix3 YPY = Matrix3::Zero();
+    for(uint32_t m = 0; m < M; ++m)
+    {
+        Vector3 yc = Y.template block<1, 3>(m, 0).transpose().template cast<Accumulator>() - uY;
+        Vector3 px = PX.template block<1, 3>(m, 0).transpose().template cast<Accumulator>() - P1(m) * uX;
+        A += px * yc.transpose();
+        YPY += P1(m) * yc * yc.transpose();
+    }
+
+    // B = A * YPY^-1, YPY is symmetric positive semidefinite. It is singular if the weighted target is degenerate
+    // (planar or collinear). B is then only determined in the span of the target, along the other directions the
+    // previous transformation is kept
+    Eigen::SelfAdjointEigenSolver<Matrix3> eigen;
+    eigen.computeDirect(YPY);
+    const Vector3& lambda = eigen.eigenvalues();    // Ascending
+    if(!(lambda(2) > 0)) return var;
+
+    const Accumulator tolerance = static_cast<Accumulator>(detail::AFFINE_CPD_SINGULAR_TOLERANCE) *
+                                  std::numeric_limits<Accumulator>::epsilon() * lambda(2);
+    Matrix3 inverse = Matrix3::Zero();
+    Matrix3 kept    = Matrix3::Zero();
+    for(int i = 0; i < 3; ++i)
+    {
+        const Vector3 v = eigen.eigenvectors().col(i);
+        if(lambda(i) > tolerance)
+            inverse += v * v.transpose() / lambda(i);
+        else
+            kept += v * v.transpose();
+    }
+    B = A * inverse + B * kept;
+
+    t = uX - B * uY;
+
+    return static_cast<double>((XPX - (A * B.transpose()).trace()) / (3 * Np));
+}
+
+template<typename Scalar, typename Accumulator>
+void AffineCoherentPointDriftT<Scalar, Accumulator>::applyTransform(const std::shared_ptr<PointCloud>& cloud)
+{
+    Eigen::Matrix3d B_ = B.template cast<double>();
+    Eigen::Vector3d t_ = t.template cast<double>();
+    auto points = cloud->points();
+    points      = ((points.cast<double>() * B_.transpose()).rowwise() + t_.transpose()).cast<float>();
+}
+
+template class AffineCoherentPointDriftT<double, double>;
+template class AffineCoherentPointDriftT<float, double>;
+template class AffineCoherentPointDriftT<float, float>;
+}    // namespace atcg
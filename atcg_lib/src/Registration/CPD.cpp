@@ -1,162 +1,129 @@
 #include <Registration/CPD.h>
 
-#include <glm/glm.hpp>
-#include <glm/ext/scalar_constants.hpp>
-
-#include <DataStructure/Statistics.h>
-#include <DataStructure/Timer.h>
-
-#include <iostream>
-
-
 namespace atcg
 {
-Statistic<float> statistic_estimate("estimate");
-Statistic<float> statistic_maximize("maximize");
-
-CoherentPointDrift::CoherentPointDrift(const std::shared_ptr<PointCloud>& source,
-                                       const std::shared_ptr<PointCloud>& target,
-                                       const double& w)
-    : Registration::Registration(source, target),
-      w(w)
+template<typename Scalar, typename Accumulator>
+CoherentPointDriftT<Scalar, Accumulator>::CoherentPointDriftT(const std::shared_ptr<PointCloud>& source,
+                                                              const std::shared_ptr<PointCloud>& target,
+                                                              const double& w,
+                                                              const EStepMethod& method,
+                                                              const double& epsilon)
+    : RegistrationT<Scalar>::RegistrationT(source, target),
+      w(w),
+      method(method),
+      epsilon(epsilon)
 {
 }
 
-CoherentPointDrift::~CoherentPointDrift() {}
-
-void CoherentPointDrift::solve(const uint32_t& maxN, const float& tol)
+template<typename Scalar, typename Accumulator>
+CoherentPointDriftT<Scalar, Accumulator>::CoherentPointDriftT(const std::shared_ptr<PointCloud>& source,
+                                                              const CoherentPointDriftT<Scalar, Accumulator>& reference)
+    : RegistrationT<Scalar>::RegistrationT(source, reference),
+      w(reference.w),
+      method(reference.method),
+      epsilon(reference.epsilon)
 {
-    double var     = initialize();
-    double old_var = 0.0;
-    uint32_t n     = 0;
-    while(n < maxN && std::abs(old_var - var) > tol)
-    {
-        ++n;
-        std::cout << "Iteration: " << n << "\n";
-
-        P                  = RowMatrix::Zero(M, N);
-        Eigen::VectorXd PX = Eigen::VectorXd::Zero(N);
-        Eigen::VectorXd PY = Eigen::VectorXd::Zero(M);
-
-        {
-            Timer timer;
-            estimate(PX, PY, var);
-            statistic_estimate.addSample(timer.elapsedMillis());
-        }
-
-        old_var = var;
-        {
-            Timer timer;
-            var = maximize(PX, PY);
-            statistic_maximize.addSample(timer.elapsedMillis());
-        }
-    }
-
-    std::cout << statistic_estimate;
-    std::cout << statistic_maximize;
 }
 
-double CoherentPointDrift::initialize()
-{
-    double var = 0.0;
-    for(size_t n = 0; n < N; ++n)
-    {
-        for(size_t m = 0; m < M; ++m)
-        {
-            Eigen::Vector3d d = (X.block<1, 3>(n, 0) - Y.block<1, 3>(m, 0));
-            var += d.dot(d) / static_cast<double>(3 * N * M);
-        }
-    }
-    return var;
-}
+template<typename Scalar, typename Accumulator>
+CoherentPointDriftT<Scalar, Accumulator>::~CoherentPointDriftT() {}
 
-void CoherentPointDrift::estimate(Eigen::VectorXd& PX, Eigen::VectorXd& PY, double var)
+template<typename Scalar, typename Accumulator>
+void CoherentPointDriftT<Scalar, Accumulator>::solve(const uint32_t& maxN, const float& tol)
 {
-    double bias = std::pow(2.0 * glm::pi<double>() * var, 3.0 / 2.0) * w / (1.0 - w) * static_cast<double>(M) /
-                  static_cast<double>(N);
-
-    direct_optimization(PX, PY, bias, var);
+    this->expectationMaximization(maxN,
+                                  tol,
+                                  [&](double variance) { estimate(variance); },
+                                  [&](double) { return maximize(); });
 }
 
-void CoherentPointDrift::direct_optimization(Eigen::VectorXd& PX, Eigen::VectorXd& PY, double bias, double var)
+template<typename Scalar, typename Accumulator>
+void CoherentPointDriftT<Scalar, Accumulator>::setTransform(const double& s,
+                                                            const Eigen::Matrix3d& R,
+                                                            const Eigen::Vector3d& t)
 {
-    Eigen::VectorXd Z = Eigen::VectorXd::Constant(N, bias);
-    for(size_t m = 0; m < M; ++m)
-    {
-        Eigen::Vector3d YV = Y.block<1, 3>(m, 0);
-        YV                 = s * R * YV + t;
-
-        for(size_t n = 0; n < N; ++n)
-        {
-            P(m, n) = Pmn(X.block<1, 3>(n, 0), YV, var);
-            Z(n) += P(m, n);
-        }
-    }
-
-    for(size_t m = 0; m < M; ++m)
-    {
-        for(size_t n = 0; n < N; ++n)
-        {
-            P(m, n) /= Z(n);
-            PX(n) += P(m, n);    // PT1
-            PY(m) += P(m, n);    // P1
-        }
-    }
-
-    // P.array().rowwise() /= Z.transpose().array();
-    // PX = P.rowwise().sum();
-    // PY = P.colwise().sum();
+    this->s = static_cast<Accumulator>(s);
+    this->R = R.template cast<Accumulator>();
+    this->t = t.template cast<Accumulator>();
 }
 
-double CoherentPointDrift::Pmn(const Eigen::Vector3d& x, const Eigen::Vector3d& y, double var)
+template<typename Scalar, typename Accumulator>
+void CoherentPointDriftT<Scalar, Accumulator>::estimate(double var)
 {
-    return std::exp(-0.5f / var * (x - y).dot(x - y));
+    Matrix T = transformedTarget();
+    EStep::compute<Scalar, Accumulator>(method, X, T, var, w, epsilon, P1, PT1, PX);
 }
 
-double CoherentPointDrift::Pmn(const double& L2S, double var)
+template<typename Scalar, typename Accumulator>
+typename CoherentPointDriftT<Scalar, Accumulator>::Matrix
+CoherentPointDriftT<Scalar, Accumulator>::transformedTarget() const
 {
-    return std::exp(-0.5f / var * L2S);
+    Eigen::Matrix<Scalar, 3, 3> sR = (s * R).template cast<Scalar>();
+    return (Y * sR.transpose()).rowwise() + t.template cast<Scalar>().transpose();
 }
 
-double CoherentPointDrift::maximize(Eigen::VectorXd& PX, Eigen::VectorXd& PY)
+template<typename Scalar, typename Accumulator>
+double CoherentPointDriftT<Scalar, Accumulator>::maximize()
 {
-    double Np          = 1.0 / P.sum();
-    Eigen::Vector3d uX = X.transpose() * PX * Np;
-    Eigen::Vector3d uY = Y.transpose() * PY * Np;
+    // All sums over the points are evaluated in the accumulation precision without centered copies of X and Y
+    Accumulator Np = 0;
+    Vector3 uX     = Vector3::Zero();
+    Vector3 uY     = Vector3::Zero();
+    for(uint32_t n = 0; n < N; ++n)
+    {
+        Np += PT1(n);
+        uX += PT1(n) * X.template block<1, 3>(n, 0).transpose().template cast<Accumulator>();
+    }
+    for(uint32_t m = 0; m < M; ++m)
+    {
+        uY += P1(m) * Y.template block<1, 3>(m, 0).transpose().template cast<Accumulator>();
+    }
+    uX /= Np;
+    uY /= Np;
 
-    RowMatrix XC = X.rowwise() - uX.transpose();
-    RowMatrix YC = Y.rowwise() - uY.transpose();
+    // XC^T * d(PT1) * XC
+    Accumulator XPX = 0;
+    for(uint32_t n = 0; n < N; ++n)
+    {
+        XPX += PT1(n) * (X.template block<1, 3>(n, 0).transpose().template cast<Accumulator>() - uX).squaredNorm();
+    }
 
-    RowMatrix A = XC.transpose() * P.transpose() * YC;
+    // A = XC^T * P^T * YC = (P * X - P1 * uX^T)^T * YC and YC^T * d(P1) * YC
+    Matrix3 A       = Matrix3::Zero();
+    Accumulator YPY = 0;
+    for(uint32_t m = 0; m < M; ++m)
+    {
+        Vector3 yc = Y.template block<1, 3>(m, 0).transpose().template cast<Accumulator>() - uY;
+        Vector3 px = PX.template block<1, 3>(m, 0).transpose().template cast<Accumulator>() - P1(m) * uX;
+        A += px * yc.transpose();
+        YPY += P1(m) * yc.squaredNorm();
+    }
 
     svd.compute(A);
-    RowMatrix U = svd.matrixU();
-    RowMatrix V = svd.matrixV();
+    Matrix3 U = svd.matrixU();
+    Matrix3 V = svd.matrixV();
 
-    RowMatrix C = RowMatrix::Identity(3, 3);
-    C(2, 2)     = (U * V.transpose()).determinant();
+    Matrix3 C = Matrix3::Identity();
+    C(2, 2)   = (U * V.transpose()).determinant();
 
     R = U * C * V.transpose();
-    s = (A.transpose() * R).trace() / (YC.transpose() * PY.asDiagonal() * YC).trace();
-
-    double var = Np / 3 * ((XC.transpose() * PX.asDiagonal() * XC).trace() - s * (A.transpose() * R).trace());
+    s = (A.transpose() * R).trace() / YPY;
 
     t = uX - s * R * uY;
 
-    return var;
+    return static_cast<double>((XPX - s * (A.transpose() * R).trace()) / (3 * Np));
 }
 
-void CoherentPointDrift::applyTransform(const std::shared_ptr<PointCloud>& cloud)
+template<typename Scalar, typename Accumulator>
+void CoherentPointDriftT<Scalar, Accumulator>::applyTransform(const std::shared_ptr<PointCloud>& cloud)
 {
-    for(auto v_it = cloud->vertices_begin(); v_it != cloud->vertices_end(); ++v_it)
-    {
-        PointCloud::Point p_ = cloud->point(*v_it);
-        Eigen::Vector3d p;
-        p(0) = p_[0];
-        p(1) = p_[1];
-        p(2) = p_[2];
-        p    = s * R * p + t;
-        cloud->set_point(*v_it, PointCloud::Point {p(0), p(1), p(2)});
-    }
+    Eigen::Matrix3d sR = (s * R).template cast<double>();
+    Eigen::Vector3d t_ = t.template cast<double>();
+    auto points = cloud->points();
+    points      = ((points.cast<double>() * sR.transpose()).rowwise() + t_.transpose()).cast<float>();
 }
+
+template class CoherentPointDriftT<double, double>;
+template class CoherentPointDriftT<float, double>;
+template class CoherentPointDriftT<float, float>;
 }    // namespace atcg
\ No newline at end of file
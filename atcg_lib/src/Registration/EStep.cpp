@@ -0,0 +1,263 @@
+#include <Registration/EStep.h>
+#include <Registration/FastGaussTransform.h>
+#include <Registration/GaussianKernel.h>
+
+#include <Core/ThreadPool.h>
+
+#include <glm/glm.hpp>
+#include <glm/ext/scalar_constants.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace atcg
+{
+namespace detail
+{
+// Number of data points that share one pass over the centroids
+constexpr size_t ESTEP_BLOCK_SIZE = 8;
+
+// Number of centroids per tile. The coordinates, affinities and sums of a tile stay in the L2 cache
+constexpr size_t ESTEP_TILE_SIZE = 1024;
+}    // namespace detail
+
+namespace EStep
+{
+template<typename Scalar, typename Accumulator>
+void direct(const RowMatrixT<Scalar>& X,
+            const RowMatrixT<Scalar>& T,
+            const double& var,
+            const double& bias,
+            VectorT<Scalar>& P1,
+            VectorT<Scalar>& PT1,
+            RowMatrixT<Scalar>& PX)
+{
+    const size_t N     = X.rows();
+    const size_t M     = T.rows();
+    const Scalar scale = static_cast<Scalar>(-0.5 / var);
+
+    // Structure of arrays copy of the centroids, the inner loops stream over them
+    std::vector<Scalar> tx(M), ty(M), tz(M);
+    for(size_t m = 0; m < M; ++m)
+    {
+        tx[m] = T(m, 0);
+        ty[m] = T(m, 1);
+        tz[m] = T(m, 2);
+    }
+
+    ThreadPool* pool      = ThreadPool::get();
+    const uint32_t chunks = pool->num_threads() + 1;
+    std::vector<VectorT<Accumulator>> local_P1(chunks);
+    std::vector<RowMatrixT<Accumulator>> local_PX(chunks);
+
+    PT1 = VectorT<Scalar>::Zero(N);
+    pool->parallel_for(
+        0,
+        N,
+        chunks,
+        [&](size_t first, size_t last, uint32_t chunk)
+        {
+            DenormalGuard guard;
+
+            VectorT<Accumulator>& p1    = local_P1[chunk];
+            RowMatrixT<Accumulator>& px = local_PX[chunk];
+            p1                          = VectorT<Accumulator>::Zero(M);
+            px                          = RowMatrixT<Accumulator>::Zero(M, 3);
+
+            // The affinities of the block to all centroids are stored tile after tile, every tile holds the rows of
+            // all points of the block
+            std::vector<Scalar> K(detail::ESTEP_BLOCK_SIZE * M);
+            std::vector<Scalar> S(4 * detail::ESTEP_TILE_SIZE);
+            Accumulator Z[detail::ESTEP_BLOCK_SIZE];
+            Scalar Z_inv[detail::ESTEP_BLOCK_SIZE];
+            for(size_t block = first; block < last; block += detail::ESTEP_BLOCK_SIZE)
+            {
+                const size_t count = std::min(detail::ESTEP_BLOCK_SIZE, last - block);
+
+                // Affinities of every point in the block to all centroids and their normalization. The points of the
+                // block share the coordinates of a tile while it is in the cache
+                std::fill(Z, Z + count, static_cast<Accumulator>(bias));
+                for(size_t tile = 0; tile < M; tile += detail::ESTEP_TILE_SIZE)
+                {
+                    const size_t length = std::min(detail::ESTEP_TILE_SIZE, M - tile);
+                    for(size_t j = 0; j < count; ++j)
+                    {
+                        Z[j] += static_cast<Accumulator>(GaussianKernel::evaluate(X.row(block + j).data(),
+                                                                                  tx.data() + tile,
+                                                                                  ty.data() + tile,
+                                                                                  tz.data() + tile,
+                                                                                  length,
+                                                                                  scale,
+                                                                                  K.data() + tile * count + j * length));
+                    }
+                }
+
+                for(size_t j = 0; j < count; ++j)
+                {
+                    // Points that are not explained by any gaussian (only possible without outliers) do not contribute
+                    Accumulator inv =
+                        Z[j] > std::numeric_limits<Accumulator>::min() ? Accumulator(1) / Z[j] : Accumulator(0);
+                    Z_inv[j]       = static_cast<Scalar>(inv);
+                    PT1(block + j) = static_cast<Scalar>((Z[j] - static_cast<Accumulator>(bias)) * inv);
+                }
+
+                // Sums over the block in the data precision, tile by tile. The loops over the centroids are contiguous
+                for(size_t tile = 0; tile < M; tile += detail::ESTEP_TILE_SIZE)
+                {
+                    const size_t length = std::min(detail::ESTEP_TILE_SIZE, M - tile);
+                    std::fill(S.begin(), S.end(), Scalar(0));
+                    Scalar* s0 = S.data();
+                    Scalar* s1 = s0 + length;
+                    Scalar* s2 = s1 + length;
+                    Scalar* s3 = s2 + length;
+                    for(size_t j = 0; j < count; ++j)
+                    {
+                        const Scalar* k = K.data() + tile * count + j * length;
+                        const Scalar z  = Z_inv[j];
+                        const Scalar x0 = X(block + j, 0);
+                        const Scalar x1 = X(block + j, 1);
+                        const Scalar x2 = X(block + j, 2);
+                        for(size_t m = 0; m < length; ++m)
+                        {
+                            Scalar p = k[m] * z;
+                            s0[m] += p;
+                            s1[m] += p * x0;
+                            s2[m] += p * x1;
+                            s3[m] += p * x2;
+                        }
+                    }
+
+                    for(size_t m = 0; m < length; ++m)
+                    {
+                        p1(tile + m) += s0[m];
+                        px(tile + m, 0) += s1[m];
+                        px(tile + m, 1) += s2[m];
+                        px(tile + m, 2) += s3[m];
+                    }
+                }
+            }
+        });
+
+    VectorT<Accumulator> sum_P1    = VectorT<Accumulator>::Zero(M);
+    RowMatrixT<Accumulator> sum_PX = RowMatrixT<Accumulator>::Zero(M, 3);
+    for(uint32_t chunk = 0; chunk < chunks; ++chunk)
+    {
+        if(local_P1[chunk].size() == 0) continue;
+        sum_P1 += local_P1[chunk];
+        sum_PX += local_PX[chunk];
+    }
+    P1 = sum_P1.template cast<Scalar>();
+    PX = sum_PX.template cast<Scalar>();
+}
+
+template<typename Scalar, typename Accumulator>
+void fast_gauss_transform(const RowMatrixT<Scalar>& X,
+                          const RowMatrixT<Scalar>& T,
+                          const double& var,
+                          const double& bias,
+                          const double& epsilon,
+                          VectorT<Scalar>& P1,
+                          VectorT<Scalar>& PT1,
+                          RowMatrixT<Scalar>& PX)
+{
+    const size_t N = X.rows();
+    const size_t M = T.rows();
+
+    // The transforms work in double precision. For double data the casts are no-ops
+    const RowMatrix& X_ = X.template cast<double>();
+    const RowMatrix& T_ = T.template cast<double>();
+
+    // Both gaussian sums use the kernel exp(-||x - y||^2 / (2 * var)), i.e. a bandwidth of sqrt(2 * var)
+    double h = std::sqrt(2.0 * var);
+
+    // The clustering is cheap next to the transforms. If the cost model of either transform predicts no gain over the
+    // N * M pairs, the tiled direct E-step is faster
+    FastGaussTransform transform_T(T_, h, epsilon);
+    FastGaussTransform transform_X(X_, h, epsilon);
+    if(!transform_T.pays_off() || !transform_X.pays_off())
+    {
+        direct<Scalar, Accumulator>(X, T, var, bias, P1, PT1, PX);
+        return;
+    }
+
+    // Normalization Z(n) = bias + sum_m exp(-||x_n - T_m||^2 / (2 * var))
+    Eigen::VectorXd Z = transform_T.compute(RowMatrix::Ones(M, 1), X_).col(0).array().max(0.0) + bias;
+
+    // Points that are not explained by any gaussian (only possible without outlier weight) do not contribute
+    RowMatrix weights(N, 4);
+    for(size_t n = 0; n < N; ++n)
+    {
+        double Z_inv  = Z(n) > std::numeric_limits<double>::min() ? 1.0 / Z(n) : 0.0;
+        weights(n, 0) = Z_inv;
+        weights(n, 1) = Z_inv * X_(n, 0);
+        weights(n, 2) = Z_inv * X_(n, 1);
+        weights(n, 3) = Z_inv * X_(n, 2);
+    }
+
+    // P1 = sum_n exp(...) / Z(n) and PX = sum_n exp(...) * x_n / Z(n)
+    RowMatrix KW = transform_X.compute(weights, T_);
+
+    P1  = KW.col(0).template cast<Scalar>();
+    PX  = KW.rightCols(3).template cast<Scalar>();
+    PT1 = (Z - Eigen::VectorXd::Constant(N, bias)).cwiseProduct(weights.col(0)).template cast<Scalar>();
+}
+
+template<typename Scalar, typename Accumulator>
+void compute(const EStepMethod& method,
+             const RowMatrixT<Scalar>& X,
+             const RowMatrixT<Scalar>& T,
+             const double& var,
+             const double& w,
+             const double& epsilon,
+             VectorT<Scalar>& P1,
+             VectorT<Scalar>& PT1,
+             RowMatrixT<Scalar>& PX)
+{
+    double bias = std::pow(2.0 * glm::pi<double>() * var, 3.0 / 2.0) * w / (1.0 - w) *
+                  static_cast<double>(T.rows()) / static_cast<double>(X.rows());
+
+    switch(method)
+    {
+        case EStepMethod::FastGaussTransform:
+            fast_gauss_transform<Scalar, Accumulator>(X, T, var, bias, epsilon, P1, PT1, PX);
+            break;
+        default:
+            direct<Scalar, Accumulator>(X, T, var, bias, P1, PT1, PX);
+            break;
+    }
+}
+#define ATCG_INSTANTIATE_ESTEP(Scalar, Accumulator)                                                                    \
+    template void direct<Scalar, Accumulator>(const RowMatrixT<Scalar>&,                                              \
+                                              const RowMatrixT<Scalar>&,                                              \
+                                              const double&,                                                          \
+                                              const double&,                                                          \
+                                              VectorT<Scalar>&,                                                       \
+                                              VectorT<Scalar>&,                                                       \
+                                              RowMatrixT<Scalar>&);                                                   \
+    template void fast_gauss_transform<Scalar, Accumulator>(const RowMatrixT<Scalar>&,                                \
+                                                            const RowMatrixT<Scalar>&,                                \
+                                                            const double&,                                            \
+                                                            const double&,                                            \
+                                                            const double&,                                            \
+                                                            VectorT<Scalar>&,                                         \
+                                                            VectorT<Scalar>&,                                         \
+                                                            RowMatrixT<Scalar>&);                                     \
+    template void compute<Scalar, Accumulator>(const EStepMethod&,                                                    \
+                                               const RowMatrixT<Scalar>&,                                             \
+                                               const RowMatrixT<Scalar>&,                                             \
+                                               const double&,                                                         \
+                                               const double&,                                                         \
+                                               const double&,                                                         \
+                                               VectorT<Scalar>&,                                                      \
+                                               VectorT<Scalar>&,                                                      \
+                                               RowMatrixT<Scalar>&);
+
+ATCG_INSTANTIATE_ESTEP(double, double)
+ATCG_INSTANTIATE_ESTEP(float, double)
+ATCG_INSTANTIATE_ESTEP(float, float)
+
+#undef ATCG_INSTANTIATE_ESTEP
+}    // namespace EStep
+}    // namespace atcg
\ No newline at end of file
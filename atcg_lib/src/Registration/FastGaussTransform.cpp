@@ -0,0 +1,346 @@
+#include <Registration/FastGaussTransform.h>
+
+#include <Core/ThreadPool.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace atcg
+{
+namespace detail
+{
+// Largest truncation order that is considered
+constexpr uint32_t FGT_MAX_ORDER = 24;
+
+uint32_t num_monomials(const uint32_t& p)
+{
+    // Number of monomials in three variables of degree < p: (p + 2) choose 3
+    return p * (p + 1) * (p + 2) / 6;
+}
+
+uint32_t truncation_order(const double& rx, const double& ry, const double& h, const double& epsilon)
+{
+    // Truncation error of the Taylor series (Raykar et al. 2005):
+    // (2^p / p!) * (rx * b / h^2)^p * exp(-(rx - b)^2 / h^2) <= epsilon
+    // where b <= ry is the target distance that maximizes the error
+    double log_epsilon = std::log(epsilon);
+    for(uint32_t p = 1; p <= FGT_MAX_ORDER; ++p)
+    {
+        double b         = std::min(ry, 0.5 * (rx + std::sqrt(rx * rx + 2.0 * p * h * h)));
+        double log_ratio = std::log(std::max(rx * b / (h * h), std::numeric_limits<double>::min()));
+        double log_error = p * std::log(2.0) - std::lgamma(p + 1.0) + p * log_ratio - (rx - b) * (rx - b) / (h * h);
+        if(log_error <= log_epsilon) return p;
+    }
+    return 0;
+}
+}    // namespace detail
+
+FastGaussTransform::FastGaussTransform(const RowMatrix& sources, const double& h, const double& epsilon)
+    : _sources(sources),
+      _h(h)
+{
+    _epsilon = std::clamp(epsilon, std::numeric_limits<double>::epsilon(), 0.5);
+    if(_sources.rows() == 0) return;
+
+    chooseParameters();
+    cluster();
+
+    // Now that the real cluster radius is known, fix the truncation order
+    _ry = _rx + _h * std::sqrt(-std::log(_epsilon));
+    if(_p != 0) _p = detail::truncation_order(_rx, _ry, _h, _epsilon);
+    _terms = detail::num_monomials(_p);
+
+    // Constants 2^|alpha| / alpha! in the same order as computeMonomials()
+    _constants.resize(_terms);
+    if(_terms == 0) return;
+    std::vector<uint32_t> exponents(3 * _terms, 0);
+    uint32_t heads[3] = {0, 0, 0};
+    uint32_t t        = 1;
+    _constants[0]     = 1.0;
+    for(uint32_t k = 1; k < _p; ++k)
+    {
+        uint32_t tail = t;
+        for(uint32_t i = 0; i < 3; ++i)
+        {
+            uint32_t head = heads[i];
+            heads[i]      = t;
+            for(uint32_t j = head; j < tail; ++j, ++t)
+            {
+                for(uint32_t l = 0; l < 3; ++l) exponents[3 * t + l] = exponents[3 * j + l];
+                ++exponents[3 * t + i];
+                _constants[t] = _constants[j] * 2.0 / static_cast<double>(exponents[3 * t + i]);
+            }
+        }
+    }
+}
+
+FastGaussTransform::~FastGaussTransform() {}
+
+void FastGaussTransform::chooseParameters()
+{
+    const uint32_t N = static_cast<uint32_t>(_sources.rows());
+
+    Eigen::Vector3d min_corner = _sources.colwise().minCoeff();
+    Eigen::Vector3d max_corner = _sources.colwise().maxCoeff();
+    double radius              = std::max(0.5 * (max_corner - min_corner).norm(), std::numeric_limits<double>::min());
+    double cutoff              = _h * std::sqrt(-std::log(_epsilon));
+
+    // Farthest point clustering is O(NK), so more than a few times sqrt(N) clusters do not pay off
+    uint32_t K_limit = std::min(N, 4u * static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(N)))));
+
+    // The cost model assumes as many targets as sources and uniformly distributed points
+    _direct_cost     = static_cast<double>(N) * N;
+    double best_cost = std::numeric_limits<double>::infinity();
+    for(uint32_t K = 1; K <= K_limit; K = std::max(K + 1, K * 5 / 4))
+    {
+        double rx      = radius * std::pow(static_cast<double>(K), -1.0 / 3.0);
+        double ry      = rx + cutoff;
+        double visited = std::min(1.0, std::pow(ry / radius, 3.0));
+        double cluster = 2.0 * static_cast<double>(N) * K;
+
+        uint32_t p = detail::truncation_order(rx, ry, _h, _epsilon);
+        if(p != 0)
+        {
+            double terms = static_cast<double>(detail::num_monomials(p));
+            double cost  = cluster + N * terms + N * terms * std::max(1.0, visited * K);
+            if(cost < best_cost)
+            {
+                best_cost = cost;
+                _K        = K;
+                _p        = p;
+            }
+        }
+
+        double cost = cluster + static_cast<double>(N) * N * visited;
+        if(cost < best_cost)
+        {
+            best_cost = cost;
+            _K        = K;
+            _p        = 0;
+        }
+    }
+    _cost = best_cost;
+}
+
+void FastGaussTransform::cluster()
+{
+    const uint32_t N = static_cast<uint32_t>(_sources.rows());
+
+    // Gonzalez farthest point clustering
+    std::vector<uint32_t> labels(N, 0);
+    std::vector<double> distances(N, std::numeric_limits<double>::infinity());
+
+    // Moves the sources that are closer to the new center into its cluster and returns the source that is farthest
+    // from all centers. Every chunk finds its first farthest source, so ties resolve to the lowest index like in a
+    // sequential scan
+    ThreadPool* pool      = ThreadPool::get();
+    const uint32_t chunks = pool->num_threads() + 1;
+    std::vector<uint32_t> local(chunks);
+    auto add_center = [&](const uint32_t& k, const uint32_t& index)
+    {
+        const Eigen::RowVector3d center = _sources.row(index);
+        std::fill(local.begin(), local.end(), N);
+        pool->parallel_for(0,
+                           N,
+                           chunks,
+                           [&](size_t first, size_t last, uint32_t chunk)
+                           {
+                               uint32_t farthest = static_cast<uint32_t>(first);
+                               for(size_t i = first; i < last; ++i)
+                               {
+                                   double d = (_sources.row(i) - center).squaredNorm();
+                                   if(d < distances[i])
+                                   {
+                                       distances[i] = d;
+                                       labels[i]    = k;
+                                   }
+                                   if(distances[i] > distances[farthest]) farthest = static_cast<uint32_t>(i);
+                               }
+                               local[chunk] = farthest;
+                           });
+
+        uint32_t farthest = local[0];
+        for(uint32_t chunk = 1; chunk < chunks; ++chunk)
+        {
+            if(local[chunk] != N && distances[local[chunk]] > distances[farthest]) farthest = local[chunk];
+        }
+        return farthest;
+    };
+
+    uint32_t farthest = add_center(0, 0);
+    for(uint32_t k = 1; k < _K; ++k)
+    {
+        // Every source coincides with a center, e.g. duplicated or quantized points. A further center would get an
+        // empty cluster whose bounding box has no middle
+        if(!(distances[farthest] > 0.0))
+        {
+            _K = k;
+            break;
+        }
+        farthest = add_center(k, farthest);
+    }
+
+    // Move every center to the middle of its cluster's bounding box to shrink the cluster radius
+    RowMatrix min_corner = RowMatrix::Constant(_K, 3, std::numeric_limits<double>::infinity());
+    RowMatrix max_corner = RowMatrix::Constant(_K, 3, -std::numeric_limits<double>::infinity());
+    for(uint32_t i = 0; i < N; ++i)
+    {
+        min_corner.row(labels[i]) = min_corner.row(labels[i]).cwiseMin(_sources.row(i));
+        max_corner.row(labels[i]) = max_corner.row(labels[i]).cwiseMax(_sources.row(i));
+    }
+    _centers = 0.5 * (min_corner + max_corner);
+
+    _rx = 0.0;
+    for(uint32_t i = 0; i < N; ++i) _rx = std::max(_rx, (_sources.row(i) - _centers.row(labels[i])).squaredNorm());
+    _rx = std::sqrt(_rx);
+
+    // Sort the sources by cluster so every cluster is contiguous in memory
+    _cluster_offsets.assign(_K + 1, 0);
+    for(uint32_t i = 0; i < N; ++i) ++_cluster_offsets[labels[i] + 1];
+    for(uint32_t k = 0; k < _K; ++k) _cluster_offsets[k + 1] += _cluster_offsets[k];
+
+    std::vector<uint32_t> fill(_cluster_offsets.begin(), _cluster_offsets.end() - 1);
+    _cluster_points.resize(N);
+    RowMatrix sorted(N, 3);
+    for(uint32_t i = 0; i < N; ++i)
+    {
+        uint32_t slot         = fill[labels[i]]++;
+        _cluster_points[slot] = i;
+        sorted.row(slot)      = _sources.row(i);
+    }
+    _sources = std::move(sorted);
+}
+
+void FastGaussTransform::computeMonomials(const double* d, double* monomials) const
+{
+    // Graded lexicographic order, every monomial is a previous monomial times one variable
+    uint32_t heads[3] = {0, 0, 0};
+    uint32_t t        = 1;
+    monomials[0]      = 1.0;
+    for(uint32_t k = 1; k < _p; ++k)
+    {
+        uint32_t tail = t;
+        for(uint32_t i = 0; i < 3; ++i)
+        {
+            uint32_t head = heads[i];
+            heads[i]      = t;
+            for(uint32_t j = head; j < tail; ++j, ++t) monomials[t] = d[i] * monomials[j];
+        }
+    }
+}
+
+RowMatrix FastGaussTransform::compute(const RowMatrix& weights, const RowMatrix& targets) const
+{
+    if(_sources.rows() == 0) return RowMatrix::Zero(targets.rows(), weights.cols());
+
+    if(_p == 0) return computeDirect(weights, targets);
+    return computeTaylor(weights, targets);
+}
+
+RowMatrix FastGaussTransform::computeTaylor(const RowMatrix& weights, const RowMatrix& targets) const
+{
+    const uint32_t W   = static_cast<uint32_t>(weights.cols());
+    const double inv_h = 1.0 / _h;
+
+    // Coefficients C_alpha^k = 2^|alpha| / alpha! * sum_i q_i * exp(-||dx_i||^2) * dx_i^alpha. Every cluster owns its
+    // coefficients, so the clusters are accumulated in parallel
+    ThreadPool* pool = ThreadPool::get();
+    std::vector<double> coefficients(static_cast<size_t>(_K) * _terms * W, 0.0);
+    pool->parallel_for(0,
+                       _K,
+                       [&](size_t first, size_t last)
+                       {
+                           std::vector<double> monomials(_terms);
+                           for(size_t k = first; k < last; ++k)
+                           {
+                               double* C = coefficients.data() + k * _terms * W;
+                               for(uint32_t s = _cluster_offsets[k]; s < _cluster_offsets[k + 1]; ++s)
+                               {
+                                   double d[3];
+                                   for(uint32_t l = 0; l < 3; ++l) d[l] = (_sources(s, l) - _centers(k, l)) * inv_h;
+                                   double e = std::exp(-(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]));
+                                   computeMonomials(d, monomials.data());
+
+                                   const uint32_t i = _cluster_points[s];
+                                   for(uint32_t a = 0; a < _terms; ++a)
+                                   {
+                                       double m = e * monomials[a];
+                                       for(uint32_t w = 0; w < W; ++w) C[a * W + w] += m * weights(i, w);
+                                   }
+                               }
+
+                               for(uint32_t a = 0; a < _terms; ++a)
+                               {
+                                   for(uint32_t w = 0; w < W; ++w) C[a * W + w] *= _constants[a];
+                               }
+                           }
+                       });
+
+    // G(y) = sum_k exp(-||dy||^2) * sum_alpha C_alpha^k * dy^alpha for all clusters inside the cutoff radius. Every
+    // target only writes its own row
+    const double ry2 = _ry * _ry;
+    RowMatrix result = RowMatrix::Zero(targets.rows(), W);
+    pool->parallel_for(0,
+                       targets.rows(),
+                       [&](size_t first, size_t last)
+                       {
+                           std::vector<double> monomials(_terms);
+                           for(size_t j = first; j < last; ++j)
+                           {
+                               for(uint32_t k = 0; k < _K; ++k)
+                               {
+                                   double d[3];
+                                   for(uint32_t l = 0; l < 3; ++l) d[l] = targets(j, l) - _centers(k, l);
+                                   double dist2 = d[0] * d[0] + d[1] * d[1] + d[2] * d[2];
+                                   // Also skips a NaN distance, whose comparisons are all false
+                                   if(!(dist2 <= ry2)) continue;
+
+                                   for(uint32_t l = 0; l < 3; ++l) d[l] *= inv_h;
+                                   double e = std::exp(-dist2 * inv_h * inv_h);
+                                   computeMonomials(d, monomials.data());
+
+                                   const double* C = coefficients.data() + static_cast<size_t>(k) * _terms * W;
+                                   for(uint32_t a = 0; a < _terms; ++a)
+                                   {
+                                       double m = e * monomials[a];
+                                       for(uint32_t w = 0; w < W; ++w) result(j, w) += m * C[a * W + w];
+                                   }
+                               }
+                           }
+                       });
+
+    return result;
+}
+
+RowMatrix FastGaussTransform::computeDirect(const RowMatrix& weights, const RowMatrix& targets) const
+{
+    const uint32_t W    = static_cast<uint32_t>(weights.cols());
+    const double inv_h2 = 1.0 / (_h * _h);
+    const double ry2    = _ry * _ry;
+    RowMatrix result    = RowMatrix::Zero(targets.rows(), W);
+    ThreadPool::get()->parallel_for(
+        0,
+        targets.rows(),
+        [&](size_t first, size_t last)
+        {
+            for(size_t j = first; j < last; ++j)
+            {
+                Eigen::Vector3d y = targets.row(j);
+                for(uint32_t k = 0; k < _K; ++k)
+                {
+                    if(!((y.transpose() - _centers.row(k)).squaredNorm() <= ry2)) continue;
+
+                    for(uint32_t s = _cluster_offsets[k]; s < _cluster_offsets[k + 1]; ++s)
+                    {
+                        double e         = std::exp(-(y.transpose() - _sources.row(s)).squaredNorm() * inv_h2);
+                        const uint32_t i = _cluster_points[s];
+                        for(uint32_t w = 0; w < W; ++w) result(j, w) += e * weights(i, w);
+                    }
+                }
+            }
+        });
+
+    return result;
+}
+}    // namespace atcg
\ No newline at end of file
@@ -0,0 +1,296 @@
+#include <Registration/FeatureRegistration.h>
+
+#include <Core/ThreadPool.h>
+
+#include <Eigen/SVD>
+#include <nanoflann.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <random>
+
+namespace atcg
+{
+namespace detail
+{
+constexpr uint32_t FPFH_BINS = FPFH_SIZE / 3;
+
+// Hypotheses whose sample edges differ more than this factor between the clouds are rejected before scoring
+constexpr double RANSAC_EDGE_SIMILARITY = 0.9;
+
+// Relative accuracy of the approximate descriptor search
+constexpr float FPFH_SEARCH_EPSILON = 0.5f;
+
+using FeatureTree = nanoflann::KDTreeEigenMatrixAdaptor<RowMatrixT<float>, -1, nanoflann::metric_L2_Simple>;
+
+// Closed form of min sum ||R * y_i + t - x_i||^2 (Arun et al. 1987)
+template<class Indices>
+bool fit_rigid(const RowMatrixT<double>& X,
+               const RowMatrixT<double>& Y,
+               const std::vector<uint32_t>& matches,
+               const Indices& indices,
+               Eigen::Matrix3d& R,
+               Eigen::Vector3d& t)
+{
+    if(indices.size() < 3) return false;
+
+    Eigen::Vector3d uX = Eigen::Vector3d::Zero(), uY = Eigen::Vector3d::Zero();
+    for(uint32_t m: indices)
+    {
+        uX += X.row(matches[m]).transpose();
+        uY += Y.row(m).transpose();
+    }
+    uX /= static_cast<double>(indices.size());
+    uY /= static_cast<double>(indices.size());
+
+    Eigen::Matrix3d A = Eigen::Matrix3d::Zero();
+    for(uint32_t m: indices) A += (X.row(matches[m]).transpose() - uX) * (Y.row(m).transpose() - uY).transpose();
+
+    Eigen::JacobiSVD<Eigen::Matrix3d, Eigen::ComputeFullU | Eigen::ComputeFullV> svd(A);
+    Eigen::Matrix3d U = svd.matrixU();
+    Eigen::Matrix3d V = svd.matrixV();
+
+    Eigen::Matrix3d C = Eigen::Matrix3d::Identity();
+    C(2, 2)           = (U * V.transpose()).determinant();
+
+    R = U * C * V.transpose();
+    t = uX - R * uY;
+    return R.allFinite() && t.allFinite();
+}
+}    // namespace detail
+
+RowMatrixT<float>
+compute_fpfh(const RowMatrixT<double>& points, const RowMatrixT<double>& normals, const uint32_t& neighbors)
+{
+    const size_t N                      = points.rows();
+    const size_t K                      = std::min<size_t>(neighbors, N > 0 ? N - 1 : 0);
+    const std::vector<Eigen::Index> knn = nearest_neighbors(points, neighbors);
+    const uint32_t B                    = detail::FPFH_BINS;
+
+    auto bin = [B](const double& value, const double& min, const double& max)
+    {
+        int32_t b = static_cast<int32_t>(std::floor(B * (value - min) / (max - min)));
+        return static_cast<uint32_t>(std::clamp(b, 0, static_cast<int32_t>(B) - 1));
+    };
+
+    // Simplified point feature histograms of the pairs of each point with its neighbors. The Darboux frame is
+    // attached to the point whose normal is closer to the connecting line (Rusu et al. 2009)
+    RowMatrixT<float> spfh = RowMatrixT<float>::Zero(N, FPFH_SIZE);
+    ThreadPool::get()->parallel_for(
+        0,
+        N,
+        [&](size_t first, size_t last)
+        {
+            for(size_t n = first; n < last; ++n)
+            {
+                for(size_t k = 0; k < K; ++k)
+                {
+                    const Eigen::Index j = knn[n * K + k];
+
+                    Eigen::Vector3d d = (points.row(j) - points.row(n)).transpose();
+                    double length     = d.norm();
+                    if(length == 0.0) continue;
+                    d /= length;
+
+                    Eigen::Vector3d n1 = normals.row(n).transpose();
+                    Eigen::Vector3d n2 = normals.row(j).transpose();
+                    double phi         = n1.dot(d);
+                    if(std::abs(phi) < std::abs(n2.dot(d)))
+                    {
+                        std::swap(n1, n2);
+                        d   = -d;
+                        phi = n1.dot(d);
+                    }
+
+                    Eigen::Vector3d v = d.cross(n1);
+                    double v_norm     = v.norm();
+                    if(v_norm == 0.0) continue;
+                    v /= v_norm;
+                    Eigen::Vector3d w = n1.cross(v);
+
+                    double alpha = v.dot(n2);
+                    double theta = std::atan2(w.dot(n2), n1.dot(n2));
+
+                    spfh(n, bin(theta, -M_PI, M_PI)) += 1.0f;
+                    spfh(n, B + bin(alpha, -1.0, 1.0)) += 1.0f;
+                    spfh(n, 2 * B + bin(phi, -1.0, 1.0)) += 1.0f;
+                }
+            }
+        });
+
+    // FPFH(p) = SPFH(p) + 1/K * sum_k SPFH(p_k) / ||p - p_k||, every sub-histogram normalized to 100
+    RowMatrixT<float> fpfh(N, FPFH_SIZE);
+    ThreadPool::get()->parallel_for(
+        0,
+        N,
+        [&](size_t first, size_t last)
+        {
+            for(size_t n = first; n < last; ++n)
+            {
+                Eigen::Matrix<double, 1, FPFH_SIZE> histogram = spfh.row(n).cast<double>();
+                for(size_t k = 0; k < K; ++k)
+                {
+                    const Eigen::Index j = knn[n * K + k];
+                    double distance      = (points.row(j) - points.row(n)).norm();
+                    if(distance == 0.0) continue;
+                    histogram += spfh.row(j).cast<double>() / (static_cast<double>(K) * distance);
+                }
+
+                for(uint32_t f = 0; f < 3; ++f)
+                {
+                    double sum = histogram.segment(f * B, B).sum();
+                    if(sum > 0.0) histogram.segment(f * B, B) *= 100.0 / sum;
+                }
+                fpfh.row(n) = histogram.cast<float>();
+            }
+        });
+    return fpfh;
+}
+
+FeatureRegistration::FeatureRegistration(const std::shared_ptr<PointCloud>& source,
+                                         const std::shared_ptr<PointCloud>& target,
+                                         const uint32_t& neighbors,
+                                         const double& max_distance)
+    : source_points(source->sharedMatrix<double>()),
+      target_points(target->sharedMatrix<double>()),
+      X(*source_points),
+      Y(*target_points),
+      max_distance(max_distance)
+{
+    RowMatrixT<float> source_features = compute_fpfh(X, estimate_normals(X, neighbors), neighbors);
+    RowMatrixT<float> target_features = compute_fpfh(Y, estimate_normals(Y, neighbors), neighbors);
+
+    const size_t M = Y.rows();
+    if(this->max_distance <= 0.0 && M > 1)
+    {
+        std::vector<Eigen::Index> nearest = nearest_neighbors(Y, 1);
+        double sum                        = 0.0;
+        for(size_t m = 0; m < M; ++m) sum += (Y.row(nearest[m]) - Y.row(m)).norm();
+        this->max_distance = 3.0 * sum / static_cast<double>(M);
+    }
+
+    matches.resize(M);
+    if(X.rows() == 0) return;
+
+    detail::FeatureTree tree(FPFH_SIZE, std::cref(source_features));
+    ThreadPool::get()->parallel_for(
+        0,
+        M,
+        [&](size_t first, size_t last)
+        {
+            for(size_t m = first; m < last; ++m)
+            {
+                Eigen::Index index = 0;
+                float distance     = 0.0f;
+                nanoflann::KNNResultSet<float, Eigen::Index> result(1);
+                result.init(&index, &distance);
+                tree.index_->findNeighbors(result,
+                                           target_features.row(m).data(),
+                                           nanoflann::SearchParameters(detail::FPFH_SEARCH_EPSILON));
+                matches[m] = static_cast<uint32_t>(index);
+            }
+        });
+}
+
+void FeatureRegistration::solve(const uint32_t& iterations, const uint32_t& seed)
+{
+    const uint32_t M = static_cast<uint32_t>(Y.rows());
+    if(M < 3 || X.rows() < 3) return;
+
+    const double max_squared = max_distance * max_distance;
+    auto inlier              = [&](const Eigen::Matrix3d& R, const Eigen::Vector3d& t, const uint32_t& m)
+    { return (R * Y.row(m).transpose() + t - X.row(matches[m]).transpose()).squaredNorm() < max_squared; };
+
+    struct Hypothesis
+    {
+        uint32_t inliers  = 0;
+        Eigen::Matrix3d R = Eigen::Matrix3d::Identity();
+        Eigen::Vector3d t = Eigen::Vector3d::Zero();
+    };
+
+    ThreadPool* pool      = ThreadPool::get();
+    const uint32_t chunks = pool->num_threads() + 1;
+    std::vector<Hypothesis> best(chunks);
+    pool->parallel_for(
+        0,
+        iterations,
+        chunks,
+        [&](size_t first, size_t last, uint32_t chunk)
+        {
+            std::mt19937 generator(seed + chunk);
+            std::uniform_int_distribution<uint32_t> distribution(0, M - 1);
+            Hypothesis& result = best[chunk];
+
+            for(size_t i = first; i < last; ++i)
+            {
+                std::array<uint32_t, 3> sample;
+                for(uint32_t& s: sample) s = distribution(generator);
+                if(sample[0] == sample[1] || sample[0] == sample[2] || sample[1] == sample[2]) continue;
+
+                // A rigid transformation preserves the edge lengths of the sample
+                bool valid = true;
+                for(uint32_t a = 0; a < 3 && valid; ++a)
+                {
+                    uint32_t b = (a + 1) % 3;
+                    double dY  = (Y.row(sample[a]) - Y.row(sample[b])).norm();
+                    double dX  = (X.row(matches[sample[a]]) - X.row(matches[sample[b]])).norm();
+                    valid      = std::min(dX, dY) >= detail::RANSAC_EDGE_SIMILARITY * std::max(dX, dY);
+                }
+                if(!valid) continue;
+
+                Eigen::Matrix3d R;
+                Eigen::Vector3d t;
+                if(!detail::fit_rigid(X, Y, matches, sample, R, t)) continue;
+                if(!inlier(R, t, sample[0]) || !inlier(R, t, sample[1]) || !inlier(R, t, sample[2])) continue;
+
+                uint32_t count = 0;
+                for(uint32_t m = 0; m < M && count + (M - m) > result.inliers; ++m)
+                {
+                    if(inlier(R, t, m)) ++count;
+                }
+                if(count > result.inliers) result = {count, R, t};
+            }
+        });
+
+    Hypothesis result = *std::max_element(best.begin(),
+                                          best.end(),
+                                          [](const Hypothesis& a, const Hypothesis& b) { return a.inliers < b.inliers; });
+    if(result.inliers < 3) return;
+
+    auto inliers_of = [&](const Eigen::Matrix3d& R, const Eigen::Vector3d& t)
+    {
+        std::vector<uint32_t> inliers;
+        for(uint32_t m = 0; m < M; ++m)
+        {
+            if(inlier(R, t, m)) inliers.push_back(m);
+        }
+        return inliers;
+    };
+
+    // Refit on the inliers of the best model. A refit only replaces it if it has more inliers
+    R                             = result.R;
+    t                             = result.t;
+    std::vector<uint32_t> inliers = inliers_of(R, t);
+    for(uint32_t round = 0; round < 5; ++round)
+    {
+        Eigen::Matrix3d R_;
+        Eigen::Vector3d t_;
+        if(!detail::fit_rigid(X, Y, matches, inliers, R_, t_)) break;
+
+        std::vector<uint32_t> refined = inliers_of(R_, t_);
+        if(refined.size() <= inliers.size()) break;
+        R       = R_;
+        t       = t_;
+        inliers = std::move(refined);
+    }
+
+    inlier_ratio = static_cast<double>(inliers.size()) / static_cast<double>(M);
+}
+
+void FeatureRegistration::applyTransform(const std::shared_ptr<PointCloud>& cloud)
+{
+    auto points = cloud->points();
+    points      = ((points.cast<double>() * R.transpose()).rowwise() + t.transpose()).cast<float>();
+}
+}    // namespace atcg
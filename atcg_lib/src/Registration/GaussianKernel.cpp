@@ -0,0 +1,582 @@
+#include <Registration/GaussianKernel.h>
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(_M_X64)
+    #define ATCG_SIMD_X86 1
+    #include <immintrin.h>
+    #ifdef _MSC_VER
+        #include <intrin.h>
+    #endif
+#else
+    #define ATCG_SIMD_X86 0
+#endif
+
+// GCC and Clang only emit instructions of a specific instruction set inside functions that are marked for it. MSVC
+// allows all intrinsics everywhere
+#if defined(__GNUC__) || defined(__clang__)
+    #define ATCG_SIMD_TARGET(isa) __attribute__((target(isa)))
+#else
+    #define ATCG_SIMD_TARGET(isa)
+#endif
+
+namespace atcg
+{
+namespace detail
+{
+// Cephes exp: exp(x) = 2^n * exp(r) with x = n * ln(2) + r and a Pade approximation of exp(r)
+constexpr double EXP_MIN   = -708.39641853226408;    // ln(2^-1022), smaller arguments are flushed to zero
+constexpr double EXP_LOG2E = 1.4426950408889634073599;
+constexpr double EXP_C1    = 6.93145751953125E-1;
+constexpr double EXP_C2    = 1.42860682030941723212E-6;
+constexpr double EXP_P0    = 1.26177193074810590878E-4;
+constexpr double EXP_P1    = 3.02994407707441961300E-2;
+constexpr double EXP_P2    = 9.99999999999999999910E-1;
+constexpr double EXP_Q0    = 3.00198505138664455042E-6;
+constexpr double EXP_Q1    = 2.52448340349684104192E-3;
+constexpr double EXP_Q2    = 2.27265548208155028766E-1;
+constexpr double EXP_Q3    = 2.00000000000000000009E0;
+
+// Cephes expf: exp(r) is approximated by a polynomial of degree 7
+constexpr float EXPF_MIN   = -87.3365447505531f;    // ln(2^-126)
+constexpr float EXPF_LOG2E = 1.44269504088896341f;
+constexpr float EXPF_C1    = 0.693359375f;
+constexpr float EXPF_C2    = -2.12194440e-4f;
+constexpr float EXPF_P0    = 1.9875691500E-4f;
+constexpr float EXPF_P1    = 1.3981999507E-3f;
+constexpr float EXPF_P2    = 8.3334519073E-3f;
+constexpr float EXPF_P3    = 4.1665795894E-2f;
+constexpr float EXPF_P4    = 1.6666665459E-1f;
+constexpr float EXPF_P5    = 5.0000001201E-1f;
+
+double gaussian_kernel_scalar(const double* x,
+                              const double* tx,
+                              const double* ty,
+                              const double* tz,
+                              const size_t& first,
+                              const size_t& count,
+                              const double& scale,
+                              double* result)
+{
+    double sum = 0.0;
+    for(size_t m = first; m < count; ++m)
+    {
+        double dx = x[0] - tx[m];
+        double dy = x[1] - ty[m];
+        double dz = x[2] - tz[m];
+        result[m] = std::exp(scale * (dx * dx + dy * dy + dz * dz));
+        sum += result[m];
+    }
+    return sum;
+}
+
+double gaussian_kernel_scalar(const float* x,
+                              const float* tx,
+                              const float* ty,
+                              const float* tz,
+                              const size_t& first,
+                              const size_t& count,
+                              const float& scale,
+                              float* result)
+{
+    double sum = 0.0;
+    for(size_t m = first; m < count; ++m)
+    {
+        float dx  = x[0] - tx[m];
+        float dy  = x[1] - ty[m];
+        float dz  = x[2] - tz[m];
+        result[m] = std::exp(scale * (dx * dx + dy * dy + dz * dz));
+        sum += result[m];
+    }
+    return sum;
+}
+
+#if ATCG_SIMD_X86
+ATCG_SIMD_TARGET("sse2") __m128d exp_sse2(__m128d x)
+{
+    __m128d valid = _mm_cmpge_pd(x, _mm_set1_pd(EXP_MIN));
+    x             = _mm_max_pd(x, _mm_set1_pd(EXP_MIN));
+
+    // Round to nearest with the default rounding mode
+    __m128i n  = _mm_cvtpd_epi32(_mm_mul_pd(x, _mm_set1_pd(EXP_LOG2E)));
+    __m128d fx = _mm_cvtepi32_pd(n);
+    x          = _mm_sub_pd(x, _mm_mul_pd(fx, _mm_set1_pd(EXP_C1)));
+    x          = _mm_sub_pd(x, _mm_mul_pd(fx, _mm_set1_pd(EXP_C2)));
+
+    __m128d xx = _mm_mul_pd(x, x);
+    __m128d p  = _mm_add_pd(_mm_mul_pd(_mm_set1_pd(EXP_P0), xx), _mm_set1_pd(EXP_P1));
+    p          = _mm_mul_pd(x, _mm_add_pd(_mm_mul_pd(p, xx), _mm_set1_pd(EXP_P2)));
+    __m128d q  = _mm_add_pd(_mm_mul_pd(_mm_set1_pd(EXP_Q0), xx), _mm_set1_pd(EXP_Q1));
+    q          = _mm_add_pd(_mm_mul_pd(q, xx), _mm_set1_pd(EXP_Q2));
+    q          = _mm_add_pd(_mm_mul_pd(q, xx), _mm_set1_pd(EXP_Q3));
+    __m128d e  = _mm_add_pd(_mm_set1_pd(1.0), _mm_mul_pd(_mm_set1_pd(2.0), _mm_div_pd(p, _mm_sub_pd(q, p))));
+
+    // 2^n from the exponent bits. Every 64 bit lane holds n twice, the upper copy is shifted out
+    __m128i exponent = _mm_shuffle_epi32(_mm_add_epi32(n, _mm_set1_epi32(1023)), _MM_SHUFFLE(1, 1, 0, 0));
+    __m128d scale    = _mm_castsi128_pd(_mm_slli_epi64(exponent, 52));
+
+    return _mm_and_pd(_mm_mul_pd(e, scale), valid);
+}
+
+ATCG_SIMD_TARGET("sse2")
+double gaussian_kernel_sse2(const double* x,
+                            const double* tx,
+                            const double* ty,
+                            const double* tz,
+                            const size_t& count,
+                            const double& scale,
+                            double* result)
+{
+    const __m128d px     = _mm_set1_pd(x[0]);
+    const __m128d py     = _mm_set1_pd(x[1]);
+    const __m128d pz     = _mm_set1_pd(x[2]);
+    const __m128d vscale = _mm_set1_pd(scale);
+    __m128d sum          = _mm_setzero_pd();
+
+    size_t m = 0;
+    for(; m + 2 <= count; m += 2)
+    {
+        __m128d dx = _mm_sub_pd(px, _mm_loadu_pd(tx + m));
+        __m128d dy = _mm_sub_pd(py, _mm_loadu_pd(ty + m));
+        __m128d dz = _mm_sub_pd(pz, _mm_loadu_pd(tz + m));
+        __m128d d2 = _mm_add_pd(_mm_add_pd(_mm_mul_pd(dx, dx), _mm_mul_pd(dy, dy)), _mm_mul_pd(dz, dz));
+        __m128d e  = exp_sse2(_mm_mul_pd(vscale, d2));
+        _mm_storeu_pd(result + m, e);
+        sum = _mm_add_pd(sum, e);
+    }
+
+    double lanes[2];
+    _mm_storeu_pd(lanes, sum);
+    return lanes[0] + lanes[1] + gaussian_kernel_scalar(x, tx, ty, tz, m, count, scale, result);
+}
+
+ATCG_SIMD_TARGET("avx2,fma") __m256d exp_avx2(__m256d x)
+{
+    __m256d valid = _mm256_cmp_pd(x, _mm256_set1_pd(EXP_MIN), _CMP_GE_OQ);
+    x             = _mm256_max_pd(x, _mm256_set1_pd(EXP_MIN));
+
+    __m256d fx = _mm256_round_pd(_mm256_mul_pd(x, _mm256_set1_pd(EXP_LOG2E)),
+                                 _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    x          = _mm256_fnmadd_pd(fx, _mm256_set1_pd(EXP_C1), x);
+    x          = _mm256_fnmadd_pd(fx, _mm256_set1_pd(EXP_C2), x);
+
+    __m256d xx = _mm256_mul_pd(x, x);
+    __m256d p  = _mm256_fmadd_pd(_mm256_set1_pd(EXP_P0), xx, _mm256_set1_pd(EXP_P1));
+    p          = _mm256_mul_pd(x, _mm256_fmadd_pd(p, xx, _mm256_set1_pd(EXP_P2)));
+    __m256d q  = _mm256_fmadd_pd(_mm256_set1_pd(EXP_Q0), xx, _mm256_set1_pd(EXP_Q1));
+    q          = _mm256_fmadd_pd(q, xx, _mm256_set1_pd(EXP_Q2));
+    q          = _mm256_fmadd_pd(q, xx, _mm256_set1_pd(EXP_Q3));
+    __m256d e  = _mm256_fmadd_pd(_mm256_set1_pd(2.0), _mm256_div_pd(p, _mm256_sub_pd(q, p)), _mm256_set1_pd(1.0));
+
+    __m256i exponent = _mm256_add_epi64(_mm256_cvtepi32_epi64(_mm256_cvtpd_epi32(fx)), _mm256_set1_epi64x(1023));
+    __m256d scale    = _mm256_castsi256_pd(_mm256_slli_epi64(exponent, 52));
+
+    return _mm256_and_pd(_mm256_mul_pd(e, scale), valid);
+}
+
+ATCG_SIMD_TARGET("avx2,fma")
+double gaussian_kernel_avx2(const double* x,
+                            const double* tx,
+                            const double* ty,
+                            const double* tz,
+                            const size_t& count,
+                            const double& scale,
+                            double* result)
+{
+    const __m256d px     = _mm256_set1_pd(x[0]);
+    const __m256d py     = _mm256_set1_pd(x[1]);
+    const __m256d pz     = _mm256_set1_pd(x[2]);
+    const __m256d vscale = _mm256_set1_pd(scale);
+    __m256d sum          = _mm256_setzero_pd();
+
+    size_t m = 0;
+    for(; m + 4 <= count; m += 4)
+    {
+        __m256d dx = _mm256_sub_pd(px, _mm256_loadu_pd(tx + m));
+        __m256d dy = _mm256_sub_pd(py, _mm256_loadu_pd(ty + m));
+        __m256d dz = _mm256_sub_pd(pz, _mm256_loadu_pd(tz + m));
+        __m256d d2 = _mm256_fmadd_pd(dz, dz, _mm256_fmadd_pd(dy, dy, _mm256_mul_pd(dx, dx)));
+        __m256d e  = exp_avx2(_mm256_mul_pd(vscale, d2));
+        _mm256_storeu_pd(result + m, e);
+        sum = _mm256_add_pd(sum, e);
+    }
+
+    double lanes[4];
+    _mm256_storeu_pd(lanes, sum);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + gaussian_kernel_scalar(x, tx, ty, tz, m, count, scale, result);
+}
+
+// The unmasked max, roundscale and scalef intrinsics of GCC 12 pass an undefined source vector, which triggers
+// -Wmaybe-uninitialized. The masked forms with all lanes set compute the same
+ATCG_SIMD_TARGET("avx512f") __m512d exp_avx512(__m512d x)
+{
+    __mmask8 valid = _mm512_cmp_pd_mask(x, _mm512_set1_pd(EXP_MIN), _CMP_GE_OQ);
+    x              = _mm512_mask_max_pd(x, 0xFF, x, _mm512_set1_pd(EXP_MIN));
+
+    __m512d y  = _mm512_mul_pd(x, _mm512_set1_pd(EXP_LOG2E));
+    __m512d fx = _mm512_mask_roundscale_pd(y, 0xFF, y, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    x          = _mm512_fnmadd_pd(fx, _mm512_set1_pd(EXP_C1), x);
+    x          = _mm512_fnmadd_pd(fx, _mm512_set1_pd(EXP_C2), x);
+
+    __m512d xx = _mm512_mul_pd(x, x);
+    __m512d p  = _mm512_fmadd_pd(_mm512_set1_pd(EXP_P0), xx, _mm512_set1_pd(EXP_P1));
+    p          = _mm512_mul_pd(x, _mm512_fmadd_pd(p, xx, _mm512_set1_pd(EXP_P2)));
+    __m512d q  = _mm512_fmadd_pd(_mm512_set1_pd(EXP_Q0), xx, _mm512_set1_pd(EXP_Q1));
+    q          = _mm512_fmadd_pd(q, xx, _mm512_set1_pd(EXP_Q2));
+    q          = _mm512_fmadd_pd(q, xx, _mm512_set1_pd(EXP_Q3));
+    __m512d e  = _mm512_fmadd_pd(_mm512_set1_pd(2.0), _mm512_div_pd(p, _mm512_sub_pd(q, p)), _mm512_set1_pd(1.0));
+
+    return _mm512_maskz_scalef_pd(valid, e, fx);
+}
+
+// The casts to the lower half and the horizontal sum are built on the unmasked extract as well
+template<int Half>
+ATCG_SIMD_TARGET("avx512f") __m256d half_avx512(__m512d x)
+{
+    return _mm512_mask_extractf64x4_pd(_mm256_setzero_pd(), 0xF, x, Half);
+}
+
+ATCG_SIMD_TARGET("avx512f") double reduce_add_avx512(__m512d x)
+{
+    __m256d sum  = _mm256_add_pd(half_avx512<0>(x), half_avx512<1>(x));
+    __m128d pair = _mm_add_pd(_mm256_castpd256_pd128(sum), _mm256_extractf128_pd(sum, 1));
+    return _mm_cvtsd_f64(_mm_add_sd(pair, _mm_unpackhi_pd(pair, pair)));
+}
+
+ATCG_SIMD_TARGET("avx512f")
+double gaussian_kernel_avx512(const double* x,
+                              const double* tx,
+                              const double* ty,
+                              const double* tz,
+                              const size_t& count,
+                              const double& scale,
+                              double* result)
+{
+    const __m512d px     = _mm512_set1_pd(x[0]);
+    const __m512d py     = _mm512_set1_pd(x[1]);
+    const __m512d pz     = _mm512_set1_pd(x[2]);
+    const __m512d vscale = _mm512_set1_pd(scale);
+    __m512d sum          = _mm512_setzero_pd();
+
+    for(size_t m = 0; m < count; m += 8)
+    {
+        // Masked loads and stores handle the tail of the tile
+        __mmask8 lanes = count - m >= 8 ? 0xFF : static_cast<__mmask8>((1u << (count - m)) - 1u);
+        __m512d dx     = _mm512_sub_pd(px, _mm512_maskz_loadu_pd(lanes, tx + m));
+        __m512d dy     = _mm512_sub_pd(py, _mm512_maskz_loadu_pd(lanes, ty + m));
+        __m512d dz     = _mm512_sub_pd(pz, _mm512_maskz_loadu_pd(lanes, tz + m));
+        __m512d d2     = _mm512_fmadd_pd(dz, dz, _mm512_fmadd_pd(dy, dy, _mm512_mul_pd(dx, dx)));
+        __m512d e      = _mm512_maskz_mov_pd(lanes, exp_avx512(_mm512_mul_pd(vscale, d2)));
+        _mm512_mask_storeu_pd(result + m, lanes, e);
+        sum = _mm512_add_pd(sum, e);
+    }
+
+    return reduce_add_avx512(sum);
+}
+
+ATCG_SIMD_TARGET("sse2") __m128 exp_sse2(__m128 x)
+{
+    __m128 valid = _mm_cmpge_ps(x, _mm_set1_ps(EXPF_MIN));
+    x            = _mm_max_ps(x, _mm_set1_ps(EXPF_MIN));
+
+    __m128i n = _mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(EXPF_LOG2E)));
+    __m128 fx = _mm_cvtepi32_ps(n);
+    x         = _mm_sub_ps(x, _mm_mul_ps(fx, _mm_set1_ps(EXPF_C1)));
+    x         = _mm_sub_ps(x, _mm_mul_ps(fx, _mm_set1_ps(EXPF_C2)));
+
+    __m128 xx = _mm_mul_ps(x, x);
+    __m128 y  = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(EXPF_P0), x), _mm_set1_ps(EXPF_P1));
+    y         = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(EXPF_P2));
+    y         = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(EXPF_P3));
+    y         = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(EXPF_P4));
+    y         = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(EXPF_P5));
+    y         = _mm_add_ps(_mm_add_ps(_mm_mul_ps(y, xx), x), _mm_set1_ps(1.0f));
+
+    __m128 scale = _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(n, _mm_set1_epi32(127)), 23));
+
+    return _mm_and_ps(_mm_mul_ps(y, scale), valid);
+}
+
+ATCG_SIMD_TARGET("sse2")
+double gaussian_kernel_sse2(const float* x,
+                            const float* tx,
+                            const float* ty,
+                            const float* tz,
+                            const size_t& count,
+                            const float& scale,
+                            float* result)
+{
+    const __m128 px     = _mm_set1_ps(x[0]);
+    const __m128 py     = _mm_set1_ps(x[1]);
+    const __m128 pz     = _mm_set1_ps(x[2]);
+    const __m128 vscale = _mm_set1_ps(scale);
+    __m128d sum         = _mm_setzero_pd();
+
+    size_t m = 0;
+    for(; m + 4 <= count; m += 4)
+    {
+        __m128 dx = _mm_sub_ps(px, _mm_loadu_ps(tx + m));
+        __m128 dy = _mm_sub_ps(py, _mm_loadu_ps(ty + m));
+        __m128 dz = _mm_sub_ps(pz, _mm_loadu_ps(tz + m));
+        __m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+        __m128 e  = exp_sse2(_mm_mul_ps(vscale, d2));
+        _mm_storeu_ps(result + m, e);
+        sum = _mm_add_pd(sum, _mm_cvtps_pd(e));
+        sum = _mm_add_pd(sum, _mm_cvtps_pd(_mm_movehl_ps(e, e)));
+    }
+
+    double lanes[2];
+    _mm_storeu_pd(lanes, sum);
+    return lanes[0] + lanes[1] + gaussian_kernel_scalar(x, tx, ty, tz, m, count, scale, result);
+}
+
+ATCG_SIMD_TARGET("avx2,fma") __m256 exp_avx2(__m256 x)
+{
+    __m256 valid = _mm256_cmp_ps(x, _mm256_set1_ps(EXPF_MIN), _CMP_GE_OQ);
+    x            = _mm256_max_ps(x, _mm256_set1_ps(EXPF_MIN));
+
+    __m256 fx = _mm256_round_ps(_mm256_mul_ps(x, _mm256_set1_ps(EXPF_LOG2E)),
+                                _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    x         = _mm256_fnmadd_ps(fx, _mm256_set1_ps(EXPF_C1), x);
+    x         = _mm256_fnmadd_ps(fx, _mm256_set1_ps(EXPF_C2), x);
+
+    __m256 xx = _mm256_mul_ps(x, x);
+    __m256 y  = _mm256_fmadd_ps(_mm256_set1_ps(EXPF_P0), x, _mm256_set1_ps(EXPF_P1));
+    y         = _mm256_fmadd_ps(y, x, _mm256_set1_ps(EXPF_P2));
+    y         = _mm256_fmadd_ps(y, x, _mm256_set1_ps(EXPF_P3));
+    y         = _mm256_fmadd_ps(y, x, _mm256_set1_ps(EXPF_P4));
+    y         = _mm256_fmadd_ps(y, x, _mm256_set1_ps(EXPF_P5));
+    y         = _mm256_add_ps(_mm256_fmadd_ps(y, xx, x), _mm256_set1_ps(1.0f));
+
+    __m256i exponent = _mm256_add_epi32(_mm256_cvtps_epi32(fx), _mm256_set1_epi32(127));
+    __m256 scale     = _mm256_castsi256_ps(_mm256_slli_epi32(exponent, 23));
+
+    return _mm256_and_ps(_mm256_mul_ps(y, scale), valid);
+}
+
+ATCG_SIMD_TARGET("avx2,fma")
+double gaussian_kernel_avx2(const float* x,
+                            const float* tx,
+                            const float* ty,
+                            const float* tz,
+                            const size_t& count,
+                            const float& scale,
+                            float* result)
+{
+    const __m256 px     = _mm256_set1_ps(x[0]);
+    const __m256 py     = _mm256_set1_ps(x[1]);
+    const __m256 pz     = _mm256_set1_ps(x[2]);
+    const __m256 vscale = _mm256_set1_ps(scale);
+    __m256d sum         = _mm256_setzero_pd();
+
+    size_t m = 0;
+    for(; m + 8 <= count; m += 8)
+    {
+        __m256 dx = _mm256_sub_ps(px, _mm256_loadu_ps(tx + m));
+        __m256 dy = _mm256_sub_ps(py, _mm256_loadu_ps(ty + m));
+        __m256 dz = _mm256_sub_ps(pz, _mm256_loadu_ps(tz + m));
+        __m256 d2 = _mm256_fmadd_ps(dz, dz, _mm256_fmadd_ps(dy, dy, _mm256_mul_ps(dx, dx)));
+        __m256 e  = exp_avx2(_mm256_mul_ps(vscale, d2));
+        _mm256_storeu_ps(result + m, e);
+        sum = _mm256_add_pd(sum, _mm256_cvtps_pd(_mm256_castps256_ps128(e)));
+        sum = _mm256_add_pd(sum, _mm256_cvtps_pd(_mm256_extractf128_ps(e, 1)));
+    }
+
+    double lanes[4];
+    _mm256_storeu_pd(lanes, sum);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + gaussian_kernel_scalar(x, tx, ty, tz, m, count, scale, result);
+}
+
+ATCG_SIMD_TARGET("avx512f") __m512 exp_avx512(__m512 x)
+{
+    __mmask16 valid = _mm512_cmp_ps_mask(x, _mm512_set1_ps(EXPF_MIN), _CMP_GE_OQ);
+    x               = _mm512_mask_max_ps(x, 0xFFFF, x, _mm512_set1_ps(EXPF_MIN));
+
+    __m512 fx = _mm512_mul_ps(x, _mm512_set1_ps(EXPF_LOG2E));
+    fx        = _mm512_mask_roundscale_ps(fx, 0xFFFF, fx, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    x         = _mm512_fnmadd_ps(fx, _mm512_set1_ps(EXPF_C1), x);
+    x         = _mm512_fnmadd_ps(fx, _mm512_set1_ps(EXPF_C2), x);
+
+    __m512 xx = _mm512_mul_ps(x, x);
+    __m512 y  = _mm512_fmadd_ps(_mm512_set1_ps(EXPF_P0), x, _mm512_set1_ps(EXPF_P1));
+    y         = _mm512_fmadd_ps(y, x, _mm512_set1_ps(EXPF_P2));
+    y         = _mm512_fmadd_ps(y, x, _mm512_set1_ps(EXPF_P3));
+    y         = _mm512_fmadd_ps(y, x, _mm512_set1_ps(EXPF_P4));
+    y         = _mm512_fmadd_ps(y, x, _mm512_set1_ps(EXPF_P5));
+    y         = _mm512_add_ps(_mm512_fmadd_ps(y, xx, x), _mm512_set1_ps(1.0f));
+
+    return _mm512_maskz_scalef_ps(valid, y, fx);
+}
+
+ATCG_SIMD_TARGET("avx512f")
+double gaussian_kernel_avx512(const float* x,
+                              const float* tx,
+                              const float* ty,
+                              const float* tz,
+                              const size_t& count,
+                              const float& scale,
+                              float* result)
+{
+    const __m512 px     = _mm512_set1_ps(x[0]);
+    const __m512 py     = _mm512_set1_ps(x[1]);
+    const __m512 pz     = _mm512_set1_ps(x[2]);
+    const __m512 vscale = _mm512_set1_ps(scale);
+    __m512d sum         = _mm512_setzero_pd();
+
+    for(size_t m = 0; m < count; m += 16)
+    {
+        __mmask16 lanes = count - m >= 16 ? 0xFFFF : static_cast<__mmask16>((1u << (count - m)) - 1u);
+        __m512 dx       = _mm512_sub_ps(px, _mm512_maskz_loadu_ps(lanes, tx + m));
+        __m512 dy       = _mm512_sub_ps(py, _mm512_maskz_loadu_ps(lanes, ty + m));
+        __m512 dz       = _mm512_sub_ps(pz, _mm512_maskz_loadu_ps(lanes, tz + m));
+        __m512 d2       = _mm512_fmadd_ps(dz, dz, _mm512_fmadd_ps(dy, dy, _mm512_mul_ps(dx, dx)));
+        __m512 e        = _mm512_maskz_mov_ps(lanes, exp_avx512(_mm512_mul_ps(vscale, d2)));
+        _mm512_mask_storeu_ps(result + m, lanes, e);
+
+        // The halves are extracted through the double view, the float extract needs AVX-512DQ
+        __m256 low  = _mm256_castpd_ps(half_avx512<0>(_mm512_castps_pd(e)));
+        __m256 high = _mm256_castpd_ps(half_avx512<1>(_mm512_castps_pd(e)));
+        sum         = _mm512_add_pd(sum, _mm512_maskz_cvtps_pd(0xFF, low));
+        sum         = _mm512_add_pd(sum, _mm512_maskz_cvtps_pd(0xFF, high));
+    }
+
+    return reduce_add_avx512(sum);
+}
+#endif
+
+SIMDLevel detect_simd_level()
+{
+#if ATCG_SIMD_X86
+    #ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    int max_leaf = info[0];
+
+    __cpuid(info, 1);
+    bool fma     = (info[2] & (1 << 12)) != 0;
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+
+    // The OS has to save the AVX (bits 1, 2) and AVX-512 (bits 5, 6, 7) registers on context switches
+    unsigned long long xcr0 = osxsave ? _xgetbv(0) : 0;
+    bool avx_state          = (xcr0 & 0x6) == 0x6;
+    bool avx512_state       = (xcr0 & 0xE6) == 0xE6;
+
+    bool avx2 = false, avx512f = false;
+    if(max_leaf >= 7)
+    {
+        __cpuidex(info, 7, 0);
+        avx2    = (info[1] & (1 << 5)) != 0;
+        avx512f = (info[1] & (1 << 16)) != 0;
+    }
+
+    if(avx512f && avx512_state) return SIMDLevel::AVX512;
+    if(avx2 && fma && avx_state) return SIMDLevel::AVX2;
+    return SIMDLevel::SSE2;
+    #else
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx512f")) return SIMDLevel::AVX512;
+    if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return SIMDLevel::AVX2;
+    return SIMDLevel::SSE2;
+    #endif
+#else
+    return SIMDLevel::Scalar;
+#endif
+}
+}    // namespace detail
+
+DenormalGuard::DenormalGuard()
+{
+#if ATCG_SIMD_X86
+    // Bit 15 is flush-to-zero, bit 6 denormals-are-zero
+    _state = _mm_getcsr();
+    _mm_setcsr(_state | 0x8040);
+#endif
+}
+
+DenormalGuard::~DenormalGuard()
+{
+#if ATCG_SIMD_X86
+    _mm_setcsr(_state);
+#endif
+}
+
+namespace GaussianKernel
+{
+SIMDLevel simd_level()
+{
+    static const SIMDLevel level = detail::detect_simd_level();
+    return level;
+}
+
+double evaluate(const double* x,
+                const double* tx,
+                const double* ty,
+                const double* tz,
+                const size_t& count,
+                const double& scale,
+                double* result)
+{
+    return evaluate(simd_level(), x, tx, ty, tz, count, scale, result);
+}
+
+double evaluate(const SIMDLevel& level,
+                const double* x,
+                const double* tx,
+                const double* ty,
+                const double* tz,
+                const size_t& count,
+                const double& scale,
+                double* result)
+{
+    switch(std::min(level, simd_level()))
+    {
+#if ATCG_SIMD_X86
+        case SIMDLevel::AVX512:
+            return detail::gaussian_kernel_avx512(x, tx, ty, tz, count, scale, result);
+        case SIMDLevel::AVX2:
+            return detail::gaussian_kernel_avx2(x, tx, ty, tz, count, scale, result);
+        case SIMDLevel::SSE2:
+            return detail::gaussian_kernel_sse2(x, tx, ty, tz, count, scale, result);
+#endif
+        default:
+            return detail::gaussian_kernel_scalar(x, tx, ty, tz, 0, count, scale, result);
+    }
+}
+
+double evaluate(const float* x,
+                const float* tx,
+                const float* ty,
+                const float* tz,
+                const size_t& count,
+                const float& scale,
+                float* result)
+{
+    return evaluate(simd_level(), x, tx, ty, tz, count, scale, result);
+}
+
+double evaluate(const SIMDLevel& level,
+                const float* x,
+                const float* tx,
+                const float* ty,
+                const float* tz,
+                const size_t& count,
+                const float& scale,
+                float* result)
+{
+    switch(std::min(level, simd_level()))
+    {
+#if ATCG_SIMD_X86
+        case SIMDLevel::AVX512:
+            return detail::gaussian_kernel_avx512(x, tx, ty, tz, count, scale, result);
+        case SIMDLevel::AVX2:
+            return detail::gaussian_kernel_avx2(x, tx, ty, tz, count, scale, result);
+        case SIMDLevel::SSE2:
+            return detail::gaussian_kernel_sse2(x, tx, ty, tz, count, scale, result);
+#endif
+        default:
+            return detail::gaussian_kernel_scalar(x, tx, ty, tz, 0, count, scale, result);
+    }
+}
+}    // namespace GaussianKernel
+}    // namespace atcg
\ No newline at end of file
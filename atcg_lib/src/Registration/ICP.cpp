@@ -0,0 +1,286 @@
+#include <Registration/ICP.h>
+#include <Registration/Normals.h>
+
+#include <Core/ThreadPool.h>
+
+#include <Eigen/SVD>
+#include <nanoflann.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace atcg
+{
+template<typename Scalar>
+struct IterativeClosestPointT<Scalar>::KDTree
+    : public nanoflann::KDTreeEigenMatrixAdaptor<Matrix, 3, nanoflann::metric_L2_Simple>
+{
+    using nanoflann::KDTreeEigenMatrixAdaptor<Matrix, 3, nanoflann::metric_L2_Simple>::KDTreeEigenMatrixAdaptor;
+};
+
+template<typename Scalar>
+IterativeClosestPointT<Scalar>::IterativeClosestPointT(const std::shared_ptr<PointCloud>& source,
+                                                       const std::shared_ptr<PointCloud>& target,
+                                                       const ICPMethod& method,
+                                                       const double& trim,
+                                                       const uint32_t& neighbors)
+    : RegistrationT<Scalar>::RegistrationT(source, target),
+      method(method),
+      trim(std::clamp(trim, 0.0, 1.0)),
+      neighbors(std::max(neighbors, 3u))
+{
+    // Y is never moved, so the tree stays valid for all iterations
+    tree = std::make_shared<const KDTree>(3, std::cref(Y));
+
+    // The orientation of the normals does not matter for the point to plane error
+    if(method == ICPMethod::PointToPlane)
+    {
+        normals = std::make_shared<const Matrix>(
+            estimate_normals(Y.template cast<double>(), neighbors).template cast<Scalar>());
+    }
+}
+
+template<typename Scalar>
+IterativeClosestPointT<Scalar>::IterativeClosestPointT(const std::shared_ptr<PointCloud>& source,
+                                                       const IterativeClosestPointT<Scalar>& reference)
+    : RegistrationT<Scalar>::RegistrationT(source, reference),
+      method(reference.method),
+      trim(reference.trim),
+      neighbors(reference.neighbors),
+      tree(reference.tree),
+      normals(reference.normals)
+{
+}
+
+template<typename Scalar>
+IterativeClosestPointT<Scalar>::~IterativeClosestPointT() {}
+
+template<typename Scalar>
+void IterativeClosestPointT<Scalar>::solve(const uint32_t& maxN, const float& tol)
+{
+    this->beginSolve();
+
+    // Without points there are no correspondences to align
+    if(N == 0 || M == 0) return;
+
+    this->timed("correspond", [&]() { var = correspond(); });
+
+    this->iterate(maxN,
+                  [&]()
+                  {
+                      this->timed("align",
+                                  [&]()
+                                  {
+                                      if(method == ICPMethod::PointToPlane)
+                                          align_point_to_plane();
+                                      else
+                                          align_point_to_point();
+                                  });
+
+                      const double old_var = var;
+                      this->timed("correspond", [&]() { var = correspond(); });
+                      return std::abs(old_var - var) > tol;
+                  });
+}
+
+template<typename Scalar>
+void IterativeClosestPointT<Scalar>::setTransform(const Eigen::Matrix3d& R, const Eigen::Vector3d& t)
+{
+    this->R = R;
+    this->t = t;
+}
+
+template<typename Scalar>
+double IterativeClosestPointT<Scalar>::correspond()
+{
+    correspondence.resize(N);
+    distance.resize(N);
+
+    // x -> R^T * (x - t) moves the source into the frame of the untransformed target
+    const Eigen::Matrix<Scalar, 3, 3> RT  = R.transpose().template cast<Scalar>();
+    const Eigen::Matrix<Scalar, 3, 1> RTt = (R.transpose() * t).template cast<Scalar>();
+    ThreadPool::get()->parallel_for(
+        0,
+        N,
+        [&](size_t first, size_t last)
+        {
+            for(size_t n = first; n < last; ++n)
+            {
+                Eigen::Matrix<Scalar, 3, 1> q = RT * X.template block<1, 3>(n, 0).transpose() - RTt;
+
+                Eigen::Index index = 0;
+                Scalar d           = 0;
+                if(tree->index_->knnSearch(q.data(), 1, &index, &d) == 0) d = std::numeric_limits<Scalar>::infinity();
+                correspondence[n] = static_cast<uint32_t>(index);
+                distance[n]       = d;
+            }
+        });
+
+    // Trimming: keep the closest ceil(trim * N) correspondences, but at least as many as the alignment has unknowns
+    // (the 6 of the linearized point to plane system, 3 non-collinear points for point to point). nth_element finds the
+    // threshold in O(N)
+    const size_t minimum = method == ICPMethod::PointToPlane ? 6 : 3;
+    size_t kept          = std::max<size_t>(static_cast<size_t>(std::ceil(trim * N)), minimum);
+    if(kept >= N)
+    {
+        threshold = std::numeric_limits<Scalar>::max();
+    }
+    else
+    {
+        std::vector<Scalar> sorted(distance);
+        std::nth_element(sorted.begin(), sorted.begin() + (kept - 1), sorted.end());
+        threshold = sorted[kept - 1];
+    }
+
+    double sum   = 0.0;
+    size_t count = 0;
+    for(uint32_t n = 0; n < N; ++n)
+    {
+        if(distance[n] > threshold) continue;
+        sum += distance[n];
+        ++count;
+    }
+
+    return count == 0 ? 0.0 : sum / (3.0 * count);
+}
+
+template<typename Scalar>
+void IterativeClosestPointT<Scalar>::align_point_to_point()
+{
+    // Closed form of min sum ||R * y_m + t - x_n||^2 (Arun et al. 1987). The moments are accumulated per chunk in one
+    // pass without centered copies
+    struct Moments
+    {
+        double count           = 0;
+        Eigen::Vector3d sum_x  = Eigen::Vector3d::Zero();
+        Eigen::Vector3d sum_y  = Eigen::Vector3d::Zero();
+        Eigen::Matrix3d sum_xy = Eigen::Matrix3d::Zero();
+    };
+
+    ThreadPool* pool      = ThreadPool::get();
+    const uint32_t chunks = pool->num_threads() + 1;
+    std::vector<Moments> local(chunks);
+    pool->parallel_for(
+        0,
+        N,
+        chunks,
+        [&](size_t first, size_t last, uint32_t chunk)
+        {
+            Moments& moments = local[chunk];
+            for(size_t n = first; n < last; ++n)
+            {
+                if(distance[n] > threshold) continue;
+
+                Eigen::Vector3d x = X.template block<1, 3>(n, 0).transpose().template cast<double>();
+                Eigen::Vector3d y = Y.template block<1, 3>(correspondence[n], 0).transpose().template cast<double>();
+                moments.count += 1;
+                moments.sum_x += x;
+                moments.sum_y += y;
+                moments.sum_xy += x * y.transpose();
+            }
+        });
+
+    Moments moments;
+    for(const Moments& m: local)
+    {
+        moments.count += m.count;
+        moments.sum_x += m.sum_x;
+        moments.sum_y += m.sum_y;
+        moments.sum_xy += m.sum_xy;
+    }
+    if(moments.count == 0) return;
+
+    Eigen::Vector3d uX = moments.sum_x / moments.count;
+    Eigen::Vector3d uY = moments.sum_y / moments.count;
+    Eigen::Matrix3d A  = moments.sum_xy - moments.count * uX * uY.transpose();
+
+    Eigen::JacobiSVD<Eigen::Matrix3d, Eigen::ComputeFullU | Eigen::ComputeFullV> svd(A);
+    Eigen::Matrix3d U = svd.matrixU();
+    Eigen::Matrix3d V = svd.matrixV();
+
+    Eigen::Matrix3d C = Eigen::Matrix3d::Identity();
+    C(2, 2)           = (U * V.transpose()).determinant();
+
+    R = U * C * V.transpose();
+    t = uX - R * uY;
+}
+
+template<typename Scalar>
+void IterativeClosestPointT<Scalar>::align_point_to_plane()
+{
+    // Linearize the rotation update R' = (I + [w]x) * R, t' = (I + [w]x) * t + u. With p = R * y_m + t and the
+    // rotated normal k = R * n_m, the residual k^T * (p - x_n) has the gradient [x_n x k, k] with respect to [w, u].
+    // The 6x6 normal equations are accumulated per chunk
+    using Matrix6 = Eigen::Matrix<double, 6, 6>;
+    using Vector6 = Eigen::Matrix<double, 6, 1>;
+
+    struct NormalEquations
+    {
+        Matrix6 JTJ = Matrix6::Zero();
+        Vector6 JTr = Vector6::Zero();
+    };
+
+    ThreadPool* pool      = ThreadPool::get();
+    const uint32_t chunks = pool->num_threads() + 1;
+    std::vector<NormalEquations> local(chunks);
+    pool->parallel_for(
+        0,
+        N,
+        chunks,
+        [&](size_t first, size_t last, uint32_t chunk)
+        {
+            NormalEquations& equations = local[chunk];
+            for(size_t n = first; n < last; ++n)
+            {
+                if(distance[n] > threshold) continue;
+
+                const uint32_t m  = correspondence[n];
+                Eigen::Vector3d x = X.template block<1, 3>(n, 0).transpose().template cast<double>();
+                Eigen::Vector3d p = R * Y.template block<1, 3>(m, 0).transpose().template cast<double>() + t;
+                Eigen::Vector3d k = R * normals->template block<1, 3>(m, 0).transpose().template cast<double>();
+
+                Vector6 J;
+                J << x.cross(k), k;
+                double r = k.dot(p - x);
+
+                equations.JTJ.template selfadjointView<Eigen::Upper>().rankUpdate(J);
+                equations.JTr += r * J;
+            }
+        });
+
+    NormalEquations equations;
+    for(const NormalEquations& e: local)
+    {
+        equations.JTJ += e.JTJ;
+        equations.JTr += e.JTr;
+    }
+
+    Vector6 delta = -equations.JTJ.template selfadjointView<Eigen::Upper>().ldlt().solve(equations.JTr);
+    if(!delta.allFinite()) return;
+
+    Eigen::Vector3d w = delta.head<3>();
+    double angle      = w.norm();
+    Eigen::Matrix3d dR =
+        angle > 0.0 ? Eigen::AngleAxisd(angle, w / angle).toRotationMatrix() : Eigen::Matrix3d::Identity();
+
+    R = dR * R;
+    t = dR * t + delta.tail<3>();
+}
+
+template<typename Scalar>
+typename IterativeClosestPointT<Scalar>::Matrix IterativeClosestPointT<Scalar>::transformedTarget() const
+{
+    return (Y * R.transpose().template cast<Scalar>()).rowwise() + t.template cast<Scalar>().transpose();
+}
+
+template<typename Scalar>
+void IterativeClosestPointT<Scalar>::applyTransform(const std::shared_ptr<PointCloud>& cloud)
+{
+    auto points = cloud->points();
+    points      = ((points.cast<double>() * R.transpose()).rowwise() + t.transpose()).cast<float>();
+}
+
+template class IterativeClosestPointT<double>;
+template class IterativeClosestPointT<float>;
+}    // namespace atcg
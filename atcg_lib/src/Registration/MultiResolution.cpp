@@ -0,0 +1,199 @@
+#include <Registration/MultiResolution.h>
+
+#include <Core/ThreadPool.h>
+#include <DataStructure/Grid.h>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace atcg
+{
+namespace detail
+{
+struct VoxelCentroid
+{
+    glm::vec3 sum  = glm::vec3(0);
+    uint32_t count = 0;
+};
+
+struct ChunkedCentroid
+{
+    GridCell voxel;
+    Eigen::Vector3d sum = Eigen::Vector3d::Zero();
+    uint32_t count      = 0;
+};
+}    // namespace detail
+
+std::shared_ptr<PointCloud> voxel_downsample(const std::shared_ptr<PointCloud>& cloud, const float& voxel_length)
+{
+    auto result = std::make_shared<PointCloud>();
+    if(cloud->n_vertices() == 0) return result;
+
+    const auto points     = cloud->cpoints();
+    Eigen::RowVector3f lo = points.colwise().minCoeff();
+    Eigen::RowVector3f hi  = points.colwise().maxCoeff();
+    glm::vec3 min(lo(0), lo(1), lo(2));
+    glm::vec3 max(hi(0), hi(1), hi(2));
+
+    // Coarsen the voxels if the grid would get too large to be indexed
+    float extent = glm::max(glm::max(max.x - min.x, max.y - min.y), max.z - min.z);
+    float length = std::max(voxel_length, extent / static_cast<float>(GRID_MAX_VOXELS - 1));
+    if(length <= 0.0f) length = 1.0f;
+    uint32_t num_voxels = static_cast<uint32_t>(extent / length) + 1;
+
+    Grid<detail::VoxelCentroid> grid(min, num_voxels, length, false);
+
+    // The centroids are stored in the order in which their voxels are first visited
+    std::unordered_map<int32_t, uint32_t> slots;
+    std::vector<detail::VoxelCentroid> voxels;
+    slots.reserve(cloud->n_vertices());
+    for(size_t i = 0; i < cloud->n_vertices(); ++i)
+    {
+        glm::vec3 p(points(i, 0), points(i, 1), points(i, 2));
+
+        glm::ivec3 voxel = glm::min(grid.position2voxel(p), glm::ivec3(num_voxels - 1));
+        auto slot        = slots.try_emplace(grid.voxel2index(voxel), static_cast<uint32_t>(voxels.size())).first;
+        if(slot->second == voxels.size()) voxels.emplace_back();
+
+        voxels[slot->second].sum += p;
+        ++voxels[slot->second].count;
+    }
+
+    result->resize(voxels.size());
+    auto centroids = result->points();
+    for(size_t i = 0; i < voxels.size(); ++i)
+    {
+        glm::vec3 centroid = voxels[i].sum / static_cast<float>(voxels[i].count);
+        centroids.row(i) << centroid.x, centroid.y, centroid.z;
+    }
+
+    return result;
+}
+
+std::shared_ptr<PointCloud> voxel_downsample(const std::shared_ptr<ChunkedPointCloud>& cloud,
+                                             const float& voxel_length)
+{
+    const float length = voxel_length > 0.0f ? voxel_length : 1.0f;
+
+    // Partial centroids per chunk, merged in chunk order so the result does not depend on the scheduling
+    std::vector<std::vector<detail::ChunkedCentroid>> partial(cloud->n_chunks());
+    cloud->for_each_chunk(
+        [&](size_t index, PointCloud& chunk)
+        {
+            const auto points = chunk.cpoints();
+            std::unordered_map<GridCell, uint32_t, GridCellHash> slots;
+            std::vector<detail::ChunkedCentroid>& voxels = partial[index];
+            for(size_t i = 0; i < chunk.n_vertices(); ++i)
+            {
+                GridCell voxel = GridCell::of(points.row(i), length);
+                auto slot      = slots.try_emplace(voxel, static_cast<uint32_t>(voxels.size())).first;
+                if(slot->second == voxels.size()) voxels.push_back(detail::ChunkedCentroid {voxel});
+
+                voxels[slot->second].sum += points.row(i).transpose().cast<double>();
+                ++voxels[slot->second].count;
+            }
+        });
+
+    std::unordered_map<GridCell, uint32_t, GridCellHash> slots;
+    std::vector<detail::ChunkedCentroid> voxels;
+    for(std::vector<detail::ChunkedCentroid>& chunk: partial)
+    {
+        for(const detail::ChunkedCentroid& centroid: chunk)
+        {
+            auto slot = slots.try_emplace(centroid.voxel, static_cast<uint32_t>(voxels.size())).first;
+            if(slot->second == voxels.size())
+            {
+                voxels.push_back(centroid);
+                continue;
+            }
+
+            voxels[slot->second].sum += centroid.sum;
+            voxels[slot->second].count += centroid.count;
+        }
+        std::vector<detail::ChunkedCentroid>().swap(chunk);
+    }
+
+    auto result = std::make_shared<PointCloud>();
+    result->resize(voxels.size());
+    auto centroids = result->points();
+    for(size_t i = 0; i < voxels.size(); ++i)
+    {
+        centroids.row(i) = (voxels[i].sum / static_cast<double>(voxels[i].count)).transpose().cast<float>();
+    }
+
+    return result;
+}
+
+std::shared_ptr<PointCloud> subsample(const std::shared_ptr<PointCloud>& cloud,
+                                      const uint32_t& count,
+                                      const SubsampleMethod& method,
+                                      const uint32_t& seed)
+{
+    const auto points = cloud->cpoints();
+    const size_t n    = points.rows();
+
+    std::vector<size_t> picked;
+    std::mt19937 generator(seed);
+    if(n <= count)
+    {
+        picked.resize(n);
+        std::iota(picked.begin(), picked.end(), 0);
+    }
+    else if(method == SubsampleMethod::Random)
+    {
+        std::vector<size_t> indices(n);
+        std::iota(indices.begin(), indices.end(), 0);
+        for(size_t i = 0; i < count; ++i)
+        {
+            std::uniform_int_distribution<size_t> distribution(i, n - 1);
+            std::swap(indices[i], indices[distribution(generator)]);
+        }
+        picked.assign(indices.begin(), indices.begin() + count);
+    }
+    else
+    {
+        // Every point keeps its squared distance to the closest picked point. Each round updates them with the last
+        // picked point and picks the farthest one. The chunks find their own maximum, which is reduced afterwards
+        ThreadPool* pool      = ThreadPool::get();
+        const uint32_t chunks = pool->num_threads() + 1;
+        std::vector<float> distance(n, std::numeric_limits<float>::max());
+        std::vector<std::pair<float, size_t>> farthest(chunks);
+
+        size_t next = std::uniform_int_distribution<size_t>(0, n - 1)(generator);
+        picked.reserve(count);
+        while(picked.size() < count)
+        {
+            picked.push_back(next);
+            Eigen::RowVector3f p = points.row(next);
+
+            std::fill(farthest.begin(), farthest.end(), std::make_pair(-1.0f, size_t(0)));
+            pool->parallel_for(
+                0,
+                n,
+                chunks,
+                [&](size_t first, size_t last, uint32_t chunk)
+                {
+                    std::pair<float, size_t>& best = farthest[chunk];
+                    for(size_t i = first; i < last; ++i)
+                    {
+                        distance[i] = std::min(distance[i], (points.row(i) - p).squaredNorm());
+                        if(distance[i] > best.first) best = {distance[i], i};
+                    }
+                });
+            next = std::max_element(farthest.begin(), farthest.end())->second;
+        }
+    }
+
+    auto result = std::make_shared<PointCloud>();
+    result->resize(picked.size());
+    auto result_points = result->points();
+    for(size_t i = 0; i < picked.size(); ++i) result_points.row(i) = points.row(picked[i]);
+    return result;
+}
+}    // namespace atcg
\ No newline at end of file
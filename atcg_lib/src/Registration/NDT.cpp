@@ -0,0 +1,356 @@
+#include <Registration/NDT.h>
+
+#include <Core/ThreadPool.h>
+#include <DataStructure/Grid.h>
+
+#include <Eigen/Eigenvalues>
+#include <Eigen/Geometry>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+namespace atcg
+{
+namespace detail
+{
+// Voxels with fewer points do not get a Gaussian
+constexpr uint32_t NDT_MIN_POINTS = 6;
+
+// The eigenvalues of a covariance are clamped to this fraction of the largest one (Magnusson 2009)
+constexpr double NDT_EIGENVALUE_RATIO = 0.01;
+
+// A Newton step moves the source points by at most this fraction of the resolution
+constexpr double NDT_MAX_STEP = 0.5;
+
+// The number of times a step is halved before the optimization counts as converged
+constexpr uint32_t NDT_LINE_SEARCH_STEPS = 10;
+
+// The voxel of a point and the six voxels that share a face with it
+constexpr int32_t NDT_NEIGHBORS[7][3] = {{0, 0, 0}, {-1, 0, 0}, {1, 0, 0}, {0, -1, 0}, {0, 1, 0}, {0, 0, -1}, {0, 0, 1}};
+
+struct NDTCell
+{
+    Eigen::Vector3d mean      = Eigen::Vector3d::Zero();
+    Eigen::Matrix3d inverse   = Eigen::Matrix3d::Zero();    // Inverse covariance
+    Eigen::Matrix3d sum_outer = Eigen::Matrix3d::Zero();
+    uint32_t count            = 0;
+};
+}    // namespace detail
+
+template<typename Scalar>
+struct NormalDistributionsTransformT<Scalar>::Voxels
+{
+    Voxels(const glm::vec3& origin, const uint32_t& num_voxels, const float& voxel_length)
+        : grid(origin, num_voxels, voxel_length, false)
+    {
+    }
+
+    // Returns the cell of a voxel or nullptr if it has no Gaussian
+    const detail::NDTCell* find(const glm::ivec3& voxel)
+    {
+        const int32_t n = static_cast<int32_t>(grid.num_voxels());
+        if(voxel.x < 0 || voxel.y < 0 || voxel.z < 0 || voxel.x >= n || voxel.y >= n || voxel.z >= n) return nullptr;
+
+        auto slot = slots.find(grid.voxel2index(voxel));
+        return slot == slots.end() ? nullptr : &cells[slot->second];
+    }
+
+    // Only used for the addressing, the cells of the occupied voxels are stored sparsely
+    Grid<detail::NDTCell> grid;
+    std::unordered_map<int32_t, uint32_t> slots;
+    std::vector<detail::NDTCell> cells;
+};
+
+template<typename Scalar>
+struct NormalDistributionsTransformT<Scalar>::Evaluation
+{
+    double score = 0.0;
+    Eigen::Matrix<double, 6, 1> gradient = Eigen::Matrix<double, 6, 1>::Zero();
+    Eigen::Matrix<double, 6, 6> hessian  = Eigen::Matrix<double, 6, 6>::Zero();
+
+    double sum_squared = 0.0;    // Squared distances of the source points to the mean of their voxel
+    double count       = 0.0;
+};
+
+template<typename Scalar>
+NormalDistributionsTransformT<Scalar>::NormalDistributionsTransformT(const std::shared_ptr<PointCloud>& source,
+                                                                     const std::shared_ptr<PointCloud>& target,
+                                                                     const double& resolution,
+                                                                     const double& outlier_ratio)
+    : RegistrationT<Scalar>::RegistrationT(source, target),
+      resolution(resolution),
+      outlier_ratio(std::clamp(outlier_ratio, 0.0, 0.99))
+{
+    // The score of a point is a mixture of a normal distribution and a uniform outlier term. It is approximated by
+    // the Gaussian -d1 * exp(-d2 / 2 * x^T * C * x) (Magnusson 2009, eq. 6.8). Here d1 < 0
+    double c1 = 10.0 * (1.0 - this->outlier_ratio);
+    double c2 = this->outlier_ratio / (resolution * resolution * resolution);
+    double d3 = c2 > 0.0 ? -std::log(c2) : 0.0;
+    d1        = -std::log(c1 + c2) - d3;
+    d2        = -2.0 * std::log((-std::log(c1 * std::exp(-0.5) + c2) - d3) / d1);
+
+    voxelize();
+}
+
+template<typename Scalar>
+NormalDistributionsTransformT<Scalar>::NormalDistributionsTransformT(
+    const std::shared_ptr<PointCloud>& source,
+    const NormalDistributionsTransformT<Scalar>& reference)
+    : RegistrationT<Scalar>::RegistrationT(source, reference),
+      resolution(reference.resolution),
+      outlier_ratio(reference.outlier_ratio),
+      d1(reference.d1),
+      d2(reference.d2),
+      voxels(reference.voxels)
+{
+}
+
+template<typename Scalar>
+NormalDistributionsTransformT<Scalar>::~NormalDistributionsTransformT()
+{
+}
+
+template<typename Scalar>
+void NormalDistributionsTransformT<Scalar>::solve(const uint32_t& maxN, const float& tol)
+{
+    this->beginSolve();
+
+    Evaluation current = evaluate(R.transpose(), -R.transpose() * t, false);
+    score              = current.score;
+    var                = current.count == 0 ? 0.0 : current.sum_squared / (3.0 * current.count);
+
+    this->iterate(maxN,
+                  [&]()
+                  {
+                      const double old_var = var;
+                      bool improved        = false;
+                      this->timed("step", [&]() { improved = step(); });
+                      return improved && std::abs(old_var - var) > tol;
+                  });
+}
+
+template<typename Scalar>
+void NormalDistributionsTransformT<Scalar>::setTransform(const Eigen::Matrix3d& R, const Eigen::Vector3d& t)
+{
+    this->R = R;
+    this->t = t;
+}
+
+template<typename Scalar>
+void NormalDistributionsTransformT<Scalar>::voxelize()
+{
+    if(M == 0) return;
+
+    Eigen::Vector3d min = Y.template cast<double>().colwise().minCoeff().transpose();
+    Eigen::Vector3d max = Y.template cast<double>().colwise().maxCoeff().transpose();
+
+    // Coarsen the voxels if the grid would get too large to be indexed. One empty voxel on each side keeps the
+    // neighbors of all target voxels inside the grid
+    double extent = (max - min).maxCoeff();
+    double length = std::max(resolution, extent / static_cast<double>(GRID_MAX_VOXELS - 3));
+    uint32_t num_voxels = std::min(static_cast<uint32_t>(std::floor(extent / length)) + 3, GRID_MAX_VOXELS);
+    glm::vec3 origin(min(0) - length, min(1) - length, min(2) - length);
+
+    auto result = std::make_shared<Voxels>(origin, num_voxels, static_cast<float>(length));
+    result->slots.reserve(M);
+    for(uint32_t m = 0; m < M; ++m)
+    {
+        Eigen::Vector3d y = Y.template block<1, 3>(m, 0).transpose().template cast<double>();
+        glm::ivec3 voxel  = result->grid.position2voxel(glm::vec3(y(0), y(1), y(2)));
+
+        auto slot =
+            result->slots.try_emplace(result->grid.voxel2index(voxel), static_cast<uint32_t>(result->cells.size()))
+                .first;
+        if(slot->second == result->cells.size()) result->cells.emplace_back();
+
+        detail::NDTCell& cell = result->cells[slot->second];
+        cell.mean += y;
+        cell.sum_outer += y * y.transpose();
+        ++cell.count;
+    }
+
+    ThreadPool::get()->parallel_for(
+        0,
+        result->cells.size(),
+        [&](size_t first, size_t last)
+        {
+            for(size_t i = first; i < last; ++i)
+            {
+                detail::NDTCell& cell = result->cells[i];
+                if(cell.count < detail::NDT_MIN_POINTS) continue;
+
+                cell.mean /= static_cast<double>(cell.count);
+                Eigen::Matrix3d covariance = (cell.sum_outer - cell.count * cell.mean * cell.mean.transpose()) /
+                                             static_cast<double>(cell.count - 1);
+
+                Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> eigen;
+                eigen.computeDirect(covariance);
+                Eigen::Vector3d values = eigen.eigenvalues();
+                if(!(values(2) > 0.0)) continue;
+
+                values = values.cwiseMax(detail::NDT_EIGENVALUE_RATIO * values(2));
+                cell.inverse =
+                    eigen.eigenvectors() * values.cwiseInverse().asDiagonal() * eigen.eigenvectors().transpose();
+            }
+        });
+
+    // Drop the cells without a Gaussian, so every lookup hit can be scored
+    std::vector<detail::NDTCell> cells;
+    std::unordered_map<int32_t, uint32_t> slots;
+    for(const auto& slot: result->slots)
+    {
+        const detail::NDTCell& cell = result->cells[slot.second];
+        if(cell.count < detail::NDT_MIN_POINTS || cell.inverse.isZero()) continue;
+
+        slots.emplace(slot.first, static_cast<uint32_t>(cells.size()));
+        cells.push_back(cell);
+    }
+    result->cells = std::move(cells);
+    result->slots = std::move(slots);
+
+    voxels = result;
+}
+
+template<typename Scalar>
+typename NormalDistributionsTransformT<Scalar>::Evaluation
+NormalDistributionsTransformT<Scalar>::evaluate(const Eigen::Matrix3d& R_inv,
+                                                const Eigen::Vector3d& t_inv,
+                                                const bool& derivatives) const
+{
+    // The source point q = R_inv * x + t_inv moves with the update q -> exp([w]x) * q + u. Its Jacobian with respect
+    // to [w, u] is J = [-[q]x, I] and the second derivatives of q with respect to w_a, w_b are
+    // (e_a * q_b + e_b * q_a) / 2 - delta_ab * q. With r = q - mean, s = C * r and the weight
+    // a = -d1 * d2 * exp(-d2 / 2 * r^T * s), the gradient is a * J^T * s and the Hessian is
+    // a * (-d2 * J^T * s * s^T * J + J^T * C * J + s^T * d2q) (Magnusson 2009, eq. 6.12 and 6.13)
+    ThreadPool* pool      = ThreadPool::get();
+    const uint32_t chunks = pool->num_threads() + 1;
+    std::vector<Evaluation> local(chunks);
+    pool->parallel_for(
+        0,
+        N,
+        chunks,
+        [&](size_t first, size_t last, uint32_t chunk)
+        {
+            Evaluation& evaluation = local[chunk];
+            for(size_t n = first; n < last; ++n)
+            {
+                Eigen::Vector3d q = R_inv * X.template block<1, 3>(n, 0).transpose().template cast<double>() + t_inv;
+                glm::ivec3 voxel  = voxels->grid.position2voxel(glm::vec3(q(0), q(1), q(2)));
+
+                Eigen::Matrix<double, 3, 6> J;
+                if(derivatives)
+                {
+                    J.template leftCols<3>() << 0.0, q(2), -q(1), -q(2), 0.0, q(0), q(1), -q(0), 0.0;
+                    J.template rightCols<3>().setIdentity();
+                }
+
+                for(uint32_t k = 0; k < 7; ++k)
+                {
+                    const detail::NDTCell* cell = voxels->find(voxel + glm::ivec3(detail::NDT_NEIGHBORS[k][0],
+                                                                                  detail::NDT_NEIGHBORS[k][1],
+                                                                                  detail::NDT_NEIGHBORS[k][2]));
+                    if(cell == nullptr) continue;
+
+                    Eigen::Vector3d r = q - cell->mean;
+                    if(k == 0)
+                    {
+                        evaluation.sum_squared += r.squaredNorm();
+                        evaluation.count += 1;
+                    }
+
+                    Eigen::Vector3d s = cell->inverse * r;
+                    double e          = std::exp(-0.5 * d2 * r.dot(s));
+                    evaluation.score += d1 * e;
+                    if(!derivatives) continue;
+
+                    double a                    = -d1 * d2 * e;
+                    Eigen::Matrix<double, 6, 1> g = J.transpose() * s;
+                    evaluation.gradient += a * g;
+
+                    Eigen::Matrix<double, 6, 6> H = J.transpose() * cell->inverse * J - d2 * g * g.transpose();
+                    H.template topLeftCorner<3, 3>() +=
+                        0.5 * (s * q.transpose() + q * s.transpose()) - s.dot(q) * Eigen::Matrix3d::Identity();
+                    evaluation.hessian += a * H;
+                }
+            }
+        });
+
+    Evaluation evaluation;
+    for(const Evaluation& e: local)
+    {
+        evaluation.score += e.score;
+        evaluation.gradient += e.gradient;
+        evaluation.hessian += e.hessian;
+        evaluation.sum_squared += e.sum_squared;
+        evaluation.count += e.count;
+    }
+    return evaluation;
+}
+
+template<typename Scalar>
+bool NormalDistributionsTransformT<Scalar>::step()
+{
+    Eigen::Matrix3d R_inv = R.transpose();
+    Eigen::Vector3d t_inv = -R.transpose() * t;
+
+    Evaluation current = evaluate(R_inv, t_inv, true);
+    if(current.count == 0) return false;
+
+    // Far from the optimum the Hessian is indefinite. Flipping its negative eigenvalues keeps the Newton step a
+    // descent direction
+    Eigen::SelfAdjointEigenSolver<Eigen::Matrix<double, 6, 6>> eigen(current.hessian);
+    Eigen::Matrix<double, 6, 1> values = eigen.eigenvalues().cwiseAbs();
+    values = values.cwiseMax(std::numeric_limits<double>::epsilon() * std::max(values.maxCoeff(), 1.0));
+    Eigen::Matrix<double, 6, 1> delta =
+        -(eigen.eigenvectors() * values.cwiseInverse().asDiagonal() * eigen.eigenvectors().transpose()) *
+        current.gradient;
+    if(!delta.allFinite()) return false;
+
+    // Limit the motion of the source points, measured at the radius of the grid
+    double radius   = 0.5 * voxels->grid.num_voxels() * voxels->grid.voxel_side_length();
+    double motion   = delta.template head<3>().norm() * radius + delta.template tail<3>().norm();
+    double max_step = detail::NDT_MAX_STEP * resolution;
+    if(motion > max_step) delta *= max_step / motion;
+
+    for(uint32_t i = 0; i < detail::NDT_LINE_SEARCH_STEPS; ++i, delta *= 0.5)
+    {
+        Eigen::Vector3d w = delta.template head<3>();
+        double angle      = w.norm();
+        Eigen::Matrix3d dR =
+            angle > 0.0 ? Eigen::AngleAxisd(angle, w / angle).toRotationMatrix() : Eigen::Matrix3d::Identity();
+
+        Eigen::Matrix3d R_new = dR * R_inv;
+        Eigen::Vector3d t_new = dR * t_inv + delta.template tail<3>();
+
+        Evaluation candidate = evaluate(R_new, t_new, false);
+        if(candidate.score >= current.score) continue;
+
+        R     = R_new.transpose();
+        t     = -R_new.transpose() * t_new;
+        score = candidate.score;
+        var   = candidate.count == 0 ? 0.0 : candidate.sum_squared / (3.0 * candidate.count);
+        return true;
+    }
+
+    return false;
+}
+
+template<typename Scalar>
+typename NormalDistributionsTransformT<Scalar>::Matrix NormalDistributionsTransformT<Scalar>::transformedTarget() const
+{
+    return (Y * R.transpose().template cast<Scalar>()).rowwise() + t.template cast<Scalar>().transpose();
+}
+
+template<typename Scalar>
+void NormalDistributionsTransformT<Scalar>::applyTransform(const std::shared_ptr<PointCloud>& cloud)
+{
+    auto points = cloud->points();
+    points      = ((points.cast<double>() * R.transpose()).rowwise() + t.transpose()).cast<float>();
+}
+
+template class NormalDistributionsTransformT<double>;
+template class NormalDistributionsTransformT<float>;
+}    // namespace atcg
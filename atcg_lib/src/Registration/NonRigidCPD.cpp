@@ -1,137 +1,484 @@
 #include <Registration/NonRigidCPD.h>
+#include <Registration/FastGaussTransform.h>
+#include <Registration/GaussianKernel.h>
 
-#include <glm/glm.hpp>
-#include <glm/ext/scalar_constants.hpp>
+#include <Core/ThreadPool.h>
 
-#include <iostream>
+#include <Eigen/Eigenvalues>
+#include <Eigen/QR>
+#include <nanoflann.hpp>
+
+#include <random>
 
 namespace atcg
 {
-NonRigidCoherentPointDrift::NonRigidCoherentPointDrift(const std::shared_ptr<PointCloud>& source,
-                                                       const std::shared_ptr<PointCloud>& target,
-                                                       const double& w)
-    : Registration::Registration(source, target),
-      w(w)
+namespace detail
 {
-}
+// Relative residual and iteration limit of the conjugate gradient M-step. The system gets ill-conditioned when the
+// variance shrinks, a solve that hits the limit is continued from its result in the next EM iteration
+constexpr double CG_TOLERANCE        = 1e-5;
+constexpr uint32_t CG_MAX_ITERATIONS = 500;
 
-NonRigidCoherentPointDrift::~NonRigidCoherentPointDrift() {}
+// Entries of the sparse motion coherence matrix below this value are dropped. This puts the cutoff radius at
+// beta * sqrt(-2 * log(SPARSE_EPSILON)), about 5.3 * beta
+constexpr double SPARSE_EPSILON = 1e-6;
+}    // namespace detail
 
-void NonRigidCoherentPointDrift::solve(const uint32_t& maxN, const float& tol)
+template<typename Scalar, typename Accumulator>
+NonRigidCoherentPointDriftT<Scalar, Accumulator>::NonRigidCoherentPointDriftT(
+    const std::shared_ptr<PointCloud>& source,
+    const std::shared_ptr<PointCloud>& target,
+    const double& w,
+    const MotionCoherenceMethod& method,
+    const uint32_t& rank)
+    : RegistrationT<Scalar>::RegistrationT(source, target),
+      w(w),
+      method(method),
+      rank(rank)
 {
-    double var     = initialize();
-    double old_var = 0.0;
-    uint32_t n     = 0;
-    while(n < maxN && std::abs(old_var - var) > tol)
-    {
-        ++n;
-        std::cout << "Iteration: " << n << "\n";
+}
 
-        P                  = RowMatrix::Zero(M, N);
-        Eigen::VectorXd PX = Eigen::VectorXd::Zero(N);
-        Eigen::VectorXd PY = Eigen::VectorXd::Zero(M);
+template<typename Scalar, typename Accumulator>
+NonRigidCoherentPointDriftT<Scalar, Accumulator>::NonRigidCoherentPointDriftT(
+    const std::shared_ptr<PointCloud>& source,
+    const NonRigidCoherentPointDriftT<Scalar, Accumulator>& reference)
+    : RegistrationT<Scalar>::RegistrationT(source, reference),
+      w(reference.w),
+      beta(reference.beta),
+      lambda(reference.lambda),
+      method(reference.method),
+      rank(reference.rank),
+      motion(reference.motion)
+{
+}
 
-        estimate(PX, PY, var);
+template<typename Scalar, typename Accumulator>
+NonRigidCoherentPointDriftT<Scalar, Accumulator>::~NonRigidCoherentPointDriftT() {}
 
-        old_var = var;
-        var     = maximize(PY, PY, var);
-        std::cout << var << "\n";
-    }
+template<typename Scalar, typename Accumulator>
+void NonRigidCoherentPointDriftT<Scalar, Accumulator>::solve(const uint32_t& maxN, const float& tol)
+{
+    initialize();
+    this->expectationMaximization(maxN,
+                                  tol,
+                                  [&](double variance) { estimate(variance); },
+                                  [&](double variance) { return maximize(variance); });
 }
 
-double NonRigidCoherentPointDrift::initialize()
+template<typename Scalar, typename Accumulator>
+void NonRigidCoherentPointDriftT<Scalar, Accumulator>::initialize()
 {
-    G = RowMatrix(M, M);
-    W = RowMatrix::Zero(M, 3);
+    // The coefficients and the motion coherence matrix are kept for further calls of solve
+    if(W.rows() != M) W = Matrix::Zero(M, 3);
 
-    double var = 0.0;
-    for(size_t m = 0; m < M; ++m)
+    prepare();
+}
+
+template<typename Scalar, typename Accumulator>
+void NonRigidCoherentPointDriftT<Scalar, Accumulator>::prepare()
+{
+    if(motion) return;
+
+    auto result = std::make_shared<MotionCoherence>();
+    if(method == MotionCoherenceMethod::LowRank)
+    {
+        lowrank_decomposition(*result);
+    }
+    else if(method == MotionCoherenceMethod::Sparse)
     {
-        for(size_t n = 0; n < N; ++n)
+        sparse_decomposition(*result);
+    }
+    else if(method == MotionCoherenceMethod::Dense)
+    {
+        Matrix& G = result->G;
+        G         = Matrix(M, M);
+        for(size_t m = 0; m < M; ++m)
         {
-            Eigen::Vector3d d = (X.block<1, 3>(n, 0) - Y.block<1, 3>(m, 0));
-            var += d.dot(d) / static_cast<double>(3 * N * M);
+            for(size_t mm = m; mm < M; ++mm)
+            {
+                auto d        = (Y.template block<1, 3>(mm, 0) - Y.template block<1, 3>(m, 0));
+                Scalar weight = static_cast<Scalar>(std::exp(-0.5 / (beta * beta) * d.squaredNorm()));
+                G(m, mm)      = weight;
+                G(mm, m)      = weight;
+            }
         }
+    }
+    motion = result;
+}
+
+template<typename Scalar, typename Accumulator>
+void NonRigidCoherentPointDriftT<Scalar, Accumulator>::lowrank_decomposition(MotionCoherence& result) const
+{
+    // Randomized eigendecomposition (Halko et al. 2011). G is never formed, products with G are gauss transforms
+    // G * V = sum_mm exp(-||y_m - y_mm||^2 / (2 * beta^2)) * V_mm
+    // The decomposition is computed in double precision and only the result is stored with the data precision
+    const uint32_t k = std::min(rank, M);
+    const uint32_t l = std::min(k + 10, M);    // Oversampling
+
+    const RowMatrix& Y_ = Y.template cast<double>();
+    FastGaussTransform transform(Y_, std::sqrt(2.0) * beta, 1e-6);
+
+    std::mt19937 generator(42);
+    std::normal_distribution<double> distribution;
+    RowMatrix Omega(M, l);
+    for(Eigen::Index i = 0; i < Omega.size(); ++i) Omega.data()[i] = distribution(generator);
+
+    // Orthonormal basis of the range of G with two power iterations
+    RowMatrix basis = transform.compute(Omega, Y_);
+    for(uint32_t i = 0; i < 2; ++i)
+    {
+        Eigen::HouseholderQR<RowMatrix> qr(basis);
+        basis = qr.householderQ() * RowMatrix::Identity(M, l);
+        basis = transform.compute(basis, Y_);
+    }
+    Eigen::HouseholderQR<RowMatrix> qr(basis);
+    basis = qr.householderQ() * RowMatrix::Identity(M, l);
+
+    // Project G onto the basis and solve the small eigenproblem
+    RowMatrix B = basis.transpose() * transform.compute(basis, Y_);
+    B           = 0.5 * (B + B.transpose());
+    Eigen::SelfAdjointEigenSolver<RowMatrix> eigen(B);
+
+    // Eigenvalues are sorted in increasing order. Drop numerically vanishing ones, they are inverted in the M-step
+    double threshold = std::max(eigen.eigenvalues()(l - 1), 0.0) * 1e-10;
+    uint32_t used    = 0;
+    while(used < k && eigen.eigenvalues()(l - 1 - used) > threshold) ++used;
 
-        for(size_t mm = m; mm < M; ++mm)
+    result.Q      = (basis * eigen.eigenvectors().rightCols(used).rowwise().reverse()).template cast<Scalar>();
+    result.Lambda = eigen.eigenvalues().tail(used).reverse().template cast<Scalar>();
+}
+
+template<typename Scalar, typename Accumulator>
+void NonRigidCoherentPointDriftT<Scalar, Accumulator>::sparse_decomposition(MotionCoherence& result) const
+{
+    // The neighbors within the cutoff radius are found with a kd-tree over the target, row by row in parallel. Every
+    // chunk collects its own triplets
+    using KDTree = nanoflann::KDTreeEigenMatrixAdaptor<Matrix, 3, nanoflann::metric_L2_Simple>;
+    KDTree tree(3, std::cref(Y));
+
+    const Scalar radius = static_cast<Scalar>(-2.0 * beta * beta * std::log(detail::SPARSE_EPSILON));
+    const Scalar scale  = static_cast<Scalar>(-0.5 / (beta * beta));
+
+    ThreadPool* pool      = ThreadPool::get();
+    const uint32_t chunks = pool->num_threads() + 1;
+    std::vector<std::vector<Eigen::Triplet<Scalar>>> local(chunks);
+    pool->parallel_for(
+        0,
+        M,
+        chunks,
+        [&](size_t first, size_t last, uint32_t chunk)
         {
-            Eigen::Vector3d d = (Y.block<1, 3>(mm, 0) - Y.block<1, 3>(m, 0));
-            double weight     = std::exp(-0.5 / (beta * beta) * d.dot(d));
-            G(m, mm)          = weight;
-            G(mm, m)          = weight;
-        }
+            std::vector<nanoflann::ResultItem<Eigen::Index, Scalar>> neighbors;
+            for(size_t m = first; m < last; ++m)
+            {
+                tree.index_->radiusSearch(Y.row(m).data(), radius, neighbors, nanoflann::SearchParameters(0, false));
+                for(const auto& neighbor: neighbors)
+                {
+                    local[chunk].emplace_back(static_cast<Eigen::Index>(m),
+                                              neighbor.first,
+                                              static_cast<Scalar>(std::exp(scale * neighbor.second)));
+                }
+            }
+        });
+
+    std::vector<Eigen::Triplet<Scalar>> triplets;
+    for(const auto& l: local) triplets.insert(triplets.end(), l.begin(), l.end());
+
+    result.G_s = SparseMatrix(M, M);
+    result.G_s.setFromTriplets(triplets.begin(), triplets.end());
+}
+
+template<typename Scalar, typename Accumulator>
+typename NonRigidCoherentPointDriftT<Scalar, Accumulator>::Matrix
+NonRigidCoherentPointDriftT<Scalar, Accumulator>::coherence(const Matrix& V) const
+{
+    if(method == MotionCoherenceMethod::LowRank)
+    {
+        return motion->Q * (motion->Lambda.asDiagonal() * (motion->Q.transpose() * V));
     }
-    return var;
+    if(method == MotionCoherenceMethod::Iterative) return gauss_transform(Y, V, false);
+    if(method == MotionCoherenceMethod::Sparse) return motion->G_s * V;
+    return motion->G * V;
 }
 
-void NonRigidCoherentPointDrift::estimate(Eigen::VectorXd& PX, Eigen::VectorXd& PY, double var)
+template<typename Scalar, typename Accumulator>
+typename NonRigidCoherentPointDriftT<Scalar, Accumulator>::Matrix
+NonRigidCoherentPointDriftT<Scalar, Accumulator>::transformedTarget() const
 {
-    std::cout << "E-Step\n";
-    double bias = std::pow(2.0 * glm::pi<double>() * var, 3.0 / 2.0) * w / (1.0 - w) * static_cast<double>(M) /
-                  static_cast<double>(N);
+    return Y + coherence(W);
+}
 
-    direct_optimization(PX, PY, bias, var);
+template<typename Scalar, typename Accumulator>
+void NonRigidCoherentPointDriftT<Scalar, Accumulator>::estimate(double var)
+{
+    Matrix T = transformedTarget();
+    EStep::compute<Scalar, Accumulator>(EStepMethod::Direct, X, T, var, w, 0.0, P1, PT1, PX);
 }
 
-void NonRigidCoherentPointDrift::direct_optimization(Eigen::VectorXd& PX, Eigen::VectorXd& PY, double bias, double var)
+template<typename Scalar, typename Accumulator>
+double NonRigidCoherentPointDriftT<Scalar, Accumulator>::maximize(double var)
 {
-    RowMatrix T = Y + G * W;
-    for(size_t n = 0; n < N; ++n)
+    const Scalar c = static_cast<Scalar>(lambda * var);
+    if(method == MotionCoherenceMethod::LowRank)
     {
-        double Z = bias;
-        for(size_t m = 0; m < M; ++m)
-        {
-            Eigen::Vector3d YV = T.block<1, 3>(m, 0);
-            // YV += G.row(m) * W;
+        // (G + c * d(P1)^-1) W = d(P1)^-1 * PX - Y with G = Q * Lambda * Q^T and c = lambda * var.
+        // Woodbury identity: W = 1/c * (D - d(P1) * Q * (c * Lambda^-1 + Q^T * d(P1) * Q)^-1 * Q^T * D)
+        // with D = PX - d(P1) * Y
+        const Matrix& Q      = motion->Q;
+        const Vector& Lambda = motion->Lambda;
 
-            P(m, n) = Pmn(X.block<1, 3>(n, 0), YV, var);
-            Z += P(m, n);
-        }
+        Matrix D     = PX - P1.asDiagonal() * Y;
+        Matrix PQ    = P1.asDiagonal() * Q;
+        Matrix inner = Q.transpose() * PQ;
+        inner.diagonal() += c * Lambda.cwiseInverse();
+        W = (D - PQ * inner.ldlt().solve(Q.transpose() * D)) / c;
+    }
+    else if(method == MotionCoherenceMethod::Iterative)
+    {
+        conjugate_gradient(c);
+    }
+    else if(method == MotionCoherenceMethod::Sparse)
+    {
+        sparse_solve(c);
+    }
+    else
+    {
+        // Multiplied with d(P1): (d(P1) * G + c * I) W = PX - d(P1) * Y. Target points without any responsibility
+        // (P1 = 0) would otherwise put infinities on the diagonal
+        Matrix LHS = P1.asDiagonal() * motion->G;
+        LHS.diagonal().array() += c;
+        Matrix RHS = PX - P1.asDiagonal() * Y;
+        W          = LHS.partialPivLu().solve(RHS);
+    }
 
-        for(size_t m = 0; m < M; ++m)
-        {
-            P(m, n) /= Z;
-            PX(n) += P(m, n);    // PT1
-            PY(m) += P(m, n);    // P1
-        }
+    // var = (tr(X^T * d(PT1) * X) - 2 * tr(PX^T * T) + tr(T^T * d(P1) * T)) / (3 * Np), summed in the accumulation
+    // precision
+    Matrix T       = Y + coherence(W);
+    Accumulator Np = 0, sum = 0;
+    for(uint32_t n = 0; n < N; ++n)
+    {
+        Np += PT1(n);
+        sum += PT1(n) * X.template block<1, 3>(n, 0).template cast<Accumulator>().squaredNorm();
     }
+    for(uint32_t m = 0; m < M; ++m)
+    {
+        Eigen::Matrix<Accumulator, 1, 3> t = T.template block<1, 3>(m, 0).template cast<Accumulator>();
+        sum += P1(m) * t.squaredNorm() - 2 * PX.template block<1, 3>(m, 0).template cast<Accumulator>().dot(t);
+    }
+
+    return static_cast<double>(sum / (3 * Np));
 }
 
-double NonRigidCoherentPointDrift::Pmn(const Eigen::Vector3d& x, const Eigen::Vector3d& y, double var)
+template<typename Scalar, typename Accumulator>
+typename NonRigidCoherentPointDriftT<Scalar, Accumulator>::Matrix
+NonRigidCoherentPointDriftT<Scalar, Accumulator>::displacement(const Matrix& points, const bool& smooth) const
 {
-    return std::exp(-0.5f / var * (x - y).dot(x - y));
+    // G * W is the displacement of the target points for every representation of G, so the smoothed field averages
+    // it instead of W
+    if(smooth) return gauss_transform(points, coherence(W), true);
+
+    // The low rank model only determines the part of W in the span of Q. Projecting onto it is the Nystroem extension
+    // of the eigenvectors and reproduces Q * Lambda * Q^T * W at the target points
+    if(method == MotionCoherenceMethod::LowRank)
+    {
+        return gauss_transform(points, motion->Q * (motion->Q.transpose() * W), false);
+    }
+    return gauss_transform(points, W, false);
 }
 
-double NonRigidCoherentPointDrift::Pmn(const double& L2S, double var)
+template<typename Scalar, typename Accumulator>
+typename NonRigidCoherentPointDriftT<Scalar, Accumulator>::Matrix
+NonRigidCoherentPointDriftT<Scalar, Accumulator>::gauss_transform(const Matrix& points,
+                                                                   const Matrix& V,
+                                                                   const bool& normalize) const
 {
-    return std::exp(-0.5f / var * L2S);
+    const size_t K     = points.rows();
+    const Scalar scale = static_cast<Scalar>(-0.5 / (beta * beta));
+
+    std::vector<Scalar> tx(M), ty(M), tz(M);
+    for(size_t m = 0; m < M; ++m)
+    {
+        tx[m] = Y(m, 0);
+        ty[m] = Y(m, 1);
+        tz[m] = Y(m, 2);
+    }
+
+    // Every chunk of points evaluates its rows of the kernel matrix on the fly, one row at a time
+    Matrix GV(K, 3);
+    ThreadPool::get()->parallel_for(
+        0,
+        K,
+        [&](size_t first, size_t last)
+        {
+            DenormalGuard guard;
+
+            std::vector<Scalar> g(M);
+            for(size_t k = first; k < last; ++k)
+            {
+                double sum =
+                    GaussianKernel::evaluate(points.row(k).data(), tx.data(), ty.data(), tz.data(), M, scale, g.data());
+
+                Accumulator vx = 0, vy = 0, vz = 0;
+                for(size_t m = 0; m < M; ++m)
+                {
+                    vx += g[m] * V(m, 0);
+                    vy += g[m] * V(m, 1);
+                    vz += g[m] * V(m, 2);
+                }
+
+                // Points outside the support of all target points are not moved
+                Accumulator norm = Accumulator(1);
+                if(normalize) norm = sum > 0.0 ? static_cast<Accumulator>(1.0 / sum) : Accumulator(0);
+                GV(k, 0) = static_cast<Scalar>(vx * norm);
+                GV(k, 1) = static_cast<Scalar>(vy * norm);
+                GV(k, 2) = static_cast<Scalar>(vz * norm);
+            }
+        });
+    return GV;
 }
 
-double NonRigidCoherentPointDrift::maximize(Eigen::VectorXd& PX, Eigen::VectorXd& PY, double var)
+template<typename Scalar, typename Accumulator>
+void NonRigidCoherentPointDriftT<Scalar, Accumulator>::conjugate_gradient(const Scalar& c)
 {
-    std::cout << "M-Step\n";
+    // With S = d(P1)^1/2 and W = S * Z the system (G + c * d(P1)^-1) W = d(P1)^-1 * PX - Y becomes
+    // (S * G * S + c * I) Z = S^-1 * (PX - d(P1) * Y). It is symmetric positive definite with eigenvalues >= c, also
+    // for points without any responsibility. The three columns are solved at once, so they share the products with G.
+    // The products go through coherence(), so the sparse fallback multiplies with G_s. A truncated G_s can be
+    // indefinite, a column whose search direction has no positive curvature keeps its last iterate
+    const Vector S = P1.cwiseSqrt();
+
+    Matrix B(M, 3), Z(M, 3);
+    for(uint32_t m = 0; m < M; ++m)
+    {
+        if(S(m) > 0)
+        {
+            B.row(m) = (PX.row(m) - P1(m) * Y.row(m)) / S(m);
+            Z.row(m) = W.row(m) / S(m);    // Warm start from the previous coefficients
+        }
+        else
+        {
+            B.row(m).setZero();
+            Z.row(m).setZero();
+        }
+    }
+
+    auto apply = [&](const Matrix& V) -> Matrix { return S.asDiagonal() * coherence(S.asDiagonal() * V) + c * V; };
+
+    // Jacobi preconditioner, the diagonal of G is one
+    const Vector D_inv = (P1.array() + c).inverse().matrix();
+
+    Matrix R  = B - apply(Z);
+    Matrix H  = D_inv.asDiagonal() * R;
+    Matrix Pd = H;
+
+    Eigen::Matrix<Accumulator, 1, 3> rh, b_norm;
+    for(uint32_t j = 0; j < 3; ++j)
+    {
+        rh(j)     = R.col(j).template cast<Accumulator>().dot(H.col(j).template cast<Accumulator>());
+        b_norm(j) = B.col(j).template cast<Accumulator>().norm();
+    }
 
-    RowMatrix LHS = G + lambda * var * PY.cwiseInverse().asDiagonal().toDenseMatrix();
-    RowMatrix RHS = PY.cwiseInverse().asDiagonal() * P * X - Y;
-    W             = LHS.partialPivLu().solve(RHS);
+    bool stalled[3] = {false, false, false};
+    for(uint32_t i = 0; i < detail::CG_MAX_ITERATIONS; ++i)
+    {
+        bool done[3];
+        for(uint32_t j = 0; j < 3; ++j)
+        {
+            done[j] = stalled[j] || R.col(j).template cast<Accumulator>().norm() <= detail::CG_TOLERANCE * b_norm(j);
+        }
+        if(done[0] && done[1] && done[2]) break;
+
+        Matrix AP = apply(Pd);
+        for(uint32_t j = 0; j < 3; ++j)
+        {
+            if(done[j]) continue;
+
+            Accumulator pap = Pd.col(j).template cast<Accumulator>().dot(AP.col(j).template cast<Accumulator>());
+            if(!(pap > 0))
+            {
+                stalled[j] = done[j] = true;
+                continue;
+            }
+            Scalar alpha = static_cast<Scalar>(rh(j) / pap);
+            Z.col(j) += alpha * Pd.col(j);
+            R.col(j) -= alpha * AP.col(j);
+        }
 
-    double Np   = 1.0 / P.sum();
-    RowMatrix T = Y + G * W;
+        H = D_inv.asDiagonal() * R;
+        for(uint32_t j = 0; j < 3; ++j)
+        {
+            if(done[j]) continue;
+
+            Accumulator rh_new = R.col(j).template cast<Accumulator>().dot(H.col(j).template cast<Accumulator>());
+            Scalar beta_j      = static_cast<Scalar>(rh_new / rh(j));
+            rh(j)              = rh_new;
+            Pd.col(j)          = H.col(j) + beta_j * Pd.col(j);
+        }
+    }
 
-    var = Np / 3 *
-          ((X.transpose() * PX.asDiagonal() * X).trace() - 2.0 * ((P * X).transpose() * T).trace() +
-           (T.transpose() * PY.asDiagonal() * T).trace());
-    return var;
+    W = S.asDiagonal() * Z;
 }
 
-void NonRigidCoherentPointDrift::applyTransform(const std::shared_ptr<PointCloud>& cloud)
+template<typename Scalar, typename Accumulator>
+void NonRigidCoherentPointDriftT<Scalar, Accumulator>::sparse_solve(const Scalar& c)
 {
-    RowMatrix T = Y + G * W;
-    for(auto v_it = cloud->vertices_begin(); v_it != cloud->vertices_end(); ++v_it)
+    // Same symmetric form as the conjugate gradient M-step: (S * G * S + c * I) Z = S^-1 * (PX - d(P1) * Y) with
+    // S = d(P1)^1/2 and W = S * Z. Scaling keeps the pattern of G, so only the numeric factorization is redone
+    const Vector S = P1.cwiseSqrt();
+
+    SparseMatrix LHS = S.asDiagonal() * motion->G_s * S.asDiagonal();
+    LHS.diagonal().array() += c;
+
+    if(!sparse_analyzed)
+    {
+        sparse_solver.analyzePattern(LHS);
+        sparse_analyzed = true;
+    }
+    // The truncated kernel can lose its definiteness. LDLT only fails on an exactly zero pivot, so an indefinite
+    // system shows up as a non-positive entry of D. That M-step is then solved with conjugate gradients on G_s instead
+    // of keeping the coefficients of the last iteration
+    sparse_solver.factorize(LHS);
+    if(sparse_solver.info() != Eigen::Success || !(sparse_solver.vectorD().minCoeff() > 0))
+    {
+        conjugate_gradient(c);
+        return;
+    }
+
+    Matrix B(M, 3);
+    for(uint32_t m = 0; m < M; ++m)
+    {
+        if(S(m) > 0)
+            B.row(m) = (PX.row(m) - P1(m) * Y.row(m)) / S(m);
+        else
+            B.row(m).setZero();
+    }
+
+    Matrix Z = sparse_solver.solve(B);
+    if(sparse_solver.info() != Eigen::Success || !Z.allFinite())
     {
-        PointCloud::Point p_ = cloud->point(*v_it);
-        auto p               = T.block<1, 3>(v_it->idx(), 0);
-        cloud->set_point(*v_it, PointCloud::Point {p(0), p(1), p(2)});
+        conjugate_gradient(c);
+        return;
     }
+    W = S.asDiagonal() * Z;
 }
+
+template<typename Scalar, typename Accumulator>
+void NonRigidCoherentPointDriftT<Scalar, Accumulator>::applyTransform(const std::shared_ptr<PointCloud>& cloud)
+{
+    if(cloud->n_vertices() != M) cloud->resize(M);
+    cloud->points() = transformedTarget().template cast<float>();
+}
+
+template<typename Scalar, typename Accumulator>
+void NonRigidCoherentPointDriftT<Scalar, Accumulator>::applyDeformation(const std::shared_ptr<PointCloud>& cloud,
+                                                                        const bool& smooth)
+{
+    Matrix T = cloud->asMatrix<Scalar>();
+    T += displacement(T, smooth);
+    cloud->points() = T.template cast<float>();
+}
+
+template class NonRigidCoherentPointDriftT<double, double>;
+template class NonRigidCoherentPointDriftT<float, double>;
+template class NonRigidCoherentPointDriftT<float, float>;
 }    // namespace atcg
\ No newline at end of file
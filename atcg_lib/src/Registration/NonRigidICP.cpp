@@ -0,0 +1,648 @@
+#include <Registration/NonRigidICP.h>
+#include <Registration/MultiResolution.h>
+
+#include <Core/ThreadPool.h>
+
+#include <nanoflann.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+
+namespace atcg
+{
+namespace detail
+{
+// Weights of the point to point and point to plane distances (Li et al. 2008)
+constexpr double NRICP_POINT_WEIGHT = 0.1;
+constexpr double NRICP_PLANE_WEIGHT = 1.0;
+
+// The rigidity has this multiple of the weight of the smoothness
+constexpr double NRICP_RIGIDITY_RATIO = 10.0;
+
+// The stiffness is relaxed down to this fraction of its initial value
+constexpr double NRICP_MIN_STIFFNESS = 0.01;
+
+// Correspondences whose normals enclose a larger angle than the arccosine of this are rejected. The orientation of
+// the normals is ignored
+constexpr double NRICP_NORMAL_COMPATIBILITY = 0.5;
+
+// Without a node spacing, the spacing is chosen to place about this many nodes on the target
+constexpr double NRICP_DEFAULT_NODES = 250.0;
+
+// Damping of the diagonal of the normal equations. Keeps nodes without constraints solvable
+constexpr double NRICP_DAMPING = 1e-6;
+
+std::shared_ptr<PointCloud> mesh_vertices(const std::shared_ptr<Mesh>& mesh)
+{
+    auto cloud = std::make_shared<PointCloud>();
+    cloud->add_vertices(mesh->points(), mesh->n_vertices());
+    return cloud;
+}
+
+void set_mesh_vertices(const std::shared_ptr<Mesh>& mesh, const RowMatrixT<double>& points)
+{
+    for(auto v_it = mesh->vertices_begin(); v_it != mesh->vertices_end(); ++v_it)
+    {
+        const int i = v_it->idx();
+        mesh->set_point(*v_it, Mesh::Point(float(points(i, 0)), float(points(i, 1)), float(points(i, 2))));
+    }
+}
+
+std::vector<uint32_t> mesh_faces(const std::shared_ptr<Mesh>& mesh)
+{
+    std::vector<uint32_t> faces;
+    faces.reserve(3 * mesh->n_faces());
+    for(auto f_it = mesh->faces_begin(); f_it != mesh->faces_end(); ++f_it)
+    {
+        for(auto fv_it = mesh->cfv_iter(*f_it); fv_it.is_valid(); ++fv_it)
+        {
+            faces.push_back(static_cast<uint32_t>(fv_it->idx()));
+        }
+    }
+    return faces;
+}
+
+// Area weighted vertex normals
+RowMatrixT<double> vertex_normals(const RowMatrixT<double>& points, const std::vector<uint32_t>& faces)
+{
+    RowMatrixT<double> normals = RowMatrixT<double>::Zero(points.rows(), 3);
+    for(size_t f = 0; f + 2 < faces.size(); f += 3)
+    {
+        Eigen::Vector3d a    = points.row(faces[f]).transpose();
+        Eigen::Vector3d b    = points.row(faces[f + 1]).transpose();
+        Eigen::Vector3d c    = points.row(faces[f + 2]).transpose();
+        Eigen::RowVector3d n = (b - a).cross(c - a).transpose();
+        normals.row(faces[f]) += n;
+        normals.row(faces[f + 1]) += n;
+        normals.row(faces[f + 2]) += n;
+    }
+
+    for(Eigen::Index i = 0; i < normals.rows(); ++i)
+    {
+        double length = normals.row(i).norm();
+        if(length > 0.0) normals.row(i) /= length;
+    }
+    return normals;
+}
+
+inline uint64_t block_key(const uint32_t& row, const uint32_t& col)
+{
+    return (static_cast<uint64_t>(row) << 32) | col;
+}
+}    // namespace detail
+
+template<typename Scalar>
+struct NonRigidIterativeClosestPointT<Scalar>::KDTree
+    : public nanoflann::KDTreeEigenMatrixAdaptor<Matrix, 3, nanoflann::metric_L2_Simple>
+{
+    using nanoflann::KDTreeEigenMatrixAdaptor<Matrix, 3, nanoflann::metric_L2_Simple>::KDTreeEigenMatrixAdaptor;
+};
+
+template<typename Scalar>
+struct NonRigidIterativeClosestPointT<Scalar>::NodeTree
+    : public nanoflann::KDTreeEigenMatrixAdaptor<RowMatrixT<double>, 3, nanoflann::metric_L2_Simple>
+{
+    using nanoflann::KDTreeEigenMatrixAdaptor<RowMatrixT<double>, 3, nanoflann::metric_L2_Simple>::
+        KDTreeEigenMatrixAdaptor;
+};
+
+template<typename Scalar>
+NonRigidIterativeClosestPointT<Scalar>::NonRigidIterativeClosestPointT(const std::shared_ptr<Mesh>& source,
+                                                                       const std::shared_ptr<Mesh>& target,
+                                                                       const double& node_spacing,
+                                                                       const double& stiffness,
+                                                                       const double& trim,
+                                                                       const uint32_t& neighbors)
+    : RegistrationT<Scalar>::RegistrationT(detail::mesh_vertices(source), detail::mesh_vertices(target)),
+      node_spacing(node_spacing),
+      stiffness(stiffness),
+      trim(std::clamp(trim, 0.0, 1.0)),
+      neighbors(std::max(neighbors, 1u))
+{
+    // The source is never moved, so the tree stays valid for all iterations
+    tree           = std::make_shared<const KDTree>(3, std::cref(X));
+    source_normals = detail::vertex_normals(X.template cast<double>(), detail::mesh_faces(source));
+
+    faces    = detail::mesh_faces(target);
+    deformed = Y.template cast<double>();
+    if(M == 0) return;
+
+    if(this->node_spacing <= 0.0)
+        this->node_spacing = std::sqrt(target->total_area() / detail::NRICP_DEFAULT_NODES);
+
+    build_graph(target);
+    build_pattern();
+}
+
+template<typename Scalar>
+NonRigidIterativeClosestPointT<Scalar>::~NonRigidIterativeClosestPointT()
+{
+}
+
+template<typename Scalar>
+void NonRigidIterativeClosestPointT<Scalar>::solve(const uint32_t& maxN, const float& tol)
+{
+    this->beginSolve();
+    if(M == 0 || N == 0) return;
+
+    double weight = stiffness;
+    this->timed("correspond", [&]() { var = correspond(); });
+
+    this->iterate(maxN,
+                  [&]()
+                  {
+                      bool stepped = false;
+                      this->timed("step", [&]() { stepped = step(weight); });
+                      if(!stepped) return false;
+
+                      const double old_var = var;
+                      this->timed("correspond", [&]() { var = correspond(); });
+                      if(std::abs(old_var - var) > tol) return true;
+
+                      // Relax the graph once the fit stalls at the current stiffness
+                      if(weight <= stiffness * detail::NRICP_MIN_STIFFNESS) return false;
+                      weight *= 0.5;
+                      return true;
+                  });
+}
+
+template<typename Scalar>
+void NonRigidIterativeClosestPointT<Scalar>::build_graph(const std::shared_ptr<Mesh>& target)
+{
+    nodes     = voxel_downsample(detail::mesh_vertices(target), static_cast<float>(node_spacing))->asMatrix<double>();
+    node_tree = std::make_shared<const NodeTree>(3, std::cref(nodes));
+
+    const uint32_t K = static_cast<uint32_t>(nodes.rows());
+    neighbors        = std::min(neighbors, K);
+    bind(deformed, binding_nodes, binding_weights);
+
+    // Every node starts with the identity
+    parameters = Eigen::VectorXd::Zero(12 * K);
+    for(uint32_t k = 0; k < K; ++k)
+    {
+        parameters(12 * k)     = 1.0;
+        parameters(12 * k + 4) = 1.0;
+        parameters(12 * k + 8) = 1.0;
+    }
+
+    // The first node of a binding is the closest one. Two nodes are connected if a mesh edge joins two of their
+    // closest vertices
+    for(auto e_it = target->edges_begin(); e_it != target->edges_end(); ++e_it)
+    {
+        Mesh::HalfedgeHandle heh = target->halfedge_handle(*e_it, 0);
+        uint32_t a               = binding_nodes[neighbors * target->from_vertex_handle(heh).idx()];
+        uint32_t b               = binding_nodes[neighbors * target->to_vertex_handle(heh).idx()];
+        if(a != b) edges.emplace_back(std::max(a, b), std::min(a, b));
+    }
+    std::sort(edges.begin(), edges.end());
+    edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+}
+
+template<typename Scalar>
+void NonRigidIterativeClosestPointT<Scalar>::build_pattern()
+{
+    const uint32_t K = static_cast<uint32_t>(nodes.rows());
+    const uint32_t k = neighbors;
+
+    // A block couples two nodes that share a vertex or an edge
+    auto add = [&](const uint32_t& a, const uint32_t& b)
+    { blocks.try_emplace(detail::block_key(std::max(a, b), std::min(a, b)), static_cast<uint32_t>(blocks.size())); };
+    for(uint32_t j = 0; j < K; ++j) add(j, j);
+    for(const auto& edge: edges) add(edge.first, edge.second);
+    for(uint32_t m = 0; m < M; ++m)
+    {
+        for(uint32_t a = 0; a < k; ++a)
+        {
+            for(uint32_t b = 0; b < a; ++b) add(binding_nodes[m * k + a], binding_nodes[m * k + b]);
+        }
+    }
+
+    // Every vertex contributes once to the block of each pair of its nodes, the row node being the larger one
+    auto for_each_contribution = [&](const auto& func)
+    {
+        for(uint32_t m = 0; m < M; ++m)
+        {
+            for(uint32_t a = 0; a < k; ++a)
+            {
+                for(uint32_t b = 0; b < k; ++b)
+                {
+                    if(binding_nodes[m * k + a] < binding_nodes[m * k + b]) continue;
+                    func(block(binding_nodes[m * k + a], binding_nodes[m * k + b]),
+                         Contribution {m, uint8_t(a), uint8_t(b)});
+                }
+            }
+        }
+    };
+    contribution_start.assign(blocks.size() + 1, 0);
+    for_each_contribution([&](const uint32_t& s, const Contribution&) { ++contribution_start[s + 1]; });
+    for(size_t s = 0; s < blocks.size(); ++s) contribution_start[s + 1] += contribution_start[s];
+    contributions.resize(contribution_start.back());
+    std::vector<uint32_t> cursor(contribution_start.begin(), contribution_start.end() - 1);
+    for_each_contribution([&](const uint32_t& s, const Contribution& c) { contributions[cursor[s]++] = c; });
+
+    node_start.assign(K + 1, 0);
+    for(uint32_t i = 0; i < M * k; ++i) ++node_start[binding_nodes[i] + 1];
+    for(uint32_t j = 0; j < K; ++j) node_start[j + 1] += node_start[j];
+    node_vertices.resize(node_start.back());
+    cursor.assign(node_start.begin(), node_start.end() - 1);
+    for(uint32_t i = 0; i < M * k; ++i) node_vertices[cursor[binding_nodes[i]]++] = {i / k, i % k};
+
+    // Store every block densely, so a block column is a contiguous run of 12 entries
+    std::vector<Eigen::Triplet<double>> triplets;
+    triplets.reserve(144 * blocks.size());
+    for(const auto& entry: blocks)
+    {
+        uint32_t row = static_cast<uint32_t>(entry.first >> 32);
+        uint32_t col = static_cast<uint32_t>(entry.first & 0xFFFFFFFFu);
+        for(uint32_t j = 0; j < 12; ++j)
+        {
+            for(uint32_t i = 0; i < 12; ++i) triplets.emplace_back(12 * row + i, 12 * col + j, 0.0);
+        }
+    }
+    H.resize(12 * K, 12 * K);
+    H.setFromTriplets(triplets.begin(), triplets.end());
+    H.makeCompressed();
+
+    block_offsets.resize(12 * blocks.size());
+    for(const auto& entry: blocks)
+    {
+        Eigen::Index row = 12 * static_cast<Eigen::Index>(entry.first >> 32);
+        Eigen::Index col = 12 * static_cast<Eigen::Index>(entry.first & 0xFFFFFFFFu);
+        for(uint32_t j = 0; j < 12; ++j)
+        {
+            const int* first = H.innerIndexPtr() + H.outerIndexPtr()[col + j];
+            const int* last  = H.innerIndexPtr() + H.outerIndexPtr()[col + j + 1];
+            block_offsets[12 * entry.second + j] = std::lower_bound(first, last, row) - H.innerIndexPtr();
+        }
+    }
+
+    gradient.resize(12 * K);
+    solver.analyzePattern(H);
+}
+
+template<typename Scalar>
+uint32_t NonRigidIterativeClosestPointT<Scalar>::block(const uint32_t& row, const uint32_t& col) const
+{
+    return blocks.at(detail::block_key(row, col));
+}
+
+template<typename Scalar>
+void NonRigidIterativeClosestPointT<Scalar>::bind(const RowMatrixT<double>& points,
+                                                  std::vector<uint32_t>& indices,
+                                                  std::vector<double>& weights) const
+{
+    const size_t P   = points.rows();
+    const uint32_t k = neighbors;
+    indices.resize(P * k);
+    weights.resize(P * k);
+
+    ThreadPool::get()->parallel_for(
+        0,
+        P,
+        [&](size_t first, size_t last)
+        {
+            std::vector<Eigen::Index> found_indices(k + 1);
+            std::vector<double> distances(k + 1);
+            for(size_t p = first; p < last; ++p)
+            {
+                size_t found =
+                    node_tree->index_->knnSearch(points.row(p).data(), k + 1, found_indices.data(), distances.data());
+
+                // The weights fall off towards the next node that is not bound (Sumner et al. 2007)
+                double d_max = std::sqrt(distances[std::min<size_t>(k, found - 1)]);
+                double sum   = 0.0;
+                for(uint32_t j = 0; j < k; ++j)
+                {
+                    double w           = d_max > 0.0 ? std::pow(1.0 - std::sqrt(distances[j]) / d_max, 2) : 1.0;
+                    indices[p * k + j] = static_cast<uint32_t>(found_indices[j]);
+                    weights[p * k + j] = w;
+                    sum += w;
+                }
+                for(uint32_t j = 0; j < k; ++j) weights[p * k + j] = sum > 0.0 ? weights[p * k + j] / sum : 1.0 / k;
+            }
+        });
+}
+
+template<typename Scalar>
+RowMatrixT<double> NonRigidIterativeClosestPointT<Scalar>::deform(const RowMatrixT<double>& points,
+                                                                  const std::vector<uint32_t>& indices,
+                                                                  const std::vector<double>& weights) const
+{
+    // v -> sum_j w_j * (A_j * (v - g_j) + g_j + t_j)
+    const uint32_t k          = neighbors;
+    RowMatrixT<double> result = RowMatrixT<double>::Zero(points.rows(), 3);
+    ThreadPool::get()->parallel_for(
+        0,
+        points.rows(),
+        [&](size_t first, size_t last)
+        {
+            for(size_t p = first; p < last; ++p)
+            {
+                Eigen::Vector3d v = Eigen::Vector3d::Zero();
+                for(uint32_t j = 0; j < k; ++j)
+                {
+                    const uint32_t node = indices[p * k + j];
+                    Eigen::Map<const Eigen::Matrix3d> A(parameters.data() + 12 * node);
+                    Eigen::Vector3d g = nodes.row(node).transpose();
+                    v += weights[p * k + j] *
+                         (A * (points.row(p).transpose() - g) + g + parameters.template segment<3>(12 * node + 9));
+                }
+                result.row(p) = v.transpose();
+            }
+        });
+    return result;
+}
+
+template<typename Scalar>
+double NonRigidIterativeClosestPointT<Scalar>::correspond()
+{
+    const RowMatrixT<double> normals = detail::vertex_normals(deformed, faces);
+    std::vector<double> distance(M);
+    std::vector<uint32_t> correspondence(M);
+    residuals.resize(M);
+    metrics.resize(M);
+
+    ThreadPool::get()->parallel_for(
+        0,
+        M,
+        [&](size_t first, size_t last)
+        {
+            for(size_t m = first; m < last; ++m)
+            {
+                Eigen::Matrix<Scalar, 3, 1> q = deformed.row(m).transpose().template cast<Scalar>();
+
+                Eigen::Index index = 0;
+                Scalar d           = 0;
+                tree->index_->knnSearch(q.data(), 1, &index, &d);
+                correspondence[m] = static_cast<uint32_t>(index);
+                residuals[m]      = deformed.row(m).transpose() -
+                               X.template block<1, 3>(index, 0).transpose().template cast<double>();
+
+                double cosine = std::abs(normals.row(m).dot(source_normals.row(index)));
+                distance[m]   = cosine >= detail::NRICP_NORMAL_COMPATIBILITY ? residuals[m].squaredNorm()
+                                                                             : std::numeric_limits<double>::infinity();
+            }
+        });
+
+    // Trimming: keep the closest ceil(trim * M) compatible correspondences, but at least one
+    double threshold = std::numeric_limits<double>::max();
+    size_t count     = std::max<size_t>(static_cast<size_t>(std::ceil(trim * M)), 1);
+    if(count < M)
+    {
+        std::vector<double> sorted(distance);
+        std::nth_element(sorted.begin(), sorted.begin() + (count - 1), sorted.end());
+        threshold = sorted[count - 1];
+    }
+
+    double sum = 0.0;
+    kept       = 0;
+    for(uint32_t m = 0; m < M; ++m)
+    {
+        if(!(distance[m] <= threshold))
+        {
+            metrics[m].setZero();
+            continue;
+        }
+
+        Eigen::Vector3d normal = source_normals.row(correspondence[m]).transpose();
+        metrics[m]             = detail::NRICP_POINT_WEIGHT * Eigen::Matrix3d::Identity() +
+                     detail::NRICP_PLANE_WEIGHT * normal * normal.transpose();
+        sum += distance[m];
+        ++kept;
+    }
+
+    return kept == 0 ? 0.0 : sum / (3.0 * kept);
+}
+
+template<typename Scalar>
+bool NonRigidIterativeClosestPointT<Scalar>::step(const double& weight)
+{
+    // The unknowns of node j are [a_1, a_2, a_3, t] with the columns a_i of A_j. A point A_j * (v - g_j) + g_j + t_j
+    // has the Jacobian kron(e^T, I) with e = [v - g_j, 1]. So every term adds blocks kron(e_r * e_c^T, W) to the normal
+    // equations, W being the 3x3 metric of its residual. The energies are normalized by their number of terms and the
+    // squared node spacing, so the weights do not depend on the resolution or the scale of the meshes
+    const uint32_t K          = static_cast<uint32_t>(nodes.rows());
+    const uint32_t k          = neighbors;
+    const double s2           = node_spacing * node_spacing;
+    const double fit_scale    = kept == 0 ? 0.0 : 1.0 / (kept * s2);
+    const double smooth_scale = edges.empty() ? 0.0 : weight / (2.0 * edges.size() * s2);
+    const double rigid_scale  = detail::NRICP_RIGIDITY_RATIO * weight / K;
+
+    double* values = H.valuePtr();
+    std::fill(values, values + H.nonZeros(), 0.0);
+    gradient.setZero();
+
+    auto add_block = [&](const uint32_t& s, const Eigen::Matrix4d& E, const Eigen::Matrix3d& W)
+    {
+        for(uint32_t b = 0; b < 4; ++b)
+        {
+            for(uint32_t c = 0; c < 3; ++c)
+            {
+                double* column = values + block_offsets[12 * s + 3 * b + c];
+                for(uint32_t a = 0; a < 4; ++a)
+                {
+                    for(uint32_t r = 0; r < 3; ++r) column[3 * a + r] += E(a, b) * W(r, c);
+                }
+            }
+        }
+    };
+
+    // Weighted lever e of a target vertex and one of its nodes
+    auto lever = [&](const uint32_t& m, const uint32_t& slot)
+    {
+        const uint32_t node = binding_nodes[m * k + slot];
+        Eigen::Vector4d e;
+        e.template head<3>() =
+            Y.template block<1, 3>(m, 0).transpose().template cast<double>() - nodes.row(node).transpose();
+        e(3)                 = 1.0;
+        return Eigen::Vector4d(binding_weights[m * k + slot] * e);
+    };
+
+    // Fit
+    ThreadPool::get()->parallel_for(
+        0,
+        blocks.size(),
+        [&](size_t first, size_t last)
+        {
+            for(size_t s = first; s < last; ++s)
+            {
+                for(uint32_t i = contribution_start[s]; i < contribution_start[s + 1]; ++i)
+                {
+                    const Contribution& c = contributions[i];
+                    if(metrics[c.vertex].isZero()) continue;
+                    add_block(static_cast<uint32_t>(s),
+                              fit_scale * lever(c.vertex, c.row) * lever(c.vertex, c.col).transpose(),
+                              metrics[c.vertex]);
+                }
+            }
+        });
+
+    ThreadPool::get()->parallel_for(
+        0,
+        K,
+        [&](size_t first, size_t last)
+        {
+            for(size_t j = first; j < last; ++j)
+            {
+                for(uint32_t i = node_start[j]; i < node_start[j + 1]; ++i)
+                {
+                    const uint32_t m = node_vertices[i].first;
+                    if(metrics[m].isZero()) continue;
+
+                    Eigen::Vector4d e  = lever(m, node_vertices[i].second);
+                    Eigen::Vector3d Wr = fit_scale * metrics[m] * residuals[m];
+                    for(uint32_t a = 0; a < 4; ++a) gradient.template segment<3>(12 * j + 3 * a) += e(a) * Wr;
+                }
+            }
+        });
+
+    // Smoothness: A_j * (g_l - g_j) + g_j + t_j should hit g_l + t_l for both directions of every edge
+    const Eigen::Vector4d f(0.0, 0.0, 0.0, -1.0);
+    const Eigen::Matrix3d I = Eigen::Matrix3d::Identity();
+    for(const auto& edge: edges)
+    {
+        for(uint32_t direction = 0; direction < 2; ++direction)
+        {
+            const uint32_t j = direction == 0 ? edge.first : edge.second;
+            const uint32_t l = direction == 0 ? edge.second : edge.first;
+
+            Eigen::Map<const Eigen::Matrix3d> A(parameters.data() + 12 * j);
+            Eigen::Vector3d d = (nodes.row(l) - nodes.row(j)).transpose();
+            Eigen::Vector3d r =
+                A * d - d + parameters.template segment<3>(12 * j + 9) - parameters.template segment<3>(12 * l + 9);
+            Eigen::Vector4d e(d(0), d(1), d(2), 1.0);
+
+            add_block(block(j, j), smooth_scale * e * e.transpose(), I);
+            add_block(block(l, l), smooth_scale * f * f.transpose(), I);
+            if(j > l)
+                add_block(block(j, l), smooth_scale * e * f.transpose(), I);
+            else
+                add_block(block(l, j), smooth_scale * f * e.transpose(), I);
+
+            for(uint32_t a = 0; a < 4; ++a)
+            {
+                gradient.template segment<3>(12 * j + 3 * a) += smooth_scale * e(a) * r;
+                gradient.template segment<3>(12 * l + 3 * a) += smooth_scale * f(a) * r;
+            }
+        }
+    }
+
+    // Rigidity: the columns of A_j should be orthonormal
+    ThreadPool::get()->parallel_for(
+        0,
+        K,
+        [&](size_t first, size_t last)
+        {
+            for(size_t j = first; j < last; ++j)
+            {
+                Eigen::Map<const Eigen::Matrix3d> A(parameters.data() + 12 * j);
+                Eigen::Vector3d c1 = A.col(0), c2 = A.col(1), c3 = A.col(2);
+
+                Eigen::Matrix<double, 6, 1> r;
+                r << c1.dot(c2), c1.dot(c3), c2.dot(c3), c1.dot(c1) - 1.0, c2.dot(c2) - 1.0, c3.dot(c3) - 1.0;
+
+                Eigen::Matrix<double, 6, 9> J = Eigen::Matrix<double, 6, 9>::Zero();
+                J.template block<1, 3>(0, 0) = c2.transpose();
+                J.template block<1, 3>(0, 3) = c1.transpose();
+                J.template block<1, 3>(1, 0) = c3.transpose();
+                J.template block<1, 3>(1, 6) = c1.transpose();
+                J.template block<1, 3>(2, 3) = c3.transpose();
+                J.template block<1, 3>(2, 6) = c2.transpose();
+                J.template block<1, 3>(3, 0) = 2.0 * c1.transpose();
+                J.template block<1, 3>(4, 3) = 2.0 * c2.transpose();
+                J.template block<1, 3>(5, 6) = 2.0 * c3.transpose();
+
+                Eigen::Matrix<double, 9, 9> JTJ = rigid_scale * J.transpose() * J;
+                const uint32_t s                = block(j, j);
+                for(uint32_t c = 0; c < 9; ++c)
+                {
+                    for(uint32_t i = 0; i < 9; ++i) values[block_offsets[12 * s + c] + i] += JTJ(i, c);
+                }
+                gradient.template segment<9>(12 * j) += rigid_scale * J.transpose() * r;
+            }
+        });
+
+    double trace = 0.0;
+    for(uint32_t j = 0; j < K; ++j)
+    {
+        const uint32_t s = block(j, j);
+        for(uint32_t i = 0; i < 12; ++i) trace += values[block_offsets[12 * s + i] + i];
+    }
+    const double mean = trace / (12.0 * K);
+    for(uint32_t j = 0; j < K; ++j)
+    {
+        const uint32_t s = block(j, j);
+        for(uint32_t i = 0; i < 12; ++i)
+        {
+            double& diagonal = values[block_offsets[12 * s + i] + i];
+            diagonal += detail::NRICP_DAMPING * (diagonal + mean);
+        }
+    }
+
+    // The pattern never changes, so the symbolic factorization from build_pattern is reused
+    solver.factorize(H);
+    Eigen::VectorXd delta;
+    if(solver.info() == Eigen::Success) delta = solver.solve(-gradient);
+    if(solver.info() != Eigen::Success || !delta.allFinite())
+    {
+        std::cerr << "Could not solve the normal equations of the deformation graph, non-rigid ICP stops!\n";
+        return false;
+    }
+
+    parameters += delta;
+    deformed = deform(Y.template cast<double>(), binding_nodes, binding_weights);
+    return true;
+}
+
+template<typename Scalar>
+typename NonRigidIterativeClosestPointT<Scalar>::Matrix
+NonRigidIterativeClosestPointT<Scalar>::transformedTarget() const
+{
+    return deformed.template cast<Scalar>();
+}
+
+template<typename Scalar>
+void NonRigidIterativeClosestPointT<Scalar>::applyTransform(const std::shared_ptr<PointCloud>& cloud)
+{
+    if(cloud->n_vertices() != M) cloud->resize(M);
+    cloud->points() = deformed.cast<float>();
+}
+
+template<typename Scalar>
+void NonRigidIterativeClosestPointT<Scalar>::applyTransform(const std::shared_ptr<Mesh>& mesh)
+{
+    if(mesh->n_vertices() != M)
+    {
+        std::cerr << "The mesh has " << mesh->n_vertices() << " vertices but the target has " << M
+                  << ", use applyDeformation to deform other meshes!\n";
+        return;
+    }
+
+    detail::set_mesh_vertices(mesh, deformed);
+}
+
+template<typename Scalar>
+void NonRigidIterativeClosestPointT<Scalar>::applyDeformation(const std::shared_ptr<PointCloud>& cloud)
+{
+    std::vector<uint32_t> indices;
+    std::vector<double> weights;
+    RowMatrixT<double> points = cloud->asMatrix<double>();
+    bind(points, indices, weights);
+    cloud->points() = deform(points, indices, weights).template cast<float>();
+}
+
+template<typename Scalar>
+void NonRigidIterativeClosestPointT<Scalar>::applyDeformation(const std::shared_ptr<Mesh>& mesh)
+{
+    std::vector<uint32_t> indices;
+    std::vector<double> weights;
+    RowMatrixT<double> points = detail::mesh_vertices(mesh)->asMatrix<double>();
+    bind(points, indices, weights);
+    detail::set_mesh_vertices(mesh, deform(points, indices, weights));
+}
+
+template class NonRigidIterativeClosestPointT<double>;
+template class NonRigidIterativeClosestPointT<float>;
+}    // namespace atcg
@@ -0,0 +1,125 @@
+#include <Registration/Normals.h>
+
+#include <Core/ThreadPool.h>
+
+#include <Eigen/Eigenvalues>
+#include <nanoflann.hpp>
+
+#include <algorithm>
+
+namespace atcg
+{
+namespace detail
+{
+using PointTree = nanoflann::KDTreeEigenMatrixAdaptor<RowMatrixT<double>, 3, nanoflann::metric_L2_Simple>;
+}    // namespace detail
+
+std::vector<Eigen::Index> nearest_neighbors(const RowMatrixT<double>& points, const uint32_t& neighbors)
+{
+    const size_t N = points.rows();
+    const size_t K = std::min<size_t>(neighbors, N > 0 ? N - 1 : 0);
+
+    detail::PointTree tree(3, std::cref(points));
+    std::vector<Eigen::Index> result(N * K);
+    ThreadPool::get()->parallel_for(
+        0,
+        N,
+        [&](size_t first, size_t last)
+        {
+            std::vector<Eigen::Index> indices(K + 1);
+            std::vector<double> distances(K + 1);
+            for(size_t n = first; n < last; ++n)
+            {
+                size_t found = tree.index_->knnSearch(points.row(n).data(), K + 1, indices.data(), distances.data());
+
+                // The point itself is usually the first result, but duplicates may come first
+                size_t k = 0;
+                for(size_t i = 0; i < found && k < K; ++i)
+                {
+                    if(indices[i] != static_cast<Eigen::Index>(n)) result[n * K + k++] = indices[i];
+                }
+                for(; k < K; ++k) result[n * K + k] = static_cast<Eigen::Index>(n);
+            }
+        });
+    return result;
+}
+
+RowMatrixT<double> estimate_normals(const RowMatrixT<double>& points, const uint32_t& neighbors)
+{
+    const size_t N                      = points.rows();
+    const size_t K                      = std::min<size_t>(neighbors, N > 0 ? N - 1 : 0);
+    const std::vector<Eigen::Index> knn = nearest_neighbors(points, neighbors);
+    const Eigen::RowVector3d centroid   = points.colwise().mean();
+
+    RowMatrixT<double> normals(N, 3);
+    ThreadPool::get()->parallel_for(
+        0,
+        N,
+        [&](size_t first, size_t last)
+        {
+            for(size_t n = first; n < last; ++n)
+            {
+                Eigen::RowVector3d mean = points.row(n);
+                for(size_t k = 0; k < K; ++k) mean += points.row(knn[n * K + k]);
+                mean /= static_cast<double>(K + 1);
+
+                Eigen::Matrix3d covariance = (points.row(n) - mean).transpose() * (points.row(n) - mean);
+                for(size_t k = 0; k < K; ++k)
+                {
+                    Eigen::RowVector3d d = points.row(knn[n * K + k]) - mean;
+                    covariance += d.transpose() * d;
+                }
+
+                Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> eigen;
+                eigen.computeDirect(covariance);
+                Eigen::RowVector3d normal = eigen.eigenvectors().col(0).transpose();
+                if(normal.dot(points.row(n) - centroid) < 0.0) normal = -normal;
+                normals.row(n) = normal;
+            }
+        });
+    return normals;
+}
+
+void estimate_normals(const std::shared_ptr<ChunkedPointCloud>& cloud, const float& margin, const uint32_t& neighbors)
+{
+    const Eigen::Vector3d center = cloud->bounds().center().cast<double>();
+    cloud->for_each_chunk(
+        [&](size_t index, PointCloud& chunk)
+        {
+            const size_t count = chunk.n_vertices();
+            if(count == 0) return;
+
+            Eigen::AlignedBox3f box = cloud->info(index).bounds;
+            box.min().array() -= margin;
+            box.max().array() += margin;
+
+            // The points of the chunk come first, the neighbors from the other chunks are appended
+            std::vector<Eigen::RowVector3d> border;
+            for(size_t other: cloud->query(box))
+            {
+                if(other == index) continue;
+
+                std::shared_ptr<PointCloud> neighbor = cloud->chunk(other);
+                const auto points                    = neighbor->cpoints();
+                for(size_t i = 0; i < neighbor->n_vertices(); ++i)
+                {
+                    if(box.contains(points.row(i).transpose())) border.push_back(points.row(i).cast<double>());
+                }
+            }
+
+            RowMatrixT<double> points(count + border.size(), 3);
+            points.topRows(count) = chunk.cpoints().cast<double>();
+            for(size_t i = 0; i < border.size(); ++i) points.row(count + i) = border[i];
+
+            RowMatrixT<double> normals = estimate_normals(points, neighbors);
+            auto target                = chunk.normals();
+            for(size_t i = 0; i < count; ++i)
+            {
+                Eigen::RowVector3d normal = normals.row(i);
+                if(normal.dot(points.row(i) - center.transpose()) < 0.0) normal = -normal;
+                target.row(i) = normal.cast<float>();
+            }
+        },
+        true);
+}
+}    // namespace atcg
\ No newline at end of file
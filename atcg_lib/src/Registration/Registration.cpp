@@ -1,12 +1,179 @@
 #include <Registration/Registration.h>
+#include <Registration/GaussianKernel.h>
+
+#include <Core/ThreadPool.h>
+
+#include <iostream>
 
 namespace atcg
 {
-Registration::Registration(const std::shared_ptr<PointCloud>& source, const std::shared_ptr<PointCloud>& target)
-    : X(source->asMatrix()),
-      Y(target->asMatrix())
+template<typename Scalar>
+RegistrationT<Scalar>::RegistrationT(const std::shared_ptr<PointCloud>& source,
+                                     const std::shared_ptr<PointCloud>& target)
+    : X(source->asMatrix<Scalar>()),
+      target_points(target->sharedMatrix<Scalar>()),
+      Y(*target_points)
+{
+    N = static_cast<uint32_t>(X.rows());
+    M = static_cast<uint32_t>(Y.rows());
+
+    target_mean   = Y.template cast<double>().colwise().mean();
+    target_spread = (Y.template cast<double>().rowwise() - target_mean).squaredNorm() / static_cast<double>(M);
+}
+
+template<typename Scalar>
+RegistrationT<Scalar>::RegistrationT(const std::shared_ptr<PointCloud>& source, const RegistrationT<Scalar>& reference)
+    : X(source->asMatrix<Scalar>()),
+      target_points(reference.target_points),
+      Y(*target_points),
+      target_mean(reference.target_mean),
+      target_spread(reference.target_spread)
 {
     N = static_cast<uint32_t>(X.rows());
     M = static_cast<uint32_t>(Y.rows());
 }
+
+template<typename Scalar>
+void RegistrationT<Scalar>::setSource(const std::shared_ptr<PointCloud>& source)
+{
+    X = source->asMatrix<Scalar>();
+    N = static_cast<uint32_t>(X.rows());
+}
+
+template<typename Scalar>
+double RegistrationT<Scalar>::initialVariance() const
+{
+    // sum_n sum_m ||x_n - y_m||^2 = M * sum_n ||x_n - uX||^2 + N * sum_m ||y_m - uY||^2 + N * M * ||uX - uY||^2
+    // The target moments are computed once in the constructor
+    Eigen::RowVector3d uX = X.template cast<double>().colwise().mean();
+
+    double sum_X = (X.template cast<double>().rowwise() - uX).squaredNorm();
+
+    return (sum_X / static_cast<double>(N) + target_spread + (uX - target_mean).squaredNorm()) / 3.0;
+}
+
+template<typename Scalar>
+double RegistrationT<Scalar>::startVariance()
+{
+    const double result = start_var > 0.0 ? start_var : initialVariance();
+    start_var           = 0.0;
+    return result;
+}
+
+template<typename Scalar>
+std::future<void> RegistrationT<Scalar>::solveAsync(const uint32_t& maxN, const float& tol)
+{
+    cancel_requested  = false;
+    snapshots_enabled = true;
+    return ThreadPool::get()->push(
+        [this, maxN, tol]()
+        {
+            solve(maxN, tol);
+            snapshots_enabled = false;
+        });
+}
+
+template<typename Scalar>
+bool RegistrationT<Scalar>::getSnapshot(RegistrationSnapshot<Scalar>& snapshot)
+{
+    std::lock_guard<std::mutex> lock(snapshot_mutex);
+    if(!snapshot_fresh) return false;
+
+    std::swap(snapshot, snapshot_front);
+    snapshot_fresh = false;
+    return true;
+}
+
+template<typename Scalar>
+void RegistrationT<Scalar>::publish(const uint32_t& iteration)
+{
+    iterations = iteration;
+    if(verbose) std::cout << "Iteration: " << iteration << "\tvariance: " << var << "\n";
+    if(!snapshots_enabled) return;
+
+    // The expensive part happens outside of the lock, readers only wait for the swap
+    snapshot_back.iteration = iteration;
+    snapshot_back.variance  = var;
+    snapshot_back.points    = transformedTarget();
+
+    std::lock_guard<std::mutex> lock(snapshot_mutex);
+    std::swap(snapshot_back, snapshot_front);
+    snapshot_fresh = true;
+}
+
+template<typename Scalar>
+void RegistrationT<Scalar>::beginSolve()
+{
+    // A synchronous solve starts without a pending cancel. solveAsync clears the request before it queues the solve, so
+    // a cancel that arrives before the queued solve starts is kept
+    iterations = 0;
+    statistics.clear();
+    if(!snapshots_enabled) cancel_requested = false;
+}
+
+template<typename Scalar>
+void RegistrationT<Scalar>::iterate(const uint32_t& maxN, const std::function<bool()>& step)
+{
+    uint32_t n = 0;
+    settled(n);
+    while(n < maxN && !cancelled())
+    {
+        ++n;
+        const bool proceed = step();
+
+        publish(n);
+        if(!proceed || settled(n)) break;
+    }
+
+    report();
+}
+
+template<typename Scalar>
+void RegistrationT<Scalar>::expectationMaximization(const uint32_t& maxN,
+                                                    const float& tol,
+                                                    const std::function<void(double)>& estimate,
+                                                    const std::function<double(double)>& maximize)
+{
+    // Tiny gaussians would otherwise be processed as denormals, especially in single precision
+    DenormalGuard guard;
+
+    beginSolve();
+    var = startVariance();
+
+    iterate(maxN,
+            [&]()
+            {
+                timed("estimate", [&]() { estimate(var); });
+
+                const double old_var = var;
+                timed("maximize", [&]() { var = maximize(var); });
+                return std::abs(old_var - var) > tol;
+            });
+}
+
+template<typename Scalar>
+bool RegistrationT<Scalar>::settled(const uint32_t& iteration)
+{
+    if(motion_tolerance <= 0.0) return false;
+
+    Matrix points = transformedTarget();
+    bool result   = false;
+    if(iteration > 0 && settled_points.rows() == points.rows())
+    {
+        double motion = (points - settled_points).template cast<double>().squaredNorm() / static_cast<double>(M);
+        result        = motion < motion_tolerance * motion_tolerance;
+    }
+    settled_points = std::move(points);
+    return result;
+}
+
+template<typename Scalar>
+void RegistrationT<Scalar>::report() const
+{
+    if(!verbose) return;
+    for(const Statistic<float>& statistic: statistics) std::cout << statistic;
+}
+
+template class RegistrationT<float>;
+template class RegistrationT<double>;
 }    // namespace atcg
\ No newline at end of file
@@ -0,0 +1,343 @@
+#include <Registration/CPD.h>
+#include <Registration/AffineCPD.h>
+#include <Registration/NonRigidCPD.h>
+#include <Registration/ICP.h>
+#include <Registration/NDT.h>
+#include <Registration/NonRigidICP.h>
+#include <Core/ThreadPool.h>
+
+#include <glm/ext/scalar_constants.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Scaling benchmark of the registration algorithms.
+// Every scenario generates a target on a bumpy ellipsoid and a source that is a rigidly moved, independent sample of the
+// same surface. Both are triangulated for the solvers that need meshes. The registrations move the target onto the
+// source, so the error of every target point is its distance to the ground truth position. The setup (construction and
+// prepare, e.g. kd-trees, normals or the motion coherence matrix) and the solve are timed separately. Every solver has
+// a size limit above which it is skipped, only ICP runs up to a million points. The results are printed as JSON to
+// stdout. The duplicates scenario rounds the source to a coarse grid, so many of its points coincide and the fast gauss
+// transform sees fewer distinct points than clusters. A non-finite error fails the run with exit code 1.
+//
+// Usage: registrationScaling [--sizes 1000,10000,...] [--max-iterations N] [--tol T] [--filter text] [--output file]
+
+namespace
+{
+struct Scenario
+{
+    std::string name;
+    double noise    = 0.0;    // Standard deviation of the gaussian noise on the source
+    double outliers = 0.0;    // Fraction of uniformly distributed outliers added to the source
+    double quantize = 0.0;    // Grid spacing the source is rounded to, so that many of its points coincide
+};
+
+// A sample of the surface. Outliers are vertices without faces
+struct Surface
+{
+    std::vector<Eigen::Vector3d> points;
+    std::vector<uint32_t> faces;    // Three vertex indices per triangle
+};
+
+// The registrations differ in their scalar type, so they are run through callbacks
+struct Run
+{
+    std::function<void()> prepare;
+    std::function<void(const uint32_t&, const float&)> solve;
+    std::function<void(const std::shared_ptr<atcg::PointCloud>&)> applyTransform;
+    std::function<uint32_t()> iterations;
+};
+
+struct Case
+{
+    std::string solver;
+    std::string backend;
+    uint32_t max_points;    // Larger clouds are skipped, the cost of the solver grows too fast
+    std::function<Run(const Surface&, const Surface&)> create;
+};
+
+std::shared_ptr<atcg::PointCloud> to_cloud(const std::vector<Eigen::Vector3d>& points)
+{
+    auto cloud = std::make_shared<atcg::PointCloud>();
+    cloud->resize(points.size());
+    auto view = cloud->points();
+    for(size_t i = 0; i < points.size(); ++i) view.row(i) = points[i].transpose().cast<float>();
+    return cloud;
+}
+
+std::shared_ptr<atcg::Mesh> to_mesh(const Surface& surface)
+{
+    auto mesh = std::make_shared<atcg::Mesh>();
+    std::vector<atcg::Mesh::VertexHandle> vertices;
+    for(const Eigen::Vector3d& p: surface.points)
+    {
+        vertices.push_back(mesh->add_vertex(
+            atcg::Mesh::Point(static_cast<float>(p.x()), static_cast<float>(p.y()), static_cast<float>(p.z()))));
+    }
+    for(size_t f = 0; f < surface.faces.size(); f += 3)
+    {
+        mesh->add_face(vertices[surface.faces[f]], vertices[surface.faces[f + 1]], vertices[surface.faces[f + 2]]);
+    }
+    return mesh;
+}
+
+// The registration is created from point clouds, or from meshes if Input is atcg::Mesh
+template<class RegistrationType, class Input = atcg::PointCloud, typename... Args>
+std::function<Run(const Surface&, const Surface&)> factory(const Args&... args)
+{
+    return [args...](const Surface& source, const Surface& target)
+    {
+        std::shared_ptr<RegistrationType> registration;
+        if constexpr(std::is_same_v<Input, atcg::Mesh>)
+            registration = std::make_shared<RegistrationType>(to_mesh(source), to_mesh(target), args...);
+        else
+            registration =
+                std::make_shared<RegistrationType>(to_cloud(source.points), to_cloud(target.points), args...);
+
+        Run run;
+        run.prepare        = [registration]() { registration->prepare(); };
+        run.solve          = [registration](const uint32_t& maxN, const float& tol) { registration->solve(maxN, tol); };
+        run.applyTransform = [registration](const std::shared_ptr<atcg::PointCloud>& cloud)
+        { registration->applyTransform(cloud); };
+        run.iterations = [registration]() { return registration->getIterations(); };
+        return run;
+    };
+}
+
+// The point of the surface in the given direction from its center
+Eigen::Vector3d surface_point(const Eigen::Vector3d& direction)
+{
+    Eigen::Vector3d d = direction.normalized();
+    d *= 1.0 + 0.15 * std::sin(4.0 * d.x()) * std::sin(3.0 * d.y()) * std::sin(5.0 * d.z());
+    return Eigen::Vector3d(1.5 * d.x(), d.y(), 0.6 * d.z());
+}
+
+// Samples the surface on rings of constant latitude with about n vertices in total and triangulates the rings. The
+// offset in [0, 1) moves the samples by a fraction of the grid spacing, so grids with different offsets are independent
+// samples of the surface. The poles are left open
+Surface sample_surface(const uint32_t& n, const double& offset)
+{
+    const double pi         = glm::pi<double>();
+    const uint32_t rings    = std::max(2u, static_cast<uint32_t>(std::lround(std::sqrt(n / 2.0))));
+    const uint32_t segments = std::max(3u, n / rings);
+
+    Surface surface;
+    for(uint32_t i = 0; i < rings; ++i)
+    {
+        const double theta = pi * (i + 0.25 + 0.5 * offset) / rings;
+        for(uint32_t j = 0; j < segments; ++j)
+        {
+            const double phi = 2.0 * pi * (j + offset) / segments;
+            surface.points.push_back(surface_point(
+                Eigen::Vector3d(std::sin(theta) * std::cos(phi), std::sin(theta) * std::sin(phi), std::cos(theta))));
+        }
+    }
+
+    for(uint32_t i = 0; i + 1 < rings; ++i)
+    {
+        for(uint32_t j = 0; j < segments; ++j)
+        {
+            const uint32_t a = i * segments + j;
+            const uint32_t b = i * segments + (j + 1) % segments;
+            surface.faces.insert(surface.faces.end(), {a, a + segments, b, b, a + segments, b + segments});
+        }
+    }
+    return surface;
+}
+
+// Peak resident memory since the last reset in MiB, -1 if it is not available. Memory that the allocator kept from
+// earlier runs is included
+double peak_memory()
+{
+#ifdef __linux__
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while(std::getline(status, line))
+    {
+        if(line.rfind("VmHWM:", 0) == 0) return std::stod(line.substr(6)) / 1024.0;
+    }
+#endif
+    return -1.0;
+}
+
+void reset_peak_memory()
+{
+#ifdef __linux__
+    std::ofstream("/proc/self/clear_refs") << "5";
+#endif
+}
+
+// JSON has no representation of NaN and infinity
+std::string number(const double& value)
+{
+    if(!std::isfinite(value)) return "null";
+    std::ostringstream stream;
+    stream << value;
+    return stream.str();
+}
+
+std::vector<uint32_t> parse_sizes(const std::string& text)
+{
+    std::vector<uint32_t> sizes;
+    std::stringstream stream(text);
+    std::string item;
+    while(std::getline(stream, item, ',')) sizes.push_back(static_cast<uint32_t>(std::stoul(item)));
+    return sizes;
+}
+}    // namespace
+
+int main(int argc, char** argv)
+{
+    std::vector<uint32_t> sizes = {1000, 10000, 100000, 1000000};
+    uint32_t max_iterations     = 100;
+    float tol                   = 1e-6f;
+    std::string filter;
+    std::string output;
+    for(int i = 1; i + 1 < argc; i += 2)
+    {
+        std::string option = argv[i];
+        if(option == "--sizes")
+            sizes = parse_sizes(argv[i + 1]);
+        else if(option == "--max-iterations")
+            max_iterations = static_cast<uint32_t>(std::stoul(argv[i + 1]));
+        else if(option == "--tol")
+            tol = std::stof(argv[i + 1]);
+        else if(option == "--filter")
+            filter = argv[i + 1];
+        else if(option == "--output")
+            output = argv[i + 1];
+    }
+
+    using atcg::EStepMethod;
+    using atcg::ICPMethod;
+    using atcg::MotionCoherenceMethod;
+    const std::vector<Scenario> scenarios = {{"rigid", 0.0, 0.0},
+                                             {"noise", 0.01, 0.0},
+                                             {"outliers", 0.01, 0.1},
+                                             {"duplicates", 0.0, 0.0, 0.2}};
+    const std::vector<Case> cases         = {
+        {"cpd", "direct", 20000, factory<atcg::CoherentPointDrift>(0.1, EStepMethod::Direct)},
+        {"cpd", "direct-float", 20000, factory<atcg::CoherentPointDriftT<float, double>>(0.1, EStepMethod::Direct)},
+        {"cpd", "fgt", 100000, factory<atcg::CoherentPointDrift>(0.1, EStepMethod::FastGaussTransform)},
+        {"affine", "direct", 20000, factory<atcg::AffineCoherentPointDrift>(0.1, EStepMethod::Direct)},
+        {"affine", "fgt", 100000, factory<atcg::AffineCoherentPointDrift>(0.1, EStepMethod::FastGaussTransform)},
+        {"nonrigid", "dense", 2000, factory<atcg::NonRigidCoherentPointDrift>(0.1, MotionCoherenceMethod::Dense)},
+        {"nonrigid", "lowrank", 20000, factory<atcg::NonRigidCoherentPointDrift>(0.1, MotionCoherenceMethod::LowRank)},
+        {"nonrigid", "iterative", 5000, factory<atcg::NonRigidCoherentPointDrift>(0.1, MotionCoherenceMethod::Iterative)},
+        {"nonrigid", "sparse", 20000, factory<atcg::NonRigidCoherentPointDrift>(0.1, MotionCoherenceMethod::Sparse)},
+        {"icp", "point-to-point", 1000000, factory<atcg::IterativeClosestPoint>(ICPMethod::PointToPoint)},
+        {"icp", "point-to-plane", 1000000, factory<atcg::IterativeClosestPoint>(ICPMethod::PointToPlane)},
+        {"ndt", "direct", 1000000, factory<atcg::NormalDistributionsTransform>(0.5)},
+        {"nonrigid-icp", "graph", 100000, factory<atcg::NonRigidIterativeClosestPoint, atcg::Mesh>()},
+    };
+
+    const Eigen::Matrix3d R = Eigen::AngleAxisd(0.35, Eigen::Vector3d(1, 2, 3).normalized()).toRotationMatrix();
+    const Eigen::Vector3d t(0.1, -0.05, 0.2);
+
+    std::ostringstream json;
+
+    json << "{\n  \"threads\": " << atcg::ThreadPool::get()->num_threads() + 1 << ",\n  \"max_points\": {";
+    for(size_t i = 0; i < cases.size(); ++i)
+    {
+        json << (i == 0 ? "" : ", ") << "\"" << cases[i].solver << "/" << cases[i].backend
+             << "\": " << cases[i].max_points;
+    }
+    json << "},\n  \"results\": [";
+    bool first  = true;
+    bool finite = true;
+    for(uint32_t size: sizes)
+    {
+        for(const Scenario& scenario: scenarios)
+        {
+            std::mt19937 generator(size);
+            std::normal_distribution<double> noise(0.0, scenario.noise);
+            std::uniform_real_distribution<double> box(-1.5, 1.5);
+
+            const Surface target = sample_surface(size, 0.0);
+            std::vector<Eigen::Vector3d> truth;
+            for(const Eigen::Vector3d& p: target.points) truth.push_back(R * p + t);
+
+            Surface source = sample_surface(size, 0.5);
+            for(Eigen::Vector3d& p: source.points)
+            {
+                p = R * p + t;
+                if(scenario.noise > 0.0) p += Eigen::Vector3d(noise(generator), noise(generator), noise(generator));
+                if(scenario.quantize > 0.0) p = (p / scenario.quantize).array().round() * scenario.quantize;
+            }
+            for(uint32_t i = 0; i < static_cast<uint32_t>(scenario.outliers * size); ++i)
+            {
+                source.points.push_back(t + Eigen::Vector3d(box(generator), box(generator), box(generator)));
+            }
+
+            for(const Case& c: cases)
+            {
+                std::string name = c.solver + "/" + c.backend + "/" + scenario.name;
+                if(!filter.empty() && name.find(filter) == std::string::npos) continue;
+                if(size > c.max_points)
+                {
+                    std::cerr << name << " " << size << ": skipped, limit " << c.max_points << " points\n";
+                    continue;
+                }
+
+                // solve would prepare the target itself, the explicit call keeps it out of the solve time
+                reset_peak_memory();
+                auto start = std::chrono::steady_clock::now();
+                Run run    = c.create(source, target);
+                run.prepare();
+                auto prepared = std::chrono::steady_clock::now();
+                run.solve(max_iterations, tol);
+                auto solved   = std::chrono::steady_clock::now();
+                double memory = peak_memory();
+
+                double setup_seconds = std::chrono::duration<double>(prepared - start).count();
+                double solve_seconds = std::chrono::duration<double>(solved - prepared).count();
+
+                auto result = to_cloud(target.points);
+                run.applyTransform(result);
+                double error = 0.0;
+                for(size_t i = 0; i < truth.size(); ++i)
+                {
+                    atcg::PointCloud::Point p = result->point(atcg::PointCloud::VertexHandle(i));
+                    error += (Eigen::Vector3d(p[0], p[1], p[2]) - truth[i]).squaredNorm();
+                }
+
+                const double rmse = std::sqrt(error / truth.size());
+                if(!std::isfinite(rmse))
+                {
+                    std::cerr << name << " " << size << ": The error is not finite!\n";
+                    finite = false;
+                }
+
+                uint32_t iterations = run.iterations();
+                json << (first ? "\n" : ",\n") << "    {\"solver\": \"" << c.solver << "\", \"backend\": \""
+                     << c.backend << "\", \"scenario\": \"" << scenario.name << "\", \"points\": " << size
+                     << ", \"iterations\": " << iterations << ", \"setup_seconds\": " << number(setup_seconds)
+                     << ", \"solve_seconds\": " << number(solve_seconds)
+                     << ", \"seconds_per_iteration\": " << number(solve_seconds / std::max(iterations, 1u))
+                     << ", \"peak_memory_mib\": " << number(memory)
+                     << ", \"rmse\": " << number(rmse) << "}";
+                first = false;
+
+                std::cerr << name << " " << size << ": setup " << setup_seconds << " s, solve " << solve_seconds
+                          << " s\n";
+            }
+        }
+    }
+    json << "\n  ]\n}\n";
+
+    if(output.empty())
+        std::cout << json.str();
+    else
+        std::ofstream(output) << json.str();
+
+    return finite ? 0 : 1;
+}